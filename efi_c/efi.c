@@ -25,6 +25,8 @@
 // Kernel start address in higher memory (64-bit) - last 2 GiBs of virtual memory
 #define KERNEL_START_ADDRESS 0xFFFFFFFF80000000
 
+#define KERNEL_STACK_PAGES 16   // 64KiB kernel stack
+
 #ifdef __clang__
 int _fltused = 0;   // If using floating point code & lld-link, need to define this
 #endif
@@ -42,6 +44,7 @@ extern EFI_SYSTEM_TABLE     *st;                // System Table
 extern EFI_HANDLE image;                        // Image handle
 
 extern INT32 text_rows, text_cols;              // Current text screen size rows & columns
+extern Mem_Method mem_method;                   // memcpy/memset implementation to use
 
 EFI_EVENT timer_event;  // Global timer event
 
@@ -79,11 +82,11 @@ EFI_STATUS set_text_mode(void) {
 
     // Overall screen loop
     while (true) {
-        cout->ClearScreen(cout);
+        clear_screen(cout);
 
         // Get current text mode info
         UINTN max_cols = 0, max_rows = 0;
-        cout->QueryMode(cout, cout->Mode->Mode, &max_cols, &max_rows);
+        cout->QueryMode(cout, text_mode(cout)->Mode, &max_cols, &max_rows);
 
         printf_c16(u"Text mode information:\r\n"
                    u"Max Mode: %d\r\n"
@@ -94,21 +97,21 @@ EFI_STATUS set_text_mode(void) {
                    u"CursorVisible: %d\r\n"
                    u"Columns: %d\r\n"
                    u"Rows: %d\r\n\r\n",
-                   cout->Mode->MaxMode,
-                   cout->Mode->Mode,
-                   cout->Mode->Attribute,
-                   cout->Mode->CursorColumn,
-                   cout->Mode->CursorRow,
-                   cout->Mode->CursorVisible,
+                   text_mode(cout)->MaxMode,
+                   text_mode(cout)->Mode,
+                   text_mode(cout)->Attribute,
+                   text_mode(cout)->CursorColumn,
+                   text_mode(cout)->CursorRow,
+                   text_mode(cout)->CursorVisible,
                    max_cols,
                    max_rows);
 
         printf_c16(u"Available text modes:\r\n");
 
-        UINTN menu_top = cout->Mode->CursorRow;
+        UINTN menu_top = text_mode(cout)->CursorRow;
 
         // Print keybinds at bottom of screen
-        cout->SetCursorPosition(cout, 0, max_rows-3);
+        set_cursor_position(cout, 0, max_rows-3);
         printf_c16(u"Up/Down Arrow = Move Cursor\r\n"
                u"Enter = Select\r\n"
                u"Escape = Go Back");
@@ -117,7 +120,7 @@ EFI_STATUS set_text_mode(void) {
 
         // Get all valid text modes' info
 	// NOTE: Max valid GOP mode is ModeMax-1 per UEFI spec
-        UINT32 max = cout->Mode->MaxMode;
+        UINT32 max = text_mode(cout)->MaxMode;
 	if (max-1 < menu_bottom - menu_top) menu_bottom = menu_top + max-1;
 
 	UINT32 num_modes = 0;
@@ -135,22 +138,22 @@ EFI_STATUS set_text_mode(void) {
 	UINTN menu_len = menu_bottom - menu_top + 1;	// 1-based offset
 
         // Highlight top menu row to start off
-        cout->SetCursorPosition(cout, 0, menu_top);
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+        set_cursor_position(cout, 0, menu_top);
+        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
         printf_c16(u"Mode %d: %llux%llu", 
 		   text_modes[0].mode, text_modes[0].cols, text_modes[0].rows);
 
         // Print other text mode infos
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+        set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
         for (UINT32 i = 1; i < menu_len; i++) 
             printf_c16(u"\r\nMode %d: %llux%llu", 
 		       text_modes[i].mode, text_modes[i].cols, text_modes[i].rows);
 
         // Get input from user
-        cout->SetCursorPosition(cout, 0, menu_top);
+        set_cursor_position(cout, 0, menu_top);
         bool getting_input = true;
         while (getting_input) {
-            UINTN current_row = cout->Mode->CursorRow;
+            UINTN current_row = text_mode(cout)->CursorRow;
 
             EFI_INPUT_KEY key = get_key();
             switch (key.ScanCode) {
@@ -161,13 +164,13 @@ EFI_STATUS set_text_mode(void) {
                         // Scroll menu up by decrementing all modes by 1
                         printf_c16(u"                    \r");  // Blank out mode text first
 
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         mode_index--;
                         printf_c16(u"Mode %d: %dx%d", 
                                    text_modes[mode_index].mode, 
 				   text_modes[mode_index].cols, text_modes[mode_index].rows);
 
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                         UINTN temp_mode = mode_index + 1;
                         for (UINT32 i = 0; i < menu_len; i++, temp_mode++) {
                             printf_c16(u"\r\n                    \r"  // Blank out mode text first
@@ -177,7 +180,7 @@ EFI_STATUS set_text_mode(void) {
                         }
 
                         // Reset cursor to top of menu
-                        cout->SetCursorPosition(cout, 0, menu_top);
+                        set_cursor_position(cout, 0, menu_top);
 
                     } else if (current_row-1 >= menu_top) {
                         // De-highlight current row, move up 1 row, highlight new row
@@ -188,8 +191,8 @@ EFI_STATUS set_text_mode(void) {
 
                         mode_index--;
                         current_row--;
-                        cout->SetCursorPosition(cout, 0, current_row);
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_cursor_position(cout, 0, current_row);
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                    u"Mode %d: %dx%d\r", 
 				   text_modes[mode_index].mode, 
@@ -197,7 +200,7 @@ EFI_STATUS set_text_mode(void) {
                     }
 
                     // Reset colors
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     break;
 
                 case SCANCODE_DOWN_ARROW:
@@ -206,7 +209,7 @@ EFI_STATUS set_text_mode(void) {
                         mode_index -= menu_len - 1;
 
                         // Print modes up until the last menu row
-                        cout->SetCursorPosition(cout, 0, menu_top);
+                        set_cursor_position(cout, 0, menu_top);
                         for (UINT32 i = 0; i < menu_len; i++, mode_index++) {
                             printf_c16(u"                    \r"    // Blank out mode text first
                                        u"Mode %d: %dx%d\r\n", 
@@ -215,7 +218,7 @@ EFI_STATUS set_text_mode(void) {
                         }
 
                         // Highlight last row
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                    u"Mode %d: %dx%d\r", 
 				   text_modes[mode_index].mode, 
@@ -230,7 +233,7 @@ EFI_STATUS set_text_mode(void) {
 
                         mode_index++;
                         current_row++;
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                    u"Mode %d: %dx%d\r", 
 				   text_modes[mode_index].mode, 
@@ -238,12 +241,13 @@ EFI_STATUS set_text_mode(void) {
                     }
 
                     // Reset colors
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     break;
 
                 default:
                     if (key.UnicodeChar == u'\r' && text_modes[mode_index].cols != 0) {	// Qemu can have invalid text modes
                         // Enter key, set Text mode
+                        flush_c16(cout);
                         cout->SetMode(cout, text_modes[mode_index].mode);
                         cout->QueryMode(cout, text_modes[mode_index].mode, 
 					&text_modes[mode_index].cols, &text_modes[mode_index].rows);
@@ -252,7 +256,7 @@ EFI_STATUS set_text_mode(void) {
                         text_rows = text_modes[mode_index].rows;
                         text_cols = text_modes[mode_index].cols;
 
-			cout->ClearScreen(cout);
+			clear_screen(cout);
 
                         getting_input = false;  // Will leave input loop and redraw screen
                         mode_index = 0;         // Reset last selected mode in menu
@@ -293,7 +297,7 @@ EFI_STATUS set_graphics_mode(void) {
 
     // Overall screen loop
     while (true) {
-        cout->ClearScreen(cout);
+        clear_screen(cout);
 
         // Get current GOP mode information
         printf_c16(u"Graphics mode information:\r\n");
@@ -322,19 +326,19 @@ EFI_STATUS set_graphics_mode(void) {
                mode_info->PixelFormat,
                mode_info->PixelsPerScanLine);
 
-        cout->OutputString(cout, u"\r\nAvailable GOP modes:\r\n");
+        printf_c16(u"\r\nAvailable GOP modes:\r\n");
 
         // Get current text mode ColsxRows values
-        UINTN menu_top = cout->Mode->CursorRow, menu_bottom = 0, max_cols;
-        cout->QueryMode(cout, cout->Mode->Mode, &max_cols, &menu_bottom);
+        UINTN menu_top = text_mode(cout)->CursorRow, menu_bottom = 0, max_cols;
+        cout->QueryMode(cout, text_mode(cout)->Mode, &max_cols, &menu_bottom);
 
         // Print keybinds at bottom of screen
-        cout->SetCursorPosition(cout, 0, menu_bottom-3);
+        set_cursor_position(cout, 0, menu_bottom-3);
         printf_c16(u"Up/Down Arrow = Move Cursor\r\n"
                u"Enter = Select\r\n"
                u"Escape = Go Back");
 
-        cout->SetCursorPosition(cout, 0, menu_top);
+        set_cursor_position(cout, 0, menu_top);
         menu_bottom -= 5;   // Bottom of menu will be 2 rows above keybinds
         UINTN menu_len = menu_bottom - menu_top;
 
@@ -354,19 +358,19 @@ EFI_STATUS set_graphics_mode(void) {
         }
 
         // Highlight top menu row to start off
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
         printf_c16(u"Mode %d: %dx%d", 0, gop_modes[0].width, gop_modes[0].height);
 
         // Print other text mode infos
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+        set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
         for (UINT32 i = 1; i < menu_len + 1; i++) 
             printf_c16(u"\r\nMode %d: %dx%d", i, gop_modes[i].width, gop_modes[i].height);
 
         // Get input from user 
-        cout->SetCursorPosition(cout, 0, menu_top);
+        set_cursor_position(cout, 0, menu_top);
         bool getting_input = true;
         while (getting_input) {
-            UINTN current_row = cout->Mode->CursorRow;
+            UINTN current_row = text_mode(cout)->CursorRow;
 
             EFI_INPUT_KEY key = get_key();
             switch (key.ScanCode) {
@@ -377,12 +381,12 @@ EFI_STATUS set_graphics_mode(void) {
                         // Scroll menu up by decrementing all modes by 1
                         printf_c16(u"                    \r");  // Blank out mode text first
 
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         mode_index--;
                         printf_c16(u"Mode %d: %dx%d", 
                                mode_index, gop_modes[mode_index].width, gop_modes[mode_index].height);
 
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                         UINTN temp_mode = mode_index + 1;
                         for (UINT32 i = 0; i < menu_len; i++, temp_mode++) {
                             printf_c16(u"\r\n                    \r"  // Blank out mode text first
@@ -391,7 +395,7 @@ EFI_STATUS set_graphics_mode(void) {
                         }
 
                         // Reset cursor to top of menu
-                        cout->SetCursorPosition(cout, 0, menu_top);
+                        set_cursor_position(cout, 0, menu_top);
 
                     } else if (current_row-1 >= menu_top) {
                         // De-highlight current row, move up 1 row, highlight new row
@@ -401,15 +405,15 @@ EFI_STATUS set_graphics_mode(void) {
 
                         mode_index--;
                         current_row--;
-                        cout->SetCursorPosition(cout, 0, current_row);
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_cursor_position(cout, 0, current_row);
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                u"Mode %d: %dx%d\r", 
                                mode_index, gop_modes[mode_index].width, gop_modes[mode_index].height);
                     }
 
                     // Reset colors
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     break;
 
                 case SCANCODE_DOWN_ARROW:
@@ -419,7 +423,7 @@ EFI_STATUS set_graphics_mode(void) {
                         mode_index -= menu_len - 1;
 
                         // Reset cursor to top of menu
-                        cout->SetCursorPosition(cout, 0, menu_top);
+                        set_cursor_position(cout, 0, menu_top);
 
                         // Print modes up until the last menu row
                         for (UINT32 i = 0; i < menu_len; i++, mode_index++) {
@@ -429,7 +433,7 @@ EFI_STATUS set_graphics_mode(void) {
                         }
 
                         // Highlight last row
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                u"Mode %d: %dx%d\r", 
                                mode_index, gop_modes[mode_index].width, gop_modes[mode_index].height);
@@ -442,14 +446,14 @@ EFI_STATUS set_graphics_mode(void) {
 
                         mode_index++;
                         current_row++;
-                        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                         printf_c16(u"                    \r"    // Blank out mode text first
                                u"Mode %d: %dx%d\r", 
                                mode_index, gop_modes[mode_index].width, gop_modes[mode_index].height);
                     }
 
                     // Reset colors
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     break;
 
                 default:
@@ -538,7 +542,7 @@ EFI_STATUS test_mouse(void) {
 
     gop->QueryMode(gop, mode_index, &mode_info_size, &mode_info);
 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
     BOOLEAN found_mode = FALSE;
 
     // Use LocateHandleBuffer() to find all SPPs 
@@ -678,6 +682,7 @@ EFI_STATUS test_mouse(void) {
     while (TRUE) {
         UINTN index = 0;
 
+        flush_c16(cout);
         bs->WaitForEvent(num_protocols, events, &index);
         if (input_protocols[index].type == CIN) {
             // Keypress
@@ -818,7 +823,7 @@ EFI_STATUS test_mouse(void) {
 // Test if EFI_SIMPLE_NETWORK_PROTOCOL is found or not
 // =====================================================
 EFI_STATUS test_network(void) {
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
     EFI_GUID netGuid = EFI_SIMPLE_NETWORK_PROTOCOL_GUID;
     EFI_SIMPLE_NETWORK_PROTOCOL* netProtocol;
@@ -840,7 +845,7 @@ VOID EFIAPI print_datetime(__attribute__((unused)) IN EFI_EVENT event, IN VOID *
     Timer_Context context = *(Timer_Context *)Context;
 
     // Save current cursor position before printing date/time
-    UINT32 save_col = cout->Mode->CursorColumn, save_row = cout->Mode->CursorRow;
+    UINT32 save_col = text_mode(cout)->CursorColumn, save_row = text_mode(cout)->CursorRow;
 
     // Get current date/time
     EFI_TIME time;
@@ -848,7 +853,7 @@ VOID EFIAPI print_datetime(__attribute__((unused)) IN EFI_EVENT event, IN VOID *
     rs->GetTime(&time, &capabilities);
 
     // Move cursor to print in lower right corner
-    cout->SetCursorPosition(cout, context.cols-20, context.rows-1);
+    set_cursor_position(cout, context.cols-20, context.rows-1);
 
     // Print current date/time
     printf_c16(u"%u-%c%u-%c%u %c%u:%c%u:%c%u",
@@ -860,7 +865,7 @@ VOID EFIAPI print_datetime(__attribute__((unused)) IN EFI_EVENT event, IN VOID *
            time.Second < 10 ? u'0' : u'\0', time.Second);
 
     // Restore cursor position
-    cout->SetCursorPosition(cout, save_col, save_row);
+    set_cursor_position(cout, save_col, save_row);
 }
 
 // ================================================
@@ -870,7 +875,8 @@ EFI_STATUS read_esp_files(void) {
     EFI_STATUS status = EFI_SUCCESS;
 
     // Get ESP root directory
-    EFI_FILE_PROTOCOL *dirp = esp_root_dir();
+    EFI_FILE_PROTOCOL *root = esp_root_dir();
+    EFI_FILE_PROTOCOL *dirp = root;
     if (!dirp) {
         error(0, u"Could not get ESP root directory.\r\n");
         goto done;
@@ -884,7 +890,7 @@ EFI_STATUS read_esp_files(void) {
     // Overall input loop
     INT32 csr_row = 1;
     while (true) {
-        cout->ClearScreen(cout);
+        clear_screen(cout);
         printf_c16(u"%s:\r\n", current_directory);
 
         INT32 num_entries = 0;
@@ -897,18 +903,18 @@ EFI_STATUS read_esp_files(void) {
             num_entries++;
 
             // Got next dir entry, print info
-            if (csr_row == cout->Mode->CursorRow) {
+            if (csr_row == text_mode(cout)->CursorRow) {
                 // Highlight row cursor/user is on
-                cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
             }
 
             printf_c16(u"%s %s\r\n", 
                    (file_info.Attribute & EFI_FILE_DIRECTORY) ? u"[DIR] " : u"[FILE]",
                    file_info.FileName);
 
-            if (csr_row+1 == cout->Mode->CursorRow) {
+            if (csr_row+1 == text_mode(cout)->CursorRow) {
                 // De-highlight rows after cursor
-                cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
             }
 
             buf_size = sizeof file_info;
@@ -959,8 +965,8 @@ EFI_STATUS read_esp_files(void) {
                             goto done;
                         }
 
-                        dirp->Close(dirp);  // Close last opened dir
-                        dirp = new_dir;     // Set new opened dir
+                        if (dirp != root) dirp->Close(dirp);    // Close last opened dir
+                        dirp = new_dir;                         // Set new opened dir
                         csr_row = 1;        // Reset user row to first entry in new directory
 
                         // Set new path for current directory
@@ -1053,7 +1059,7 @@ EFI_STATUS read_esp_files(void) {
     }
 
     done:
-    if (dirp) dirp->Close(dirp);    // Cleanup directory pointer
+    if (dirp && dirp != root) dirp->Close(dirp);    // Cleanup directory pointer, root stays open
     return status;
 }
 
@@ -1063,12 +1069,7 @@ EFI_STATUS read_esp_files(void) {
 EFI_STATUS print_block_io_partitions(void) {
     EFI_STATUS status = EFI_SUCCESS;
 
-    cout->ClearScreen(cout);
-
-    EFI_GUID bio_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
-    EFI_BLOCK_IO_PROTOCOL *biop;
-    UINTN num_handles = 0;
-    EFI_HANDLE *handle_buffer = NULL;
+    clear_screen(cout);
 
     // Get media ID for this disk image first, to compare to others in output
     UINT32 this_image_media_id = 0;
@@ -1078,26 +1079,12 @@ EFI_STATUS print_block_io_partitions(void) {
         return status;
     }
 
-    // Loop through and print all partition information found
-    status = bs->LocateHandleBuffer(ByProtocol, &bio_guid, NULL, &num_handles, &handle_buffer);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not locate any Block IO Protocols.\r\n");
-        return status;
-    }
-
+    // Loop through and print all partition information found, from the disk table's
+    //   Block IO devices, which are grouped by media ID
     UINT32 last_media_id = -1;  // Keep track of currently opened Media info
-    for (UINTN i = 0; i < num_handles; i++) {
-        status = bs->OpenProtocol(handle_buffer[i], 
-                                  &bio_guid,
-                                  (VOID **)&biop,
-                                  image,
-                                  NULL,
-                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);
-
-        if (EFI_ERROR(status)) {
-            error(status, u"Could not Open Block IO protocol on handle %u.\r\n", i);
-            continue;
-        }
+    for (UINTN i = 0; i < disk_table.num_devices; i++) {
+        EFI_HANDLE handle = disk_table.devices[i].handle;
+        EFI_BLOCK_IO_PROTOCOL *biop = disk_table.devices[i].biop;
 
         // Print Block IO Media Info for this Disk/partition
         if (last_media_id != biop->Media->MediaId) {
@@ -1112,6 +1099,10 @@ EFI_STATUS print_block_io_partitions(void) {
             continue;
         }
 
+        // Media fields past LastBlock only exist from the Block IO revision that added them
+        bool rev2 = biop->Revision >= EFI_BLOCK_IO_PROTOCOL_REVISION2;
+        bool rev3 = biop->Revision >= EFI_BLOCK_IO_PROTOCOL_REVISION3;
+
         printf_c16(u"Rmv: %s, Pr: %s, LglPrt: %s, RdOnly: %s, Wrt$: %s\r\n"
                u"BlkSz: %u, IoAln: %u, LstBlk: %u, LwLBA: %u, LglBlkPerPhys: %u\r\n"
                u"OptTrnLenGran: %u\r\n",
@@ -1124,9 +1115,9 @@ EFI_STATUS print_block_io_partitions(void) {
                biop->Media->BlockSize,
                biop->Media->IoAlign,
                biop->Media->LastBlock,
-               biop->Media->LowestAlignedLba,                   
-               biop->Media->LogicalBlocksPerPhysicalBlock,     
-               biop->Media->OptimalTransferLengthGranularity);
+               rev2 ? biop->Media->LowestAlignedLba : 0,
+               rev2 ? biop->Media->LogicalBlocksPerPhysicalBlock : 0,
+               rev3 ? biop->Media->OptimalTransferLengthGranularity : 0);
 
         // Print type of partition e.g. ESP or Data or Other
         if (!biop->Media->LogicalPartition) printf_c16(u"<Entire Disk>\r\n");
@@ -1134,7 +1125,7 @@ EFI_STATUS print_block_io_partitions(void) {
             // Get partition info protocol for this partition
             EFI_GUID pi_guid = EFI_PARTITION_INFO_PROTOCOL_GUID;
             EFI_PARTITION_INFO_PROTOCOL *pip = NULL;
-            status = bs->OpenProtocol(handle_buffer[i], 
+            status = bs->OpenProtocol(handle, 
                                       &pi_guid,
                                       (VOID **)&pip,
                                       image,
@@ -1181,33 +1172,15 @@ VOID *load_elf(VOID *elf_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_
         return NULL;
     }
 
-    // Get loadable program header measurements for loading
-    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
-
-    UINTN max_alignment = PAGE_SIZE;    
-    UINTN mem_min = UINT64_MAX, mem_max = 0;
-
-    for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
-        // Only interested in loadable program headers
-        if (phdr->p_type != PT_LOAD) continue;
-
-        // Update max alignment as needed
-        if (max_alignment < phdr->p_align) max_alignment = phdr->p_align;
-
-        UINTN hdr_begin = phdr->p_vaddr;        
-        UINTN hdr_end   = phdr->p_vaddr + phdr->p_memsz + max_alignment-1;
-
-        // Limit memory range to aligned values
-        //   e.g. 4096-1 = 4095 or 0x00000FFF (32 bit); ~4095 = 0xFFFFF000
-        hdr_begin &= ~(max_alignment-1);    
-        hdr_end   &= ~(max_alignment-1);   
-
-        // Get new minimum & maximum memory bounds for all program sections
-        if (hdr_begin < mem_min) mem_min = hdr_begin;
-        if (hdr_end   > mem_max) mem_max = hdr_end;
+    // Reject segments with more file data than memory, before copying or zeroing anything
+    if (!elf_segments_valid(ehdr)) {
+        error(0, u"ELF has a loadable segment with p_filesz > p_memsz\r\n");
+        return NULL;
     }
 
-    UINTN max_memory_needed = mem_max - mem_min;   
+    // Get loadable program header measurements for loading
+    UINTN mem_min = 0;
+    UINTN max_memory_needed = elf_memory_bounds(ehdr, &mem_min);
 
     // Allocate buffer for program headers
     EFI_STATUS status = 0;
@@ -1220,15 +1193,17 @@ VOID *load_elf(VOID *elf_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_
         return NULL;
     }
 
-    // Zero init buffer, to ensure 0 padding for all program sections
-    memset((VOID *)program_buffer, 0, max_memory_needed);
-
     // Fill out input parms for caller
     *file_buffer = program_buffer;
     *file_size   = pages_needed * PAGE_SIZE;
 
-    // Load program headers into buffer
-    phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
+    // Load program headers into buffer; instead of zeroing the whole buffer first, only zero 
+    //   what is not copied: loadable program headers are sorted by p_vaddr, so that is any gap 
+    //   before each one, its p_memsz - p_filesz (.bss) tail, and the rest of the buffer after 
+    //   the last one
+    UINT8 *buf = (UINT8 *)program_buffer;
+    UINTN zeroed_to = 0;    // Offset in buffer up to which memory is copied or zeroed
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
     for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
         // Only interested in loadable program headers
         if (phdr->p_type != PT_LOAD) continue;
@@ -1237,20 +1212,104 @@ VOID *load_elf(VOID *elf_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_
         //   With PIE executables, this means we can use any entry point or addresses, as long as
         //   we use the same relative addresses.
         UINTN relative_offset = phdr->p_vaddr - mem_min;
+        if (relative_offset > zeroed_to) memset(buf + zeroed_to, 0, relative_offset - zeroed_to);
 
         // Read p_filesz amount of data from p_offset in original file buffer,
         //   to the same relative offset of p_vaddr in new buffer
-        UINT8 *dst = (UINT8 *)program_buffer + relative_offset; 
-        UINT8 *src = (UINT8 *)elf_buffer     + phdr->p_offset;
-        UINT32 len = phdr->p_filesz;
+        UINT8 *dst = buf + relative_offset; 
+        UINT8 *src = (UINT8 *)elf_buffer + phdr->p_offset;
+        UINTN len = phdr->p_filesz;
         memcpy(dst, src, len);
+
+        memset(dst + len, 0, phdr->p_memsz - len);
+        if (relative_offset + phdr->p_memsz > zeroed_to) zeroed_to = relative_offset + phdr->p_memsz;
     }
+    memset(buf + zeroed_to, 0, pages_needed * PAGE_SIZE - zeroed_to);
 
     // Return entry point in new buffer, with same relative offset as in the original buffer 
     VOID *entry_point = (VOID *)((UINT8 *)program_buffer + (ehdr->e_entry - mem_min));
     return entry_point;
 }
 
+// ==========================================================
+// Load an ELF64 PIE file from the data partition into a new 
+//   buffer, and return the entry point for the loaded ELF 
+//   program. Only the ELF & program headers are read up 
+//   front, in hdr_buffer; each loadable segment is then read 
+//   from disk straight to its final location, and only 
+//   memory not read from the file is zeroed.
+// NOTE: Segment reads are queued on the input read queue, 
+//   and may still be in flight on return; caller must use 
+//   disk_read_queue_wait() before using the loaded program.
+// ==========================================================
+VOID *load_elf_from_disk(VOID *hdr_buffer, Data_File_Entry *file, Disk_Read_Queue *queue,
+                         EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_size) {
+    ELF_Header_64 *ehdr = hdr_buffer;
+
+    // Only allow PIE ELF files
+    if (ehdr->e_type != ET_DYN) {
+        error(0, u"ELF is not a PIE file; e_type is not ETDYN/0x03\r\n");
+        return NULL;
+    }
+
+    // Reject segments with more file data than memory, before reading or zeroing anything
+    if (!elf_segments_valid(ehdr)) {
+        error(0, u"ELF has a loadable segment with p_filesz > p_memsz\r\n");
+        return NULL;
+    }
+
+    // Get loadable program header measurements for loading
+    UINTN mem_min = 0;
+    UINTN max_memory_needed = elf_memory_bounds(ehdr, &mem_min);
+
+    // Allocate buffer for program headers
+    EFI_STATUS status = 0;
+    EFI_PHYSICAL_ADDRESS program_buffer = 0;
+    UINTN pages_needed = (max_memory_needed + (PAGE_SIZE-1)) / PAGE_SIZE;
+
+    status = bs->AllocatePages(AllocateAnyPages, EfiLoaderCode, pages_needed, &program_buffer);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate memory for ELF program\r\n");
+        return NULL;
+    }
+
+    // Read program headers from disk into buffer; loadable program headers are 
+    //   sorted by p_vaddr, so zero padding is any gap before each one, its 
+    //   p_memsz - p_filesz (.bss) tail, and the rest of the buffer after the last one.
+    //   With async reads, zeroing overlaps with reading the segments
+    UINT8 *buf = (UINT8 *)program_buffer;
+    UINTN zeroed_to = 0;    // Offset in buffer up to which memory is read or zeroed
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
+    for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
+        // Only interested in loadable program headers
+        if (phdr->p_type != PT_LOAD) continue;
+
+        // Same relative offset of p_vaddr in new buffer as for load_elf()
+        UINTN relative_offset = phdr->p_vaddr - mem_min;
+        if (relative_offset > zeroed_to) memset(buf + zeroed_to, 0, relative_offset - zeroed_to);
+
+        status = read_data_partition_file(file, phdr->p_offset, phdr->p_filesz, buf + relative_offset, 
+                                          queue);
+        if (EFI_ERROR(status)) {
+            disk_read_queue_wait(queue);    // Don't free memory with reads still in flight
+            bs->FreePages(program_buffer, pages_needed);
+            return NULL;
+        }
+
+        memset(buf + relative_offset + phdr->p_filesz, 0, phdr->p_memsz - phdr->p_filesz);
+        if (relative_offset + phdr->p_memsz > zeroed_to) zeroed_to = relative_offset + phdr->p_memsz;
+    }
+    memset(buf + zeroed_to, 0, pages_needed * PAGE_SIZE - zeroed_to);
+
+    // Fill out input parms for caller
+    *file_buffer = program_buffer;
+    *file_size   = pages_needed * PAGE_SIZE;
+
+    // Return entry point in new buffer, with same relative offset as in the file
+    VOID *entry_point = (VOID *)((UINT8 *)program_buffer + (ehdr->e_entry - mem_min));
+    return entry_point;
+}
+
 // ==========================================================
 // Load an PE32+ PIE file into a new buffer, and return the 
 //   entry point for the loaded PE program
@@ -1299,25 +1358,33 @@ VOID *load_pe(VOID *pe_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_si
         return NULL;
     }
 
-    // Initialize buffer to 0, which should also take care of needing to 0-pad sections between
-    //   Raw Data and Virtual Size
-    memset((VOID *)program_buffer, 0, opt_hdr->SizeOfImage);
     *file_buffer = program_buffer;
     *file_size   = pages_needed * PAGE_SIZE;
 
     // Get and load section headers into new buffer, from original "physical" data/addresses into
-    //   new "virtual" addresses
+    //   new "virtual" addresses. Sections are sorted by VirtualAddress, so only zero what is not
+    //   copied: any gap before each section (e.g. headers), its padding between Raw Data and 
+    //   Virtual Size, and the rest of the buffer after the last section
     PE_Section_Header_64 *shdr = 
         (PE_Section_Header_64 *)((UINT8 *)opt_hdr + coff_hdr->SizeOfOptionalHeader);
 
+    UINT8 *buf = (UINT8 *)program_buffer;
+    UINTN zeroed_to = 0;    // Offset in buffer up to which memory is copied or zeroed
     for (UINT16 i = 0; i < coff_hdr->NumberOfSections; i++, shdr++) {
-        if (shdr->SizeOfRawData == 0) continue;
+        UINTN offset = shdr->VirtualAddress;
+        if (offset > zeroed_to) memset(buf + zeroed_to, 0, offset - zeroed_to);
 
-        VOID *dst = (UINT8 *)program_buffer + shdr->VirtualAddress;
+        VOID *dst = buf + offset;
         VOID *src = (UINT8 *)pe_buffer + shdr->PointerToRawData;
         UINTN len = shdr->SizeOfRawData;
-        memcpy(dst, src, len);
+        if (len > 0) memcpy(dst, src, len);
+
+        if (shdr->VirtualSize > len) memset(buf + offset + len, 0, shdr->VirtualSize - len);
+        UINTN end = offset + max(len, shdr->VirtualSize);
+        if (end > zeroed_to) zeroed_to = end;
     }
+    if (zeroed_to < pages_needed * PAGE_SIZE) 
+        memset(buf + zeroed_to, 0, pages_needed * PAGE_SIZE - zeroed_to);
 
     // Return entry point
     VOID *entry_point = (UINT8 *)program_buffer + opt_hdr->AddressOfEntryPoint;
@@ -1368,11 +1435,55 @@ EFI_STATUS get_memory_map(Memory_Map_Info *mmap) {
     return EFI_SUCCESS;
 }
 
+// ==================================================================
+// Upper bound of page tables map_kernel_page_tables() needs, to 
+//   reserve as the page table pool before calling it
+// ==================================================================
+UINT64 kernel_page_tables_needed(Memory_Map_Info *mmap, Kernel_Page_Map *map) {
+    if (arch_page_tables_needed(mmap) == 0) return 0;   // Page tables not built for this arch
+
+    UINT64 tables = arch_page_tables_needed(mmap) +
+                    arch_range_page_tables_needed(map->framebuffer, map->framebuffer_size) +
+                    arch_range_page_tables_needed(KERNEL_START_ADDRESS, map->kernel_size) +
+                    arch_range_page_tables_needed(map->stack, map->stack_size);
+
+    for (UINTN i = 0; map->memory_attributes && i < map->memory_attributes->NumberOfEntries; i++) {
+        EFI_MEMORY_DESCRIPTOR *entry = memory_attributes_entry(map->memory_attributes, i);
+        tables += arch_range_page_tables_needed(entry->PhysicalStart, entry->NumberOfPages * PAGE_SIZE);
+    }
+    return tables;
+}
+
+// ==================================================================
+// Build the kernel's page tables: the framebuffer as write-combining,
+//   runtime regions with their access from the memory attributes table,
+//   the memory map identity mapped with each descriptor's memory type
+//   & access, the kernel at KERNEL_START_ADDRESS, and its stack. 
+//   Shared by load_kernel() and print_page_tables(), so the tables 
+//   printed are the ones the kernel gets.
+// ==================================================================
+void map_kernel_page_tables(Memory_Map_Info *mmap, Kernel_Page_Map *map) {
+    arch_init_page_tables(mmap);
+
+    // Framebuffer & runtime regions are first, as mapping the memory map leaves 
+    //   already mapped addresses as is
+    identity_map_range(map->framebuffer, map->framebuffer_size, MAP_WRITE | MAP_USER | MAP_WC, mmap);
+    identity_map_memory_attributes(map->memory_attributes, mmap);
+
+    identity_map_efi_mmap(mmap);
+
+    arch_map_range(map->kernel, KERNEL_START_ADDRESS, map->kernel_size, MAP_WRITE | MAP_USER, mmap);
+
+    identity_map_range(map->stack, map->stack_size, MAP_WRITE | MAP_USER, mmap);
+}
+
 // ==========================================
 // Read a file from the basic data partition
 // ==========================================
 EFI_STATUS load_kernel(void) {
     EFI_HII_PACKAGE_LIST_HEADER *pkg_list = NULL;   
+    VOID *hdr_buffer = NULL, *disk_buffer = NULL, *psf_font = NULL;
+    Disk_Read_Queue kernel_queue = {0}, psf_queue = {0};    // Async disk reads in flight
     EFI_STATUS status = EFI_SUCCESS;
 
     // Defined in efi_lib.h
@@ -1384,20 +1495,29 @@ EFI_STATUS load_kernel(void) {
         .ConfigurationTable   = st->ConfigurationTable,
         .num_fonts            = 0,
         .fonts                = NULL,
+        .mem_method           = mem_method,
     };
 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
-    // Get kernel file from data partition on disk 
-    UINTN file_size = 0;
-    VOID *disk_buffer = read_data_partition_file_to_buffer("kernel", false, &file_size);
-    if (!disk_buffer) {
-        error(0, u"Could not find or read kernel file to buffer\r\n");
+    // Get kernel file from data partition on disk; read only the first page for its headers
+    //   so that ELF segments can be read straight to their final location
+    Data_File_Entry *kernel_file = find_data_file("kernel");
+    if (!kernel_file) {
+        error(0, u"Could not find kernel file in data partition\r\n");
+        goto cleanup;
+    }
+
+    UINTN file_size = kernel_file->file_size;
+    UINTN hdr_size = min(file_size, PAGE_SIZE);
+    status = bs->AllocatePool(EfiLoaderData, hdr_size, &hdr_buffer);
+    if (EFI_ERROR(status) || EFI_ERROR(read_data_partition_file(kernel_file, 0, hdr_size, hdr_buffer, NULL))) {
+        error(status, u"Could not read kernel file headers to buffer\r\n");
         goto cleanup;
     }
 
     // Load Kernel binary depending on format (initial header bytes)
-    UINT8 *hdr = disk_buffer;
+    UINT8 *hdr = hdr_buffer;
     printf_c16(u"Header bytes: [%hhx][%hhx][%hhx][%hhx]\r\n", 
            hdr[0], hdr[1], hdr[2], hdr[3]);
 
@@ -1412,20 +1532,47 @@ EFI_STATUS load_kernel(void) {
     printf_c16(u"File Format: ");
     if (!memcmp(hdr, (UINT8[4]){0x7F, 'E', 'L', 'F'}, 4)) {
         printf_c16(u"ELF\r\n");
-        print_elf_info(disk_buffer); // Print ELF header and loadable program header information
-        *(void **)&entry_point = load_elf(disk_buffer, &kernel_buffer, &kernel_size);   
 
-    } else if (!memcmp(hdr, (UINT8[2]){'M', 'Z'}, 2)) {
-        printf_c16(u"PE\r\n");
-        print_pe_info(disk_buffer); // Print PE header and loadable section header information
-        *(void **)&entry_point = load_pe(disk_buffer, &kernel_buffer, &kernel_size); 
+        // Read all program headers if they don't fit in the first page
+        ELF_Header_64 *ehdr = hdr_buffer;
+        UINTN headers_size = ehdr->e_phoff + (ehdr->e_phnum * sizeof(ELF_Program_Header_64));
+        if (headers_size > hdr_size) {
+            bs->FreePool(hdr_buffer);
+            hdr_buffer = NULL;
+            status = bs->AllocatePool(EfiLoaderData, headers_size, &hdr_buffer);
+            if (EFI_ERROR(status) || 
+                EFI_ERROR(read_data_partition_file(kernel_file, 0, headers_size, hdr_buffer, NULL))) {
+                error(status, u"Could not read kernel program headers to buffer\r\n");
+                goto cleanup;
+            }
+        }
+
+        // Start reading loadable segments, then print ELF header and loadable program header 
+        //   information while they are read
+        *(void **)&entry_point = load_elf_from_disk(hdr_buffer, kernel_file, &kernel_queue,
+                                                    &kernel_buffer, &kernel_size);
+        print_elf_info(hdr_buffer); 
 
     } else {
-        printf_c16(u"No format found, assuming flat binary file\r\n");
-        // Flat binary executable code assumed to start at the beginning of the loaded buffer
-        *(void **)&entry_point = disk_buffer;   
-        kernel_buffer = (EFI_PHYSICAL_ADDRESS)disk_buffer;
-        kernel_size = file_size;
+        // Other formats are loaded from a buffer with the whole file
+        disk_buffer = read_data_partition_file_to_buffer(kernel_file->name, false, &file_size);
+        if (!disk_buffer) {
+            error(0, u"Could not find or read kernel file to buffer\r\n");
+            goto cleanup;
+        }
+
+        if (!memcmp(hdr, (UINT8[2]){'M', 'Z'}, 2)) {
+            printf_c16(u"PE\r\n");
+            print_pe_info(disk_buffer); // Print PE header and loadable section header information
+            *(void **)&entry_point = load_pe(disk_buffer, &kernel_buffer, &kernel_size); 
+
+        } else {
+            printf_c16(u"No format found, assuming flat binary file\r\n");
+            // Flat binary executable code assumed to start at the beginning of the loaded buffer
+            *(void **)&entry_point = disk_buffer;   
+            kernel_buffer = (EFI_PHYSICAL_ADDRESS)disk_buffer;
+            kernel_size = file_size;
+        }
     }
 
     // Get new higher address kernel entry point to use
@@ -1443,6 +1590,15 @@ EFI_STATUS load_kernel(void) {
         goto cleanup;     
     }
 
+    // Start reading PSF font file for another bitmap font to use, while setting up the
+    //   other kernel parameters; this one should be stored in the disk image's data partition
+    char *psf_name = "ter-132n.psf";
+    EFI_STATUS psf_status = EFI_NOT_FOUND;
+    Data_File_Entry *psf_file = find_data_file(psf_name);
+    if (psf_file) psf_status = bs->AllocatePool(EfiLoaderData, psf_file->file_size, &psf_font);
+    if (EFI_ERROR(psf_status)) psf_font = NULL;
+    else psf_status = read_data_partition_file(psf_file, 0, psf_file->file_size, psf_font, &psf_queue);
+
     if (!autoload_kernel) {
         printf_c16(u"\r\nPress ESC to abort, or another key to load kernel...\r\n");
         EFI_INPUT_KEY key = get_key();
@@ -1463,15 +1619,14 @@ EFI_STATUS load_kernel(void) {
         VOID *inst_file_buf = read_esp_file_to_buffer(install_file, &buf_size);
         if (!inst_file_buf) goto gop_done;
 
-        char *str_pos = stpstr(inst_file_buf, "XRES=");
-        if (!str_pos) goto gop_done;
-        UINT32 xres = atoi(str_pos);
-
-        str_pos = stpstr(str_pos, "YRES=");
-        if (!str_pos) goto gop_done;
-        UINT32 yres = atoi(str_pos);
+        char *keys[] = { "XRES=", "YRES=" };
+        char *ends[ARRAY_SIZE(keys)];
+        UINTN found = stpstr_many(inst_file_buf, buf_size, keys, ARRAY_SIZE(keys), ends);
+        UINT32 xres = found == ARRAY_SIZE(keys) ? atoi(ends[0]) : 0;
+        UINT32 yres = found == ARRAY_SIZE(keys) ? atoi(ends[1]) : 0;
 
         bs->FreePool(inst_file_buf);
+        if (found != ARRAY_SIZE(keys)) goto gop_done;
 
         status = set_gop_mode(&gop, xres, yres); 
         set_mode = !EFI_ERROR(status);
@@ -1500,6 +1655,7 @@ EFI_STATUS load_kernel(void) {
         error(status, u"Could not allocate buffer for kernel bitmap font parms.\r\n");
         goto cleanup;
     }
+    memset(kparms.fonts, 0, kparms.num_fonts * sizeof *kparms.fonts);
 
     // Get simple font info & glyphs from HII database for kernel to use as a bitmap font 
     //   for printing
@@ -1546,11 +1702,22 @@ EFI_STATUS load_kernel(void) {
         }
     }
 
-    // Get PSF font file for another bitmap font to use;
-    //   this one should be stored in the disk image's data partition
-    char *psf_name = "ter-132n.psf";
-    UINTN psf_size = 0;
-    VOID *psf_font = read_data_partition_file_to_buffer(psf_name, false, &psf_size);
+    // Wait for kernel segment reads to finish
+    status = disk_read_queue_wait(&kernel_queue);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not read kernel file from disk.\r\n");
+        goto cleanup;
+    }
+
+    // Wait for PSF font file read to finish
+    EFI_STATUS psf_wait_status = disk_read_queue_wait(&psf_queue);
+    if (!EFI_ERROR(psf_status)) psf_status = psf_wait_status;
+    if (EFI_ERROR(psf_status)) {
+        error(psf_status, u"Could not find or read data partition file '%hhs' to buffer\r\n", psf_name);
+        if (psf_font) bs->FreePool(psf_font);
+        psf_font = NULL;
+    }
+
     if (psf_font) {
         PSF2_Header *psf2_hdr = psf_font;
         kparms.fonts[1] = (Bitmap_Font){
@@ -1563,9 +1730,25 @@ EFI_STATUS load_kernel(void) {
         };
     }
 
+    // Write out any buffered text while console output is still available,
+    //   close cached ESP root directory while file protocols still are,
+    //   and free disk table & data file index before getting the memory map
+    flush_c16(cout);
+    close_esp_root_dir();
+    free_disk_table();
+    free_data_file_index();
+
     // Get Memory Map
     if (EFI_ERROR(get_memory_map(&kparms.mmap))) goto cleanup;
 
+    // Refuse while boot services are still there to go back to, if the kernel can't get 
+    //   page tables on this arch
+    if (arch_page_tables_needed(&kparms.mmap) == 0) {
+        error(0, u"Page tables are not built for this architecture yet.\r\n");
+        bs->FreePool(kparms.mmap.map);
+        goto cleanup;
+    }
+
     // Exit boot services before calling kernel
     UINTN retries = 0;
     const UINTN MAX_RETRIES = 5;
@@ -1581,48 +1764,54 @@ EFI_STATUS load_kernel(void) {
         goto cleanup;
     }
 
-    // Initialize page tables
-    arch_init_page_tables(&kparms.mmap);
-
-    // Identity mapping all available memory 
-    identity_map_efi_mmap(&kparms.mmap);
-
-    // Identity map runtime services memory & set new runtime address map
-    set_runtime_address_map(&kparms.mmap);
+    // New stack for kernel
+    void *kernel_stack = mmap_allocate_pages(&kparms.mmap, KERNEL_STACK_PAGES);
+    uint32_t stack_size = KERNEL_STACK_PAGES * PAGE_SIZE;
+    memset(kernel_stack, 0, stack_size); // Initialize stack memory
 
-    // Remap kernel to higher addresses
-    for (UINTN i = 0; i < (kernel_size + (PAGE_SIZE-1)) / PAGE_SIZE; i++) 
-        arch_map_page(kernel_buffer + (i*PAGE_SIZE), 
-                      KERNEL_START_ADDRESS + (i*PAGE_SIZE), 
-                      &kparms.mmap); 
+    // Write-back copy of the framebuffer for the kernel to draw & scroll text in, so it
+    //   never reads from the framebuffer itself
+    kparms.fb_back_buffer = mmap_allocate_pages(&kparms.mmap, 
+                                (kparms.gop_mode.FrameBufferSize + (PAGE_SIZE-1)) / PAGE_SIZE);
+
+    // Build page tables for the framebuffer, all available memory, the kernel at
+    //   higher addresses, and its stack, from a pool of page tables reserved up front
+    Kernel_Page_Map page_map = {
+        .framebuffer       = kparms.gop_mode.FrameBufferBase,
+        .framebuffer_size  = kparms.gop_mode.FrameBufferSize,
+        .kernel            = kernel_buffer,
+        .kernel_size       = kernel_size,
+        .stack             = (UINTN)kernel_stack,
+        .stack_size        = stack_size,
+        .memory_attributes = get_config_table_by_guid((EFI_GUID)EFI_MEMORY_ATTRIBUTES_TABLE_GUID),
+    };
+    UINT64 table_pages = kernel_page_tables_needed(&kparms.mmap, &page_map);
+    if (table_pages > 0) 
+        arch_set_page_table_pool(mmap_allocate_pages(&kparms.mmap, table_pages), table_pages);
+    map_kernel_page_tables(&kparms.mmap, &page_map);
 
     // NOTE: TODO: Remap kparms to higher address?
 
-    // Identity map framebuffer
-    for (UINTN i = 0; i < (kparms.gop_mode.FrameBufferSize + (PAGE_SIZE-1)) / PAGE_SIZE; i++) 
-        identity_map_page(kparms.gop_mode.FrameBufferBase + (i*PAGE_SIZE), &kparms.mmap); 
-
-    // Identity map new stack for kernel
-    const UINTN STACK_PAGES = 16;   
-    void *kernel_stack = mmap_allocate_pages(&kparms.mmap, STACK_PAGES);   // 64KiB stack
-    uint32_t stack_size = STACK_PAGES * PAGE_SIZE;
-    memset(kernel_stack, 0, stack_size); // Initialize stack memory
-
-    for (UINTN i = 0; i < STACK_PAGES; i++) 
-        identity_map_page((UINTN)kernel_stack + (i*PAGE_SIZE), &kparms.mmap); 
+    // Identity map runtime services memory & set new runtime address map
+    set_runtime_address_map(&kparms.mmap);
 
     // Set page tables & paging, do other arch specific settings, and call kernel
     arch_setup_and_call_kernel(higher_entry_point, kernel_stack, stack_size, &kparms);
 
     // Final cleanup
     cleanup:
-    if (disk_buffer) bs->FreePool(disk_buffer); // Free memory for data partition file
+    disk_read_queue_wait(&kernel_queue);        // Finish any reads before freeing their buffers
+    disk_read_queue_wait(&psf_queue);
+    if (hdr_buffer)  bs->FreePool(hdr_buffer);  // Free memory for kernel file headers
+    if (disk_buffer && (EFI_PHYSICAL_ADDRESS)disk_buffer != kernel_buffer) 
+        bs->FreePages((EFI_PHYSICAL_ADDRESS)disk_buffer,   // Free memory for data partition file
+                      (file_size + (PAGE_SIZE-1)) / PAGE_SIZE);
     if (pkg_list)    bs->FreePool(pkg_list);    // Free memory for simple font package list
+    if (psf_font)    bs->FreePool(psf_font);    // Free memory for PSF font file
 
     if (kparms.fonts) {
-        // Free memory for kparms font glyphs
-        for (UINTN i = 0; i < kparms.num_fonts; i++)    
-            bs->FreePool(kparms.fonts[i].glyphs);
+        // Free memory for kparms font glyphs; PSF font glyphs are in the PSF font file buffer
+        if (kparms.fonts[0].glyphs) bs->FreePool(kparms.fonts[0].glyphs);
 
         bs->FreePool(kparms.fonts);   // Free memory for kparms fonts array
     }
@@ -1634,7 +1823,7 @@ EFI_STATUS load_kernel(void) {
 // Print Memory Map
 // ====================
 EFI_STATUS print_memory_map(void) { 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
     // Close Timer Event for cleanup
     bs->CloseEvent(timer_event);
@@ -1671,10 +1860,10 @@ EFI_STATUS print_memory_map(void) {
         }
 
         // Pause if reached bottom of screen
-        if (cout->Mode->CursorRow >= text_rows-2) {
+        if (cursor_row(cout) >= text_rows-2) {
             printf_c16(u"Press any key to continue...\r\n");
             get_key();
-            cout->ClearScreen(cout);
+            clear_screen(cout);
         }
     }
 
@@ -1689,11 +1878,317 @@ EFI_STATUS print_memory_map(void) {
     return EFI_SUCCESS;
 }
 
+// ==================================================================
+// Expected mapping of each memory type, written out separately from
+//   efi_memory_map_flags() so print_page_tables() checks the page 
+//   tables against it, not against the code that built them
+// ==================================================================
+const Expected_Mapping expected_mappings[] = {
+    { EfiReservedMemoryType,      MAP_WRITE | MAP_USER | MAP_UC,          false },
+    { EfiLoaderCode,              MAP_WRITE | MAP_USER,                   false },
+    { EfiLoaderData,              MAP_WRITE | MAP_USER,                   false },
+    { EfiBootServicesCode,        MAP_WRITE | MAP_USER,                   false },
+    { EfiBootServicesData,        MAP_WRITE | MAP_USER | MAP_NX,          false },
+    { EfiRuntimeServicesCode,     MAP_WRITE | MAP_USER,                   false },
+    { EfiRuntimeServicesData,     MAP_WRITE | MAP_USER | MAP_NX,          false },
+    { EfiConventionalMemory,      MAP_WRITE | MAP_USER | MAP_NX,          false },
+    { EfiUnusableMemory,          MAP_WRITE | MAP_USER | MAP_UC | MAP_NX, false },
+    { EfiACPIReclaimMemory,       MAP_WRITE | MAP_USER | MAP_NX,          false },
+    { EfiACPIMemoryNVS,           MAP_WRITE | MAP_USER | MAP_NX,          false },
+    { EfiMemoryMappedIO,          MAP_WRITE | MAP_USER | MAP_UC | MAP_NX, true  },
+    { EfiMemoryMappedIOPortSpace, MAP_WRITE | MAP_USER | MAP_UC | MAP_NX, true  },
+    { EfiPalCode,                 MAP_WRITE | MAP_USER,                   false },
+    { EfiPersistentMemory,        MAP_WRITE | MAP_USER,                   false },
+};
+
+// ==================================================================
+// Get the MAP_* flags a memory descriptor should be mapped with, 
+//   from expected_mappings[] and its cacheability attributes, or for 
+//   a memory attributes table entry in it, with that entry's access
+// ==================================================================
+UINT64 expected_map_flags(EFI_MEMORY_DESCRIPTOR *desc, EFI_MEMORY_DESCRIPTOR *attributes) {
+    UINT64 flags = MAP_WRITE | MAP_USER;    // Other types: RAM
+    bool mmio = false;
+    for (UINTN i = 0; i < ARRAY_SIZE(expected_mappings); i++) {
+        if (expected_mappings[i].type == desc->Type) {
+            flags = expected_mappings[i].map_flags;
+            mmio  = expected_mappings[i].mmio;
+            break;
+        }
+    }
+
+    // The most cacheable type in the attributes replaces the type's default
+    const UINT64 attr = desc->Attribute;
+    if (!mmio && (attr & (EFI_MEMORY_WB | EFI_MEMORY_WT | EFI_MEMORY_WC | EFI_MEMORY_WP | EFI_MEMORY_UC))) {
+        flags &= ~MAP_TYPE_MASK;
+        if      (attr & EFI_MEMORY_WB) ;
+        else if (attr & EFI_MEMORY_WT) flags |= MAP_WT;
+        else if (attr & EFI_MEMORY_WC) flags |= MAP_WC;
+        else if (attr & EFI_MEMORY_WP) flags |= MAP_WP;
+        else                           flags |= MAP_UC;
+    }
+
+    // XP & RO in the memory map are only what the memory supports; a memory attributes
+    //   table entry's are its access
+    if (attributes) {
+        flags = (flags & ~MAP_NX) | MAP_WRITE;
+        if (attributes->Attribute & EFI_MEMORY_RO) flags &= ~MAP_WRITE;
+        if (attributes->Attribute & EFI_MEMORY_XP) flags |= MAP_NX;
+    }
+
+    // As this CPU can map them, e.g. without an NX bit everything is executable
+    return arch_map_flags(arch_page_flags(flags));
+}
+
+// ==================================================================
+// Print 1 run of page table mappings with the same page size and 
+//   flags, and what was expected if the run is not mapped correctly
+// ==================================================================
+void print_page_table_run(UINTN start, UINTN end, UINT64 page_size, UINT64 flags, 
+                          UINT64 expected_map_flags, bool expected_address) {
+    UINT64 map_flags = arch_map_flags(flags);
+    printf_c16(u"%llx-%llx %lluKiB pages %c%c%c %hhs", 
+               start, end - 1, page_size / 1024,
+               map_flags & MAP_WRITE ? u'W' : u'-',
+               map_flags & MAP_USER  ? u'U' : u'-',
+               map_flags & MAP_NX    ? u'-' : u'X',
+               map_flags_type_name(map_flags));
+
+    if (!flags) 
+        printf_c16(u" NOT MAPPED");
+    else if (!expected_address) 
+        printf_c16(u" WRONG PHYSICAL ADDRESS");
+    else if (map_flags != expected_map_flags) {
+        printf_c16(u" MISMATCH, expected %c%c%c %hhs",
+                   expected_map_flags & MAP_WRITE ? u'W' : u'-',
+                   expected_map_flags & MAP_USER  ? u'U' : u'-',
+                   expected_map_flags & MAP_NX    ? u'-' : u'X',
+                   map_flags_type_name(expected_map_flags));
+    }
+    printf_c16(u"\r\n");
+
+    // Pause if reached bottom of screen
+    if (cursor_row(cout) >= text_rows-2) {
+        printf_c16(u"Press any key to continue...\r\n");
+        get_key();
+        clear_screen(cout);
+    }
+}
+
+// ==================================================================
+// Print the mappings of virtual addresses [start, end) in runs of the 
+//   same page size and flags, checking each run maps to physical 
+//   addresses from physical_start with expected MAP_* flags
+// Returns: number of runs not mapped as expected
+// ==================================================================
+UINTN print_page_table_range(UINTN start, UINTN end, UINTN physical_start, UINT64 expected_map_flags) {
+    UINTN run_start = start, mismatches = 0;
+    UINT64 run_page_size = 0, run_flags = 0;
+    bool run_expected_address = false;
+
+    for (UINTN address = start; address < end; ) {
+        UINT64 physical_address = 0, page_size = PAGE_SIZE, flags = 0;
+        if (!arch_get_mapping(address, &physical_address, &page_size, &flags)) flags = 0;
+        bool expected_address = flags && physical_address == physical_start + (address - start);
+
+        if (address != start && (page_size != run_page_size || flags != run_flags || 
+                                 expected_address != run_expected_address)) {
+            print_page_table_run(run_start, address, run_page_size, run_flags, 
+                                 expected_map_flags, run_expected_address);
+            if (!run_expected_address || arch_map_flags(run_flags) != expected_map_flags) mismatches++;
+            run_start = address;
+        }
+        run_page_size = page_size;
+        run_flags = flags;
+        run_expected_address = expected_address;
+
+        address = min((address | (page_size-1)) + 1, end);     // Start of next page
+    }
+    print_page_table_run(run_start, end, run_page_size, run_flags, expected_map_flags, run_expected_address);
+    if (!run_expected_address || arch_map_flags(run_flags) != expected_map_flags) mismatches++;
+    return mismatches;
+}
+
+// ==================================================================
+// Print an identity mapped range, leaving out the parts of it that are 
+//   the framebuffer or memory attributes table entries, as those are 
+//   checked on their own
+// Returns: number of runs not mapped as expected
+// ==================================================================
+UINTN print_identity_range(UINTN start, UINTN end, UINT64 expected_map_flags, Kernel_Page_Map *map,
+                           Memory_Map_Info *mmap) {
+    // Lowest of the ranges checked on their own that overlaps [start, end)
+    UINTN skip_start = end, skip_end = end;
+    if (map->framebuffer_size > 0 && map->framebuffer < end && 
+        map->framebuffer + map->framebuffer_size > start) {
+        skip_start = map->framebuffer;
+        skip_end   = map->framebuffer + map->framebuffer_size;
+    }
+    for (UINTN i = 0; map->memory_attributes && i < map->memory_attributes->NumberOfEntries; i++) {
+        EFI_MEMORY_DESCRIPTOR *entry = memory_attributes_entry(map->memory_attributes, i);
+        UINTN entry_end = entry->PhysicalStart + (entry->NumberOfPages * PAGE_SIZE);
+        if (entry->PhysicalStart < end && entry_end > start && entry->PhysicalStart < skip_start &&
+            memory_attributes_descriptor(mmap, entry)) {
+            skip_start = entry->PhysicalStart;
+            skip_end   = entry_end;
+        }
+    }
+
+    if (skip_start >= end) return print_page_table_range(start, end, start, expected_map_flags);
+
+    UINTN mismatches = 0;
+    if (start < skip_start) mismatches += print_page_table_range(start, skip_start, start, expected_map_flags);
+    if (skip_end < end)     mismatches += print_identity_range(skip_end, end, expected_map_flags, map, mmap);
+    return mismatches;
+}
+
+// ==================================================================
+// Print Page Tables: Build the page tables load_kernel() would for 
+//   the current memory map & framebuffer, with stand-ins for the 
+//   kernel & its stack, print their mappings, and verify them against 
+//   expected_mappings[]: each memory map descriptor identity mapped 
+//   with the memory type & access for its type & attributes, memory
+//   attributes table entries with their access, the framebuffer 
+//   write-combining, and the kernel at KERNEL_START_ADDRESS
+// ==================================================================
+EFI_STATUS print_page_tables(void) {
+    clear_screen(cout);
+
+    // Close Timer Event for cleanup
+    bs->CloseEvent(timer_event);
+
+    Memory_Map_Info mmap = {0};
+    Kernel_Page_Map page_map = {0};
+    EFI_PHYSICAL_ADDRESS pool = 0;
+    UINTN pool_pages = 0, kernel_pages = 0, mismatches = 0;
+
+    EFI_STATUS status = get_memory_map(&mmap);
+    if (EFI_ERROR(status)) goto cleanup;
+
+    if (arch_page_tables_needed(&mmap) == 0) {
+        error(0, u"Page tables are not built for this architecture yet.\r\n");
+        goto cleanup;
+    }
+
+    page_map.memory_attributes = get_config_table_by_guid((EFI_GUID)EFI_MEMORY_ATTRIBUTES_TABLE_GUID);
+
+    // Framebuffer of the current GOP mode, if any
+    EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID; 
+    EFI_GRAPHICS_OUTPUT_PROTOCOL *gop = NULL;
+    if (!EFI_ERROR(bs->LocateProtocol(&gop_guid, NULL, (VOID **)&gop)) && gop->Mode) {
+        page_map.framebuffer      = gop->Mode->FrameBufferBase;
+        page_map.framebuffer_size = gop->Mode->FrameBufferSize;
+    }
+
+    // Stand-ins for the loaded kernel, the size of the kernel file if there is one, 
+    //   and its stack
+    Data_File_Entry *kernel_file = find_data_file("kernel");
+    kernel_pages = ((kernel_file ? kernel_file->file_size : 1024*1024) + (PAGE_SIZE-1)) / PAGE_SIZE;
+    status = bs->AllocatePages(AllocateAnyPages, EfiLoaderData, kernel_pages, &page_map.kernel);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate %u pages for kernel.\r\n", kernel_pages);
+        page_map.kernel = 0;
+        goto cleanup;
+    }
+    page_map.kernel_size = kernel_pages * PAGE_SIZE;
+
+    status = bs->AllocatePages(AllocateAnyPages, EfiLoaderData, KERNEL_STACK_PAGES, &page_map.stack);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate %u pages for kernel stack.\r\n", KERNEL_STACK_PAGES);
+        page_map.stack = 0;
+        goto cleanup;
+    }
+    page_map.stack_size = KERNEL_STACK_PAGES * PAGE_SIZE;
+
+    // Free memory in the memory map is still in use by firmware before ExitBootServices(),
+    //   so allocate the page tables from firmware instead, with room for this allocation 
+    //   changing the memory map
+    pool_pages = kernel_page_tables_needed(&mmap, &page_map) + 16;
+    status = bs->AllocatePages(AllocateAnyPages, EfiLoaderData, pool_pages, &pool);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate %u pages for page tables.\r\n", pool_pages);
+        pool = 0;
+        goto cleanup;
+    }
+
+    bs->FreePool(mmap.map);
+    status = get_memory_map(&mmap);
+    if (EFI_ERROR(status)) goto cleanup;
+
+    if (kernel_page_tables_needed(&mmap, &page_map) > pool_pages) {
+        error(0, u"Memory map changed, could not reserve enough page tables.\r\n");
+        goto cleanup;
+    }
+
+    arch_set_page_table_pool((void *)pool, pool_pages);
+    map_kernel_page_tables(&mmap, &page_map);
+
+    printf_c16(u"Page tables for %u descriptors, %u pages reserved; W = Write, U = User, X = Execute\r\n",
+               mmap.size / mmap.desc_size, pool_pages);
+
+    // Memory map: contiguous descriptors with the same expected flags are 1 range
+    UINTN start = 0, end = 0;
+    UINT64 range_flags = 0;
+    for (UINTN i = 0; i < mmap.size / mmap.desc_size; i++) {
+        EFI_MEMORY_DESCRIPTOR *desc = 
+            (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)mmap.map + (i * mmap.desc_size));
+        UINT64 flags = expected_map_flags(desc, NULL);
+
+        if (i > 0 && (desc->PhysicalStart != end || flags != range_flags)) {
+            mismatches += print_identity_range(start, end, range_flags, &page_map, &mmap);
+            start = desc->PhysicalStart;
+        } else if (i == 0) 
+            start = desc->PhysicalStart;
+
+        end = desc->PhysicalStart + (desc->NumberOfPages * PAGE_SIZE);
+        range_flags = flags;
+    }
+    if (end > start) mismatches += print_identity_range(start, end, range_flags, &page_map, &mmap);
+
+    if (page_map.memory_attributes) {
+        printf_c16(u"\r\nMemory attributes table:\r\n");
+        for (UINTN i = 0; i < page_map.memory_attributes->NumberOfEntries; i++) {
+            EFI_MEMORY_DESCRIPTOR *entry = memory_attributes_entry(page_map.memory_attributes, i);
+            EFI_MEMORY_DESCRIPTOR *desc = memory_attributes_descriptor(&mmap, entry);
+            if (!desc) continue;    // Not a runtime region, checked with the memory map
+
+            mismatches += print_page_table_range(entry->PhysicalStart, 
+                                                 entry->PhysicalStart + (entry->NumberOfPages * PAGE_SIZE),
+                                                 entry->PhysicalStart, expected_map_flags(desc, entry));
+        }
+    }
+
+    if (page_map.framebuffer_size > 0) {
+        printf_c16(u"\r\nFramebuffer:\r\n");
+        mismatches += print_page_table_range(page_map.framebuffer, 
+                                             page_map.framebuffer + page_map.framebuffer_size, 
+                                             page_map.framebuffer, MAP_WRITE | MAP_USER | MAP_WC);
+    }
+
+    printf_c16(u"\r\nKernel:\r\n");
+    mismatches += print_page_table_range(KERNEL_START_ADDRESS, KERNEL_START_ADDRESS + page_map.kernel_size,
+                                         page_map.kernel, MAP_WRITE | MAP_USER);
+
+    if (mismatches == 0) printf_c16(u"\r\nAll ranges are mapped as expected.\r\n");
+    else                 printf_c16(u"\r\n%u runs are not mapped as expected!\r\n", mismatches);
+
+    cleanup:
+    arch_set_page_table_pool(NULL, 0);  // Do not reuse this pool when loading the kernel
+    if (pool)            bs->FreePages(pool, pool_pages);
+    if (page_map.kernel) bs->FreePages(page_map.kernel, kernel_pages);
+    if (page_map.stack)  bs->FreePages(page_map.stack, KERNEL_STACK_PAGES);
+    if (mmap.map)        bs->FreePool(mmap.map);
+
+    printf_c16(u"\r\nPress any key to go back...\r\n");
+    get_key();
+    return EFI_SUCCESS;
+}
+
 // =======================================
 // Print configuration table GUID values
 // =======================================
 EFI_STATUS print_config_tables(void) { 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
     // Close Timer Event for cleanup
     bs->CloseEvent(timer_event);
@@ -1716,10 +2211,10 @@ EFI_STATUS print_config_tables(void) {
                found ? config_table_guids_and_strings[j].string : u"Unknown GUID Value");
 
         // Pause at bottom of screen
-        if (cout->Mode->CursorRow >= text_rows-2) {
+        if (cursor_row(cout) >= text_rows-2) {
             printf_c16(u"Press any key to continue...\r\n");
             get_key();
-            cout->ClearScreen(cout);
+            clear_screen(cout);
         }
     }
 
@@ -1732,7 +2227,7 @@ EFI_STATUS print_config_tables(void) {
 // Print configuration table GUID values
 // =======================================
 EFI_STATUS print_acpi_tables(void) { 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
     // Close Timer Event for cleanup
     bs->CloseEvent(timer_event);
@@ -1796,17 +2291,17 @@ EFI_STATUS print_acpi_tables(void) {
         printf_c16(u"\r\nPress any key to print entries...\r\n");
         get_key();
 
-        cout->ClearScreen(cout);
+        clear_screen(cout);
         printf_c16(u"Entries:\r\n");
         UINT64 *entry = (UINT64 *)((UINT8 *)header + sizeof *header); 
         for (UINTN i = 0; i < (header->length - sizeof *header) / 8; i++) {
             ACPI_TABLE_HEADER table_header = *(ACPI_TABLE_HEADER *)entry[i];
             printf_c16(u"%.4hhs\r\n", &table_header.signature[0]);
 
-            if (cout->Mode->CursorRow >= text_rows-2) {
+            if (cursor_row(cout) >= text_rows-2) {
                 printf_c16(u"Press any key to continue...\r\n");
                 get_key();
-                cout->ClearScreen(cout);
+                clear_screen(cout);
             }
         }
 
@@ -1815,7 +2310,7 @@ EFI_STATUS print_acpi_tables(void) {
 
         // Loop and print each ACPI table
         for (UINTN i = 0; i < (header->length - sizeof *header) / 8; i++) {
-            cout->ClearScreen(cout);
+            clear_screen(cout);
 
             // Print header
             ACPI_TABLE_HEADER table_header = *(ACPI_TABLE_HEADER *)entry[i];
@@ -1840,17 +2335,17 @@ EFI_STATUS print_acpi_tables(void) {
         printf_c16(u"\r\nPress any key to print entries...\r\n");
         get_key();
 
-        cout->ClearScreen(cout);
+        clear_screen(cout);
         printf_c16(u"Entries:\r\n");
         UINT32 *entry = (UINT32 *)((UINT8 *)header + sizeof *header); 
         for (UINTN i = 0; i < (header->length - sizeof *header) / 4; i++) {
             ACPI_TABLE_HEADER table_header = *(ACPI_TABLE_HEADER *)(UINTN)entry[i];
             printf_c16(u"%.4hhs\r\n", &table_header.signature[0]);
 
-            if (cout->Mode->CursorRow >= text_rows-2) {
+            if (cursor_row(cout) >= text_rows-2) {
                 printf_c16(u"Press any key to continue...\r\n");
                 get_key();
-                cout->ClearScreen(cout);
+                clear_screen(cout);
             }
         }
 
@@ -1859,7 +2354,7 @@ EFI_STATUS print_acpi_tables(void) {
 
         // Loop and print each ACPI table
         for (UINTN i = 0; i < (header->length - sizeof *header) / 4; i++) {
-            cout->ClearScreen(cout);
+            clear_screen(cout);
 
             // Print header
             ACPI_TABLE_HEADER table_header = *(ACPI_TABLE_HEADER *)(UINTN)entry[i];
@@ -1881,7 +2376,7 @@ EFI_STATUS print_acpi_tables(void) {
 // Print all EFI Global Variables
 // ================================
 EFI_STATUS print_efi_global_variables(void) { 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
 
     // Close Timer Event for cleanup
     bs->CloseEvent(timer_event);
@@ -1926,10 +2421,10 @@ EFI_STATUS print_efi_global_variables(void) {
         printf_c16(u"%.*s\r\n", var_name_size, var_name_buf);
 
         // Pause at bottom of screen
-        if (cout->Mode->CursorRow >= text_rows-2) {
+        if (cursor_row(cout) >= text_rows-2) {
             printf_c16(u"Press any key to continue...\r\n");
             get_key();
-            cout->ClearScreen(cout);
+            clear_screen(cout);
         }
         status = rs->GetNextVariableName(&var_name_size, var_name_buf, &vendor_guid);
     }
@@ -1962,7 +2457,7 @@ EFI_STATUS change_boot_variables(void) {
     // Overall screen loop
     UINT32 boot_order_attributes = 0;
     while (true) {
-        cout->ClearScreen(cout);
+        clear_screen(cout);
 
         UINTN var_name_size = 0;
         CHAR16 *var_name_buf = 0;
@@ -2090,10 +2585,10 @@ EFI_STATUS change_boot_variables(void) {
             }
 
             // Pause at bottom of screen
-            if (cout->Mode->CursorRow >= text_rows-2) {
+            if (cursor_row(cout) >= text_rows-2) {
                 printf_c16(u"Press any key to continue...\r\n");
                 get_key();
-                cout->ClearScreen(cout);
+                clear_screen(cout);
             }
             status = rs->GetNextVariableName(&var_name_size, var_name_buf, &vendor_guid);
         }
@@ -2160,18 +2655,7 @@ EFI_STATUS install_to_disk(void) {
     CHAR16 *path = u"\\EFI\\BOOT\\INSTALL.DAT";
     printf_c16(u"\r\nInstall to disk by writing file '%s' (Y/N)?  ", path);
 
-    bool yes = false, no = false;
-    EFI_INPUT_KEY key = get_key();
-    while (key.UnicodeChar != u'\r' && key.ScanCode != SCANCODE_ESC) {
-        yes = no = false;
-        yes = (key.UnicodeChar == 'Y' || key.UnicodeChar == 'y');
-        no  = (key.UnicodeChar == 'N' || key.UnicodeChar == 'n');
-        if (yes || no) printf_c16(u"\b%c", key.UnicodeChar);    // Overwrite character at same position
-        key = get_key();
-    }
-    printf_c16(u"\r\n");
-
-    if (yes) {
+    if (get_yes_no()) {
         EFI_FILE_PROTOCOL *root = esp_root_dir();
         if (!root) {
             error(0, u"Could not get ESP root directory.\r\n");
@@ -2211,14 +2695,14 @@ EFI_STATUS install_to_disk(void) {
 
         // Write GOP mode & values to file
         char buf[512];
-        sprintf(buf, "GOP_MODE=%u\r\n"
-                     "XRES=%u\r\n"
-                     "YRES=%u\r\n",
-                     mode_num,
-                     fb_width,
-                     fb_height);
+        UINTN buf_size = snprintf(buf, sizeof buf, 
+                                  "GOP_MODE=%u\r\n"
+                                  "XRES=%u\r\n"
+                                  "YRES=%u\r\n",
+                                  mode_num,
+                                  fb_width,
+                                  fb_height);
                 
-        UINTN buf_size = strlen(buf);
         status = file->Write(file, &buf_size, buf);
         if (EFI_ERROR(status)) {
             error(status, u"Issue writing GOP info to file '%s'.\r\n", path);
@@ -2231,27 +2715,331 @@ EFI_STATUS install_to_disk(void) {
                path);
         get_key();
 
-        // Cleanup file/directory pointers
+        // Cleanup file pointer
         cleanup:
         if (file) file->Close(file);
-        if (root) root->Close(root);
     }
 
     return status;
 }
 
+// ===================================================================
+// Calibrate timestamp counter against boot services Stall()
+// Returns: timestamp ticks per microsecond, or 0 if it could not
+//   be calibrated
+// ===================================================================
+UINT64 timestamp_ticks_per_us(void) {
+    const UINTN CALIBRATE_US = 10000;
+    UINT64 start = arch_timestamp();
+    bs->Stall(CALIBRATE_US);
+    return (arch_timestamp() - start) / CALIBRATE_US;
+}
+
+// ===================================================================
+// Start reading a copy_disk() chunk from the source disk, and also
+//   from the target disk into target if given (delta mode)
+// Returns: EFI_SUCCESS or error status from starting a read
+// ===================================================================
+EFI_STATUS copy_disk_read_chunk(Disk_Info *from, Disk_Info *to, UINT64 offset, UINTN bytes, 
+                                Disk_Copy_Buffer *buf, Disk_Copy_Buffer *target) {
+    EFI_STATUS status = disk_copy_start(from, false, offset, bytes, buf);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not read disk image at byte offset %llu.\r\n", offset);
+        return status;
+    }
+
+    if (target) {
+        status = disk_copy_start(to, false, offset, bytes, target);
+        if (EFI_ERROR(status)) 
+            error(status, u"Could not read chosen disk at byte offset %llu.\r\n", offset);
+    }
+    return status;
+}
+
+// ==========================================================================
+// Read back size bytes from the start of a disk in chunk_size chunks, with
+//   all DISK_COPY_BUFFERS buffers reading at once, and compare the CRC32 of
+//   each chunk to chunk_crcs from copy_disk(). Prints throughput & the LBA
+//   range of each run of chunks that do not match.
+//
+// Returns: EFI_SUCCESS if all chunks match, EFI_CRC_ERROR if any do not, 
+//   or error status from a read
+// ==========================================================================
+EFI_STATUS verify_disk_copy(Disk_Info *disk, UINT64 size, UINTN chunk_size, 
+                            Disk_Copy_Buffer *bufs, UINT32 *chunk_crcs) {
+    EFI_STATUS status = EFI_SUCCESS;
+    const UINTN N = DISK_COPY_BUFFERS;
+    UINTN num_chunks = (size + (chunk_size-1)) / chunk_size;
+    UINTN mismatches = 0;
+    UINT64 bad_start = 0;       // Byte offset of current run of mismatching chunks
+    bool in_bad_run = false;
+
+    printf_c16(u"Verifying %llu MiB...\r\n", size / (1024*1024));
+
+    UINT64 ticks_per_us = timestamp_ticks_per_us();
+    UINT64 start = arch_timestamp(), last_print = start;
+
+    for (UINTN c = 0; c < N && c < num_chunks; c++) {
+        UINT64 offset = (UINT64)c * chunk_size;
+        status = disk_copy_start(disk, false, offset, min(chunk_size, size - offset), &bufs[c]);
+        if (EFI_ERROR(status)) {
+            error(status, u"Could not read chosen disk at byte offset %llu.\r\n", offset);
+            return status;
+        }
+    }
+
+    // For each chunk: when its read is done check its CRC, then reuse the buffer to read N ahead
+    for (UINTN c = 0; c < num_chunks; c++) {
+        Disk_Copy_Buffer *buf = &bufs[c % N];
+        UINT64 offset = (UINT64)c * chunk_size;
+        UINTN bytes = min(chunk_size, size - offset);
+
+        status = disk_copy_wait(buf);
+        if (EFI_ERROR(status)) {
+            error(status, u"Could not read chosen disk at byte offset %llu.\r\n", offset);
+            return status;
+        }
+
+        bool bad = crc32_update(0, buf->data, bytes) != chunk_crcs[c];
+
+        if (c + N < num_chunks) {
+            UINT64 ahead = (UINT64)(c + N) * chunk_size;
+            status = disk_copy_start(disk, false, ahead, min(chunk_size, size - ahead), buf);
+            if (EFI_ERROR(status)) {
+                error(status, u"Could not read chosen disk at byte offset %llu.\r\n", ahead);
+                return status;
+            }
+        }
+
+        // Print each run of mismatching chunks once it ends
+        if (bad) mismatches++;
+        if (bad && !in_bad_run) bad_start = offset;
+        if (!bad && in_bad_run) {
+            printf_c16(u"\rMismatch at LBAs %llu-%llu              \r\n", 
+                       bad_start / disk->block_size, offset / disk->block_size - 1);
+        }
+        in_bad_run = bad;
+
+        // Live progress, ~4 times a second
+        UINT64 now = arch_timestamp();
+        if (ticks_per_us > 0 && now - last_print >= ticks_per_us * 250000) {
+            UINT64 us = max((now - start) / ticks_per_us, 1);
+            printf_c16(u"\r%llu/%llu MiB, %llu MB/s    ", 
+                       (offset + bytes) / (1024*1024), size / (1024*1024), (offset + bytes) / us);
+            flush_c16(cout);
+            last_print = now;
+        }
+    }
+
+    if (in_bad_run) {
+        printf_c16(u"\rMismatch at LBAs %llu-%llu              \r\n", 
+                   bad_start / disk->block_size, size / disk->block_size - 1);
+    }
+
+    if (ticks_per_us > 0) {
+        UINT64 us = max((arch_timestamp() - start) / ticks_per_us, 1);
+        printf_c16(u"\rVerified %llu MiB in %llu ms, %llu MB/s    \r\n", 
+                   size / (1024*1024), us / 1000, size / us);
+    }
+
+    if (mismatches > 0) {
+        error(EFI_CRC_ERROR, u"Chosen disk does not match disk image in %u of %u chunks.\r\n", 
+              mismatches, num_chunks);
+        return EFI_CRC_ERROR;
+    }
+
+    printf_c16(u"All %u chunks match.\r\n", num_chunks);
+    return EFI_SUCCESS;
+}
+
+// ==========================================================================
+// Copy size bytes from the start of 1 disk to the start of another, in
+//   chunk_size chunks through DISK_COPY_BUFFERS buffers round robin: while
+//   1 chunk is being written, the next chunks are already being read.
+//   Memory use is bounded by the buffers, not the copy size. 
+//   DISK_COPY_SPARSE skips writing all zero chunks, and DISK_COPY_DELTA 
+//   also reads each chunk from the target and skips writing it if equal.
+//   Prints live progress & throughput, and bytes written vs skipped.
+//   If verify is true, the CRC32 of each chunk is taken as it is read, and
+//   the target is read back after the copy with verify_disk_copy().
+//
+// Returns: EFI_SUCCESS or error status from a read, write, or verify
+// ==========================================================================
+EFI_STATUS copy_disk(Disk_Info *from, Disk_Info *to, UINT64 size, UINTN chunk_size, 
+                     Disk_Copy_Mode mode, bool verify) {
+    EFI_STATUS status = EFI_SUCCESS;
+    UINT32 *chunk_crcs = NULL;
+    const UINTN N = DISK_COPY_BUFFERS;
+    Disk_Copy_Buffer bufs[DISK_COPY_BUFFERS] = {0};
+    Disk_Copy_Buffer target_bufs[DISK_COPY_BUFFERS] = {0};     // Delta mode only
+    const bool delta = mode == DISK_COPY_DELTA;
+
+    // Chunks & total size are whole blocks on both disks (block sizes are powers of 2)
+    UINTN block_size = max(from->block_size, to->block_size);
+    chunk_size = max((chunk_size + (block_size-1)) & ~(block_size-1), block_size);
+    size = (size + (block_size-1)) & ~((UINT64)block_size-1);
+    UINTN num_chunks = (size + (chunk_size-1)) / chunk_size;
+    UINTN chunk_pages = (chunk_size + (PAGE_SIZE-1)) / PAGE_SIZE;
+    UINTN total_pages = (delta ? 2*N : N) * chunk_pages;
+
+    EFI_PHYSICAL_ADDRESS buffer = 0;
+    status = bs->AllocatePages(AllocateAnyPages, EfiLoaderData, total_pages, &buffer);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate %u disk copy buffers of %u KiB.\r\n", 
+              delta ? 2*N : N, chunk_size / 1024);
+        return status;
+    }
+
+    if (verify) {
+        status = bs->AllocatePool(EfiLoaderData, num_chunks * sizeof *chunk_crcs, (VOID **)&chunk_crcs);
+        if (EFI_ERROR(status)) {
+            error(status, u"Could not allocate CRC32 for %u chunks.\r\n", num_chunks);
+            bs->FreePages(buffer, total_pages);
+            return status;
+        }
+    }
+
+    // Events for async Block IO 2 reads/writes; without one a buffer uses blocking Block IO
+    for (UINTN i = 0; i < N; i++) {
+        bufs[i].data = (UINT8 *)buffer + i * chunk_pages * PAGE_SIZE;
+        if ((from->biop2 || to->biop2) && 
+            EFI_ERROR(bs->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &bufs[i].token.Event)))
+            bufs[i].token.Event = NULL;
+
+        if (!delta) continue;
+        target_bufs[i].data = (UINT8 *)buffer + (N + i) * chunk_pages * PAGE_SIZE;
+        if (to->biop2 && 
+            EFI_ERROR(bs->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &target_bufs[i].token.Event)))
+            target_bufs[i].token.Event = NULL;
+    }
+
+    printf_c16(u"Copying %llu MiB in %u KiB chunks, %u buffers, %s reads, %s writes, %s mode...\r\n",
+               size / (1024*1024), chunk_size / 1024, N,
+               from->biop2 && bufs[0].token.Event ? u"async" : u"blocking",
+               to->biop2 && bufs[0].token.Event ? u"async" : u"blocking",
+               mode == DISK_COPY_SPARSE ? u"sparse" : delta ? u"delta" : u"full");
+
+    UINT64 ticks_per_us = timestamp_ticks_per_us();
+    UINT64 start = arch_timestamp(), last_print = start;
+    UINT64 written = 0, skipped = 0;
+
+    // Read ahead the first N-1 chunks
+    for (UINTN c = 0; c < N-1 && c < num_chunks; c++) {
+        UINT64 offset = (UINT64)c * chunk_size;
+        status = copy_disk_read_chunk(from, to, offset, min(chunk_size, size - offset), 
+                                      &bufs[c], delta ? &target_bufs[c] : NULL);
+        if (EFI_ERROR(status)) goto cleanup;
+    }
+
+    // For each chunk: when its read is done start its write, then when the previous chunk's
+    //   write is done reuse that buffer to read the chunk N-1 ahead
+    for (UINTN c = 0; c < num_chunks; c++) {
+        Disk_Copy_Buffer *buf = &bufs[c % N], *prev = &bufs[(c + N-1) % N];
+        Disk_Copy_Buffer *target = delta ? &target_bufs[c % N] : NULL;
+        UINT64 offset = (UINT64)c * chunk_size;
+        UINTN bytes = min(chunk_size, size - offset);
+
+        status = disk_copy_wait(buf);
+        if (EFI_ERROR(status)) {
+            error(status, u"Could not read disk image at byte offset %llu.\r\n", offset);
+            goto cleanup;
+        }
+
+        if (target) {
+            status = disk_copy_wait(target);
+            if (EFI_ERROR(status)) {
+                error(status, u"Could not read chosen disk at byte offset %llu.\r\n", offset);
+                goto cleanup;
+            }
+        }
+
+        // CRC32 while the next chunks are being read, to check against the target afterwards
+        if (chunk_crcs) chunk_crcs[c] = crc32_update(0, buf->data, bytes);
+
+        // Skip chunks the target already has
+        if ((mode == DISK_COPY_SPARSE && mem_is_zero(buf->data, bytes)) || 
+            (delta && !memcmp(buf->data, target->data, bytes))) {
+            skipped += bytes;
+        } else {
+            status = disk_copy_start(to, true, offset, bytes, buf);
+            if (EFI_ERROR(status)) {
+                error(status, u"Could not write chosen disk at byte offset %llu.\r\n", offset);
+                goto cleanup;
+            }
+            written += bytes;
+        }
+
+        if (c > 0) {
+            status = disk_copy_wait(prev);
+            if (EFI_ERROR(status)) {
+                error(status, u"Could not write chosen disk at byte offset %llu.\r\n", offset - chunk_size);
+                goto cleanup;
+            }
+        }
+
+        if (c + N-1 < num_chunks) {
+            UINT64 ahead = (UINT64)(c + N-1) * chunk_size;
+            status = copy_disk_read_chunk(from, to, ahead, min(chunk_size, size - ahead), 
+                                          prev, delta ? &target_bufs[(c + N-1) % N] : NULL);
+            if (EFI_ERROR(status)) goto cleanup;
+        }
+
+        // Live progress, ~4 times a second
+        UINT64 now = arch_timestamp();
+        if (ticks_per_us > 0 && now - last_print >= ticks_per_us * 250000) {
+            UINT64 us = max((now - start) / ticks_per_us, 1);
+            UINT64 done = offset + bytes;
+            printf_c16(u"\r%llu/%llu MiB, %llu MB/s, %llu MiB written, %llu MiB skipped    ", 
+                       done / (1024*1024), size / (1024*1024), done / us, 
+                       written / (1024*1024), skipped / (1024*1024));
+            flush_c16(cout);
+            last_print = now;
+        }
+    }
+
+    // Last chunk's write
+    status = disk_copy_wait(&bufs[(num_chunks-1) % N]);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not write chosen disk at byte offset %llu.\r\n", 
+              (UINT64)(num_chunks-1) * chunk_size);
+        goto cleanup;
+    }
+
+    if (to->biop && written > 0) to->biop->FlushBlocks(to->biop);
+
+    if (ticks_per_us > 0) {
+        UINT64 us = max((arch_timestamp() - start) / ticks_per_us, 1);
+        printf_c16(u"\r\nCopied %llu MiB in %llu ms, %llu MB/s\r\n", 
+                   size / (1024*1024), us / 1000, size / us);
+    }
+    printf_c16(u"Bytes written: %llu, bytes skipped: %llu\r\n", written, skipped);
+
+    if (chunk_crcs) status = verify_disk_copy(to, size, chunk_size, bufs, chunk_crcs);
+
+    cleanup:
+    // Wait for any reads/writes still in flight before freeing their buffers
+    for (UINTN i = 0; i < N; i++) {
+        disk_copy_wait(&bufs[i]);
+        disk_copy_wait(&target_bufs[i]);
+        if (bufs[i].token.Event) bs->CloseEvent(bufs[i].token.Event);
+        if (target_bufs[i].token.Event) bs->CloseEvent(target_bufs[i].token.Event);
+    }
+    bs->FreePages(buffer, total_pages);
+    if (chunk_crcs) bs->FreePool(chunk_crcs);
+    return status;
+}
+
 // ===================================================
 // Write disk image to other disk (blockIO media ID)
 // ===================================================
 EFI_STATUS write_to_another_disk(void) { 
     EFI_STATUS status = EFI_SUCCESS;
-    EFI_GUID bio_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
-    EFI_BLOCK_IO_PROTOCOL *biop;
-    UINTN num_handles = 0;
-    EFI_HANDLE *handle_buffer = NULL;
     EFI_BLOCK_IO_PROTOCOL *disk_image_bio = NULL, *chosen_disk_bio = NULL;
 
-    cout->ClearScreen(cout);
+    clear_screen(cout);
+
+    // Close Timer Event for cleanup, so the clock does not print over copy progress
+    bs->CloseEvent(timer_event);
 
     // Get media ID for this disk image first, to compare to others in output
     UINT32 disk_image_media_id = 0;
@@ -2261,67 +3049,31 @@ EFI_STATUS write_to_another_disk(void) {
         return status;
     }
 
-    // Get size of disk image from file 
-    CHAR16 *file_name = u"\\EFI\\BOOT\\FILE.TXT";
-    UINTN buf_size = 0;
-    VOID *file_buffer = NULL;
-    file_buffer = read_esp_file_to_buffer(file_name, &buf_size);
-    if (!file_buffer) {
-        error(0, u"Could not find or read file '%s' to buffer\r\n", file_name);
-        return 1;
-    }
-
-    char *str_pos = strstr(file_buffer, "DISK_SIZE=");
-    if (!str_pos) {
-        error(0, u"Could not find disk image size in FILE.TXT\r\n");
+    // Get size of disk image from data file index
+    if (!build_data_file_index() || data_file_index.disk_size == 0) {
+        error(0, u"Could not find disk image size in FILE.IDX or FILE.TXT\r\n");
         return 1;
     }
-
-    str_pos += strlen("DISK_SIZE=");
-    UINTN disk_image_size = atoi(str_pos);
-
-    // Free file buffer when done
-    bs->FreePool(file_buffer);
+    UINTN disk_image_size = data_file_index.disk_size;
 
     // Loop through and print all full disk Block IO protocol Media 
-    status = bs->LocateHandleBuffer(ByProtocol, &bio_guid, NULL, &num_handles, &handle_buffer);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not locate any Block IO Protocols.\r\n");
-        return status;
-    }
-
-    UINT32 last_media_id = -1;  // Keep track of currently opened Media info
-    for (UINTN i = 0; i < num_handles; i++) {
-        status = bs->OpenProtocol(handle_buffer[i], 
-                                  &bio_guid,
-                                  (VOID **)&biop,
-                                  image,
-                                  NULL,
-                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);  // Don't have to use CloseProtocol()
-        if (EFI_ERROR(status)) {
-            error(status, u"Could not Get Block IO protocol on handle %u.\r\n", i);
-            continue;
-        }
-
-        if (biop->Media->LastBlock == 0 || biop->Media->LogicalPartition ||
-            !biop->Media->MediaPresent  || biop->Media->ReadOnly) {
-            // Only care about partitions/disks above 1 block in size, 
-            // Block IOs for the "whole" disk (not a logical partition), 
+    disk_image_bio = disk_table.image_disk->biop;
+    for (UINTN i = 0; i < disk_table.num_disks; i++) {
+        EFI_BLOCK_IO_PROTOCOL *biop = disk_table.disks[i].biop;
+
+        if (!biop || biop->Media->LastBlock == 0 ||
+            !biop->Media->MediaPresent || biop->Media->ReadOnly) {
+            // Only care about Block IOs for the "whole" disk (not a logical partition), 
+            // disks above 1 block in size, 
             // Media that is currently present,
             // And media that can be written to
             continue;
         }
 
-        // Print Block IO Media Info for this Disk/partition
-        if (last_media_id != biop->Media->MediaId) {
-            last_media_id = biop->Media->MediaId;   
-            printf_c16(u"Media ID: %u %s\r\n", 
-                   last_media_id, 
-                   (last_media_id == disk_image_media_id ? u"(Disk Image)" : u""));
-
-            if (last_media_id == disk_image_media_id) 
-                disk_image_bio = biop; // Save for later
-        }
+        // Print Block IO Media Info for this Disk
+        printf_c16(u"Media ID: %u %s\r\n", 
+               biop->Media->MediaId, 
+               (biop->Media->MediaId == disk_image_media_id ? u"(Disk Image)" : u""));
 
         // Get disk size in bytes, add 1 block for 0-based indexing fun
         UINTN size = (biop->Media->LastBlock+1) * biop->Media->BlockSize; 
@@ -2346,85 +3098,231 @@ EFI_STATUS write_to_another_disk(void) {
     printf_c16(u"\r\n");
 
     // Get Block IO for chosen disk media
-    bool found = false;
-    for (UINTN i = 0; i < num_handles; i++) {
-        status = bs->OpenProtocol(handle_buffer[i], 
-                                  &bio_guid,
-                                  (VOID **)&biop,
-                                  image,
-                                  NULL,
-                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);  // Don't have to use CloseProtocol()
-        if (EFI_ERROR(status)) {
-            error(status, u"Could not Get Block IO protocol on handle %u.\r\n", i);
-            continue;
-        }
+    Disk_Info *chosen_disk = find_disk(chosen_media);
+    if (chosen_disk) chosen_disk_bio = chosen_disk->biop;
 
-        if (biop->Media->MediaId == chosen_media) {
-            chosen_disk_bio = biop;
-            found = true;
-            break;
-        }
+    if (!chosen_disk_bio) {
+        error(0, u"Could not find media with ID %u\r\n", chosen_media);
+        return 1;
     }
 
-    if (!found) {
-        error(0, u"Could not find media with ID %u\r\n", chosen_media);
+    if (!disk_image_bio) {
+        error(0, u"Could not find whole disk Block IO for disk image media ID %u\r\n", 
+              disk_image_media_id);
+        return 1;
+    }
+
+    if (chosen_disk == disk_table.image_disk) {
+        error(0, u"Can not write disk image to itself, media ID %u\r\n", chosen_media);
         return 1;
     }
 
+    if ((chosen_disk->last_block+1) * chosen_disk->block_size < disk_image_size) {
+        error(0, u"Disk image does not fit on media ID %u\r\n", chosen_media);
+        return 1;
+    }
+
+    // Chunk size for streaming copy, so memory use is bounded and reads overlap writes
+    printf_c16(u"Input copy chunk size in KiB and press enter (enter = %u KiB): ", 
+               DISK_COPY_CHUNK_SIZE / 1024);
+    UINTN chunk_kib = 0;
+    get_num(&chunk_kib, 10);
+    printf_c16(u"\r\n");
+    UINTN chunk_size = chunk_kib > 0 ? chunk_kib * 1024 : DISK_COPY_CHUNK_SIZE;
+
+    // Copy mode, to write less when the chosen disk already has most of the image
+    printf_c16(u"Copy modes:\r\n"
+               u"  1 = full, write every chunk\r\n"
+               u"  2 = sparse, skip all zero chunks; chosen disk must already be zeroed\r\n"
+               u"  3 = delta, read chosen disk and only write chunks that differ\r\n"
+               u"Input copy mode and press enter (enter = full): ");
+    UINTN mode_num = 0;
+    get_num(&mode_num, 10);
+    printf_c16(u"\r\n");
+    Disk_Copy_Mode mode = mode_num == 2 ? DISK_COPY_SPARSE : 
+                          mode_num == 3 ? DISK_COPY_DELTA  : DISK_COPY_FULL;
+
+    // CRC32 of each chunk is taken while copying, so verifying only reads back the chosen disk
+    printf_c16(u"Verify chosen disk after writing (Y/N)?  ");
+    bool verify = get_yes_no();
+
     // Ask user to install bootloader yes/no. If yes, will autoload kernel on next
     //   boot from new disk from existence of new "install" file.
     install_to_disk();
 
     // Print info about chosen disk and disk image
-    // block size for from and to disks
-    UINTN from_block_size = disk_image_bio->Media->BlockSize, 
-          to_block_size = chosen_disk_bio->Media->BlockSize;
+    printf_c16(u"From block size: %u, To block size: %u\r\n",
+               disk_table.image_disk->block_size, chosen_disk->block_size);
 
-    UINTN from_blocks = (disk_image_size + (from_block_size-1)) / from_block_size;
-    UINTN to_blocks = (disk_image_size + (to_block_size-1)) / to_block_size;
+    status = copy_disk(disk_table.image_disk, chosen_disk, disk_image_size, chunk_size, mode, verify);
+    if (EFI_ERROR(status)) return status;
 
-    printf_c16(u"From block size: %u, To block size: %u\r\n"
-           u"From blocks: %u, To blocks: %u\r\n",
-           from_block_size, to_block_size,
-           from_blocks, to_blocks);
+    printf_c16(u"\r\nDisk Image written to chosen disk.\r\n"
+           u"Reboot and choose new boot option when able.\r\n");
 
-    // Allocate buffer to hold copy of disk image
-    VOID *image_buffer = NULL;
-    status = bs->AllocatePool(EfiLoaderData, disk_image_size, &image_buffer);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not allocate memory for disk image.\r\n");
-        return status;
-    }
+    printf_c16(u"\r\nPress any key to go back...\r\n");
+    get_key();
+    return EFI_SUCCESS;
+}
 
-    // Read Blocks from disk image media to buffer
-    printf_c16(u"Reading %u blocks from disk image disk to buffer...\r\n", from_blocks);
-    status = disk_image_bio->ReadBlocks(disk_image_bio,
-                                        disk_image_media_id,
-                                        0,
-                                        from_blocks * from_block_size,
-                                        image_buffer);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not read blocks from disk image media to buffer.\r\n");
-        return status;
-    }
+// ==========================================================================
+// Benchmark efi_lib.h helpers on this machine, print 1 CSV line per
+//   function and size: name,bytes,ns/op,MB/s
+// ==========================================================================
+EFI_STATUS benchmark_lib_helpers(void) { 
+    clear_screen(cout);
+
+    // Close Timer Event for cleanup
+    bs->CloseEvent(timer_event);
 
-    // Write Blocks from buffer to chosen media disk 
-    printf_c16(u"Writing %u blocks from buffer to chosen disk...\r\n", to_blocks);
-    status = chosen_disk_bio->WriteBlocks(chosen_disk_bio,
-                                          chosen_media,
-                                          0,
-                                          to_blocks * to_block_size,
-                                          image_buffer);
+    // Calibrate timestamp counter against boot services Stall() (microseconds)
+    UINT64 ticks_per_us = timestamp_ticks_per_us();
+    if (ticks_per_us == 0) {
+        error(0, u"Could not calibrate timestamp counter.\r\n");
+        return EFI_UNSUPPORTED;
+    }
+    UINT64 start = 0;
+
+    // Allocate source & destination buffers for largest size
+    const UINTN sizes[] = { 16, 256, 4096, 65536, 1024*1024 };
+    const UINTN MAX_SIZE = sizes[ARRAY_SIZE(sizes)-1];
+    const UINTN TOTAL_BYTES = 64*1024*1024;    // Bytes to process per function & size
+    EFI_PHYSICAL_ADDRESS bufs = 0;
+    EFI_STATUS status = bs->AllocatePages(AllocateAnyPages, EfiLoaderData, 
+                                          (2*MAX_SIZE + 64) / PAGE_SIZE + 1, &bufs);
     if (EFI_ERROR(status)) {
-        error(status, u"Could not write blocks from buffer to chosen disk.\r\n");
+        error(status, u"Could not allocate benchmark buffers.\r\n");
         return status;
     }
+    UINT8 *src = (UINT8 *)bufs;
+    UINT8 *dst = src + MAX_SIZE + 64;
+    memset(src, 'A', MAX_SIZE + 64);
+    src[MAX_SIZE] = '\0';  // For strlen
+
+    struct {
+        char *name;
+        VOID *(*func)(VOID *, VOID *, UINTN);
+    } copy_funcs[] = {
+        { "memcpy_bytes", memcpy_bytes },
+        { "memcpy_words", memcpy_words },
+        { "memcpy_wide",  memcpy_wide  },
+        { "memcpy",       memcpy       },
+        { "memmove",      memmove      },
+    };
 
-    // Cleanup
-    bs->FreePool(image_buffer);
+    struct {
+        char *name;
+        VOID *(*func)(VOID *, UINT8, UINTN);
+    } set_funcs[] = {
+        { "memset_bytes", memset_bytes },
+        { "memset_words", memset_words },
+        { "memset_wide",  memset_wide  },
+        { "memset",       memset       },
+    };
 
-    printf_c16(u"\r\nDisk Image written to chosen disk.\r\n"
-           u"Reboot and choose new boot option when able.\r\n");
+    struct {
+        char *name;
+        INTN (*func)(VOID *, VOID *, UINTN);
+    } cmp_funcs[] = {
+        { "memcmp_bytes", memcmp_bytes },
+        { "memcmp_words", memcmp_words },
+        { "memcmp",       memcmp       },
+    };
+
+    struct {
+        char *name;
+        bool (*func)(VOID *, UINTN);
+    } zero_funcs[] = {
+        { "mem_is_zero_words", mem_is_zero_words },
+        { "mem_is_zero",       mem_is_zero       },
+    };
+
+    printf_c16(u"Timestamp ticks/us: %llu, memcpy/memset method: %u\r\n"
+               u"name,bytes,ns/op,MB/s\r\n", 
+               ticks_per_us, mem_method);
+
+    for (UINTN i = 0; i < ARRAY_SIZE(sizes); i++) {
+        UINTN size = sizes[i];
+        UINTN iters = TOTAL_BYTES / size;
+
+        // Use misaligned dst by 1 byte, to also time head/tail handling
+        for (UINTN j = 0; j < ARRAY_SIZE(copy_funcs); j++) {
+            start = arch_timestamp();
+            for (UINTN k = 0; k < iters; k++) copy_funcs[j].func(dst + 1, src, size);
+            UINT64 us = (arch_timestamp() - start) / ticks_per_us;
+
+            printf_c16(u"%hhs,%llu,%llu,%llu\r\n", copy_funcs[j].name, size, 
+                       (us * 1000) / iters, us ? TOTAL_BYTES / us : 0);
+        }
+
+        for (UINTN j = 0; j < ARRAY_SIZE(set_funcs); j++) {
+            start = arch_timestamp();
+            for (UINTN k = 0; k < iters; k++) set_funcs[j].func(dst + 1, 'B', size);
+            UINT64 us = (arch_timestamp() - start) / ticks_per_us;
+
+            printf_c16(u"%hhs,%llu,%llu,%llu\r\n", set_funcs[j].name, size, 
+                       (us * 1000) / iters, us ? TOTAL_BYTES / us : 0);
+        }
+
+        memcpy(dst, src, size);     // Equal buffers to compare all bytes
+        for (UINTN j = 0; j < ARRAY_SIZE(cmp_funcs); j++) {
+            start = arch_timestamp();
+            for (UINTN k = 0; k < iters; k++) cmp_funcs[j].func(dst, src, size);
+            UINT64 us = (arch_timestamp() - start) / ticks_per_us;
+
+            printf_c16(u"%hhs,%llu,%llu,%llu\r\n", cmp_funcs[j].name, size, 
+                       (us * 1000) / iters, us ? TOTAL_BYTES / us : 0);
+        }
+
+        memset(dst, 0, size);       // All zero buffer to check all bytes
+        for (UINTN j = 0; j < ARRAY_SIZE(zero_funcs); j++) {
+            start = arch_timestamp();
+            for (UINTN k = 0; k < iters; k++) zero_funcs[j].func(dst, size);
+            UINT64 us = (arch_timestamp() - start) / ticks_per_us;
+
+            printf_c16(u"%hhs,%llu,%llu,%llu\r\n", zero_funcs[j].name, size, 
+                       (us * 1000) / iters, us ? TOTAL_BYTES / us : 0);
+        }
+
+        // Pause if reached bottom of screen
+        if (cursor_row(cout) >= text_rows-2) {
+            printf_c16(u"Press any key to continue...\r\n");
+            get_key();
+            clear_screen(cout);
+        }
+    }
+
+    // strlen over largest buffer
+    UINTN iters = TOTAL_BYTES / MAX_SIZE;
+    start = arch_timestamp();
+    for (UINTN k = 0; k < iters; k++) strlen((char *)src);
+    UINT64 us = (arch_timestamp() - start) / ticks_per_us;
+    printf_c16(u"strlen,%llu,%llu,%llu\r\n", MAX_SIZE, (us * 1000) / iters, us ? TOTAL_BYTES / us : 0);
+
+    // Formatted strings, using a typical line from print_memory_map()
+    const UINTN FORMAT_ITERS = 100000;
+    CHAR16 buf_c16[128];
+    UINTN len = 0;
+    start = arch_timestamp();
+    for (UINTN k = 0; k < FORMAT_ITERS; k++) 
+        len = snprintf_c16(buf_c16, ARRAY_SIZE(buf_c16), 
+                           u"%u: Typ: %u, Phy: %x, Vrt: %x, Pgs: %u, Att: %x\r\n",
+                           k, 7, 0x100000 + k, 0, 0x7F00, 0xF);
+    us = (arch_timestamp() - start) / ticks_per_us;
+    printf_c16(u"snprintf_c16,%llu,%llu,%llu\r\n", len * sizeof *buf_c16, 
+               (us * 1000) / FORMAT_ITERS, 
+               us ? (FORMAT_ITERS * len * sizeof *buf_c16) / us : 0);
+
+    char buf[128];
+    start = arch_timestamp();
+    for (UINTN k = 0; k < FORMAT_ITERS; k++) 
+        len = snprintf(buf, sizeof buf, "%u: Typ: %u, Phy: %x, Vrt: %x, Pgs: %u, Att: %x\r\n",
+                       k, 7, 0x100000 + k, 0, 0x7F00, 0xF);
+    us = (arch_timestamp() - start) / ticks_per_us;
+    printf_c16(u"snprintf,%llu,%llu,%llu\r\n", len, 
+               (us * 1000) / FORMAT_ITERS, us ? (FORMAT_ITERS * len) / us : 0);
+
+    bs->FreePages(bufs, (2*MAX_SIZE + 64) / PAGE_SIZE + 1);
 
     printf_c16(u"\r\nPress any key to go back...\r\n");
     get_key();
@@ -2444,14 +3342,14 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     cout->Reset(cerr, FALSE);
 
     // Set text colors - foreground, background
-    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
 
     // Disable Watchdog Timer
     bs->SetWatchdogTimer(0, 0x10000, 0, NULL);
 
     // Get current text mode ColsxRows values
     UINTN cols = 0, rows = 0;
-    cout->QueryMode(cout, cout->Mode->Mode, &cols, &rows);
+    cout->QueryMode(cout, text_mode(cout)->Mode, &cols, &rows);
 
     // Set global text rows/cols values
     text_rows = rows; 
@@ -2466,7 +3364,6 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
         status = root->Open(root, &file, path, EFI_FILE_MODE_READ, 0);
         autoload_kernel = !EFI_ERROR(status);
         if (file) file->Close(file);
-        if (root) root->Close(root);
     }
 
     if (autoload_kernel) load_kernel(); // Load kernel; Should not return!
@@ -2480,6 +3377,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
         u"Read ESP Files",
         u"Print Block IO Partitions",
         u"Print Memory Map",
+        u"Print Page Tables",
         u"Print Configuration Tables",
         u"Print ACPI Tables",
         u"Print EFI Global Variables",
@@ -2487,6 +3385,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
         u"Change Boot Variables",
         u"Write Disk Image Image To Other Disk",
         u"Install Bootloader & Autoload Kernel",
+        u"Benchmark Library Helpers",
     };
 
     // Functions to call for each menu option
@@ -2498,19 +3397,26 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
         read_esp_files,
         print_block_io_partitions,
         print_memory_map,
+        print_page_tables,
         print_config_tables,
         print_acpi_tables,
         print_efi_global_variables,
         load_kernel,
         change_boot_variables,
         write_to_another_disk,
-        install_to_disk
+        install_to_disk,
+        benchmark_lib_helpers,
     };
 
     // Connect all controllers found for all handles, to hopefully fix
     //   any bugs related to not initializing device drivers from firmware
     connect_all_controllers();
 
+    // Scan Block IO handles into the disk table once, now that drivers are connected;
+    //   an earlier lookup (e.g. autoload) may have built it before connecting
+    free_disk_table();
+    build_disk_table();
+
     // Timer function context will be the text mode screen bounds
     typedef struct {
         UINT32 rows; 
@@ -2529,7 +3435,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     while (running) {
         // Clear console output; clear screen to background color and
         //   set cursor to 0,0
-        cout->ClearScreen(cout);
+        clear_screen(cout);
 
         // Close Timer Event for cleanup
         bs->CloseEvent(timer_event);
@@ -2545,30 +3451,30 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
         bs->SetTimer(timer_event, TimerPeriodic, 10000000);
 
         // Print keybinds at bottom of screen
-        cout->SetCursorPosition(cout, 0, rows-3);
+        set_cursor_position(cout, 0, rows-3);
         printf_c16(u"Up/Down Arrow = Move cursor\r\n"
                u"Enter = Select\r\n"
                u"Escape = Shutdown");
 
         // Print menu choices
         // Highlight first choice as initial choice
-        cout->SetCursorPosition(cout, 0, 0);
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+        set_cursor_position(cout, 0, 0);
+        set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
         printf_c16(u"%s", menu_choices[0]);
 
         // Print rest of choices
-        cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+        set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
         for (UINTN i = 1; i < ARRAY_SIZE(menu_choices); i++)
             printf_c16(u"\r\n%s", menu_choices[i]);
 
         // Get cursor row boundaries
-        INTN max_row = cout->Mode->CursorRow;
+        INTN max_row = text_mode(cout)->CursorRow;
 
         // Input loop
-        cout->SetCursorPosition(cout, 0, 0);
+        set_cursor_position(cout, 0, 0);
         bool getting_input = true;
         while (getting_input) {
-            INTN current_row = cout->Mode->CursorRow;
+            INTN current_row = text_mode(cout)->CursorRow;
             EFI_INPUT_KEY key = get_key();
 
             // Process input
@@ -2576,7 +3482,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
                 case SCANCODE_UP_ARROW:
                 case SCANCODE_DOWN_ARROW:
                     // De-highlight current row 
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     printf_c16(u"%s\r", menu_choices[current_row]);
 
                     // Go up or down 1 row in range [0:max_row] (circular buffer)
@@ -2585,16 +3491,17 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
                                   : (current_row+1) % (max_row+1);  
 
                     // Highlight new current row
-                    cout->SetCursorPosition(cout, 0, current_row);
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
+                    set_cursor_position(cout, 0, current_row);
+                    set_attribute(cout, EFI_TEXT_ATTR(HIGHLIGHT_FG_COLOR, HIGHLIGHT_BG_COLOR));
                     printf_c16(u"%s\r", menu_choices[current_row]);
 
                     // Reset colors
-                    cout->SetAttribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
+                    set_attribute(cout, EFI_TEXT_ATTR(DEFAULT_FG_COLOR, DEFAULT_BG_COLOR));
                     break;
 
                 case SCANCODE_ESC:
                     // Escape key: power off
+                    close_esp_root_dir();
                     rs->ResetSystem(EfiResetShutdown, EFI_SUCCESS, 0, NULL);
 
                     // !NOTE!: This should not return, system should power off
@@ -2603,7 +3510,7 @@ EFI_STATUS efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
 
                 default:
                     if (key.UnicodeChar == u'\r') {
-                        cout->ClearScreen(cout);
+                        clear_screen(cout);
 
                         // Enter key, select choice
                         EFI_STATUS return_status = menu_funcs[current_row]();
@@ -112,6 +112,14 @@ typedef UINT64 EFI_VIRTUAL_ADDRESS;
 {0xCE345171,0xBA0B,0x11d2,\
 0x8e,0x4F,{0x00,0xa0,0xc9,0x69,0x72,0x3b}}
 
+#define EFI_BLOCK_IO2_PROTOCOL_GUID \
+{0xa77b2472,0xe282,0x4e9f,\
+0xa2,0x45,{0xc2,0xc0,0xe2,0x7b,0xbc,0xc1}}
+
+#define EFI_DISK_IO2_PROTOCOL_GUID \
+{0x151c8eae,0x7f2c,0x472c,\
+0x9e,0x54,{0x98,0x28,0x19,0x4f,0x6a,0x88}}
+
 #define EFI_PARTITION_INFO_PROTOCOL_GUID \
 {0x8cf2f62c, 0xbc9b, 0x4821,\
 0x80, 0x8d, {0xec, 0x9e, 0xc4, 0x21, 0xa1, 0xa0}}
@@ -165,6 +173,10 @@ typedef UINT64 EFI_VIRTUAL_ADDRESS;
 {0xeb9d2d2f,0x2d88,0x11d3,\
 0x9a,0x16,{0x00,0x90,0x27,0x3f,0xc1,0x4d}}
 
+#define EFI_MEMORY_ATTRIBUTES_TABLE_GUID \
+{0xdcfa911d,0x26eb,0x469f,\
+0xa2,0x20,{0x38,0xb7,0xdc,0x46,0x12,0x20}}
+
 // -----------------------------------
 // Partition Type GUID values
 // -----------------------------------
@@ -189,6 +201,7 @@ typedef UINT64 EFI_VIRTUAL_ADDRESS;
 #define ENCODE_ERROR(x) (TOP_BIT | (x))
 #define EFI_ERROR(x) ((INTN)((UINTN)(x)) < 0)
 
+#define EFI_INVALID_PARAMETER ENCODE_ERROR(2)
 #define EFI_UNSUPPORTED      ENCODE_ERROR(3)
 #define EFI_BUFFER_TOO_SMALL ENCODE_ERROR(5)
 #define EFI_DEVICE_ERROR     ENCODE_ERROR(7)
@@ -197,6 +210,7 @@ typedef UINT64 EFI_VIRTUAL_ADDRESS;
 
 #define MAX_EFI_ERROR 36
 const CHAR16 *EFI_ERROR_STRINGS[MAX_EFI_ERROR] = {
+    [2]  = u"EFI_INVALID_PARAMETER",
     [3]  = u"EFI_UNSUPPORTED",
     [5]  = u"EFI_BUFFER_TOO_SMALL",
     [7]  = u"EFI_DEVICE_ERROR",
@@ -786,6 +800,17 @@ typedef struct {
     UINT64               Attribute;
 } EFI_MEMORY_DESCRIPTOR;
 
+// EFI_MEMORY_ATTRIBUTES_TABLE: UEFI Spec 2.10 section 4.6.4
+//   Followed by NumberOfEntries EFI_MEMORY_DESCRIPTORs of DescriptorSize bytes each,
+//   for runtime services memory; their EFI_MEMORY_RO & EFI_MEMORY_XP attributes are
+//   the protection to apply, not only what the memory supports as in GetMemoryMap()
+typedef struct {
+    UINT32 Version;
+    UINT32 NumberOfEntries;
+    UINT32 DescriptorSize;
+    UINT32 Flags;
+} EFI_MEMORY_ATTRIBUTES_TABLE;
+
 // Memory Attribute Definitions
 // These types can be "ORed" together as needed.
 #define EFI_MEMORY_UC            0x0000000000000001
@@ -1168,6 +1193,20 @@ EFI_STATUS
 #define TPL_NOTIFY      16  // 0b00010000
 #define TPL_HIGH_LEVEL  31  // 0b00011111
 
+// EFI_RAISE_TPL: UEFI Spec 2.10 section 7.1.8
+typedef
+EFI_TPL
+(EFIAPI *EFI_RAISE_TPL) (
+    IN EFI_TPL NewTpl
+);
+
+// EFI_RESTORE_TPL: UEFI Spec 2.10 section 7.1.9
+typedef
+VOID
+(EFIAPI *EFI_RESTORE_TPL) (
+    IN EFI_TPL OldTpl
+);
+
 // EFI_EVENT types 
 // These types can be "ORed" together as needed - for example,
 // EVT_TIMER might be "ORed" with EVT_NOTIFY_WAIT or EVT_NOTIFY_SIGNAL.
@@ -1201,6 +1240,13 @@ EFI_STATUS
     IN EFI_EVENT Event
 );
 
+// EFI_CHECK_EVENT: UEFI Spec 2.10 section 7.1.6
+typedef
+EFI_STATUS
+(EFIAPI *EFI_CHECK_EVENT) (
+    IN EFI_EVENT Event
+);
+
 // EFI_EXIT_BOOT_SERVICES: UEFI Spec 2.10 section 7.4.6
 typedef
 EFI_STATUS
@@ -1209,6 +1255,13 @@ EFI_STATUS
     IN UINTN      MapKey
 );
 
+// EFI_STALL: UEFI Spec 2.10 7.5.2
+typedef
+EFI_STATUS
+(EFIAPI *EFI_STALL) (
+    IN UINTN Microseconds
+);
+
 // EFI_SET_WATCHDOG_TIMER: UEFI Spec 2.10 7.5.1
 typedef
 EFI_STATUS
@@ -1695,6 +1748,121 @@ typedef struct EFI_DISK_IO_PROTOCOL {
     EFI_DISK_WRITE WriteDisk;
 } EFI_DISK_IO_PROTOCOL;
 
+// EFI_DISK_IO2_PROTOCOL: UEFI Spec 2.10 section 13.8.1
+#define EFI_DISK_IO2_PROTOCOL_REVISION 0x00020000
+
+typedef struct EFI_DISK_IO2_PROTOCOL EFI_DISK_IO2_PROTOCOL; 
+
+// EFI_DISK_IO2_TOKEN
+typedef struct {
+    EFI_EVENT  Event;
+    EFI_STATUS TransactionStatus;
+} EFI_DISK_IO2_TOKEN;
+
+// EFI_DISK_CANCEL_EX: UEFI Spec 2.10 section 13.8.2
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_CANCEL_EX) (
+    IN EFI_DISK_IO2_PROTOCOL *This
+);
+
+// EFI_DISK_READ_EX: UEFI Spec 2.10 section 13.8.3
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_READ_EX) (
+    IN EFI_DISK_IO2_PROTOCOL  *This,
+    IN UINT32                 MediaId,
+    IN UINT64                 Offset,
+    IN OUT EFI_DISK_IO2_TOKEN *Token,
+    IN UINTN                  BufferSize,
+    OUT VOID                  *Buffer
+);
+
+// EFI_DISK_WRITE_EX: UEFI Spec 2.10 section 13.8.4
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_WRITE_EX) (
+    IN EFI_DISK_IO2_PROTOCOL  *This,
+    IN UINT32                 MediaId,
+    IN UINT64                 Offset,
+    IN OUT EFI_DISK_IO2_TOKEN *Token,
+    IN UINTN                  BufferSize,
+    IN VOID                   *Buffer
+);
+
+// EFI_DISK_FLUSH_EX: UEFI Spec 2.10 section 13.8.5
+typedef
+EFI_STATUS
+(EFIAPI *EFI_DISK_FLUSH_EX) (
+    IN EFI_DISK_IO2_PROTOCOL  *This,
+    IN OUT EFI_DISK_IO2_TOKEN *Token
+);
+
+typedef struct EFI_DISK_IO2_PROTOCOL {
+    UINT64             Revision;
+    EFI_DISK_CANCEL_EX Cancel;
+    EFI_DISK_READ_EX   ReadDiskEx;
+    EFI_DISK_WRITE_EX  WriteDiskEx;
+    EFI_DISK_FLUSH_EX  FlushDiskEx;
+} EFI_DISK_IO2_PROTOCOL;
+
+// EFI_BLOCK_IO2_PROTOCOL: UEFI Spec 2.10 section 13.10.1
+typedef struct EFI_BLOCK_IO2_PROTOCOL EFI_BLOCK_IO2_PROTOCOL;
+
+// EFI_BLOCK_IO2_TOKEN
+typedef struct {
+    EFI_EVENT  Event;
+    EFI_STATUS TransactionStatus;
+} EFI_BLOCK_IO2_TOKEN;
+
+// EFI_BLOCK_RESET_EX: UEFI Spec 2.10 section 13.10.2
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_RESET_EX) (
+    IN EFI_BLOCK_IO2_PROTOCOL *This,
+    IN BOOLEAN                ExtendedVerification
+);
+
+// EFI_BLOCK_READ_EX: UEFI Spec 2.10 section 13.10.3
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_READ_EX) (
+    IN EFI_BLOCK_IO2_PROTOCOL  *This,
+    IN UINT32                  MediaId,
+    IN EFI_LBA                 LBA,
+    IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+    IN UINTN                   BufferSize,
+    OUT VOID                   *Buffer
+);
+
+// EFI_BLOCK_WRITE_EX: UEFI Spec 2.10 section 13.10.4
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_WRITE_EX) (
+    IN EFI_BLOCK_IO2_PROTOCOL  *This,
+    IN UINT32                  MediaId,
+    IN EFI_LBA                 LBA,
+    IN OUT EFI_BLOCK_IO2_TOKEN *Token,
+    IN UINTN                   BufferSize,
+    IN VOID                    *Buffer
+);
+
+// EFI_BLOCK_FLUSH_EX: UEFI Spec 2.10 section 13.10.5
+typedef
+EFI_STATUS
+(EFIAPI *EFI_BLOCK_FLUSH_EX) (
+    IN EFI_BLOCK_IO2_PROTOCOL  *This,
+    IN OUT EFI_BLOCK_IO2_TOKEN *Token
+);
+
+typedef struct EFI_BLOCK_IO2_PROTOCOL {
+    EFI_BLOCK_IO_MEDIA *Media;
+    EFI_BLOCK_RESET_EX Reset;
+    EFI_BLOCK_READ_EX  ReadBlocksEx;
+    EFI_BLOCK_WRITE_EX WriteBlocksEx;
+    EFI_BLOCK_FLUSH_EX FlushBlocksEx;
+} EFI_BLOCK_IO2_PROTOCOL;
+
 // EFI_PARTITION_INFO_PROTOCOL: UEFI Spec 2.10 section 13.18
 #define EFI_PARTITION_INFO_PROTOCOL_REVISION 0x0001000
 #define PARTITION_TYPE_OTHER                 0x00
@@ -1807,8 +1975,8 @@ typedef struct {
     //
     // Task Priority Services
     //
-    void* RaiseTPL;
-    void* RestoreTPL;
+    EFI_RAISE_TPL   RaiseTPL;
+    EFI_RESTORE_TPL RestoreTPL;
 
     //
     // Memory Services
@@ -1827,7 +1995,7 @@ typedef struct {
     EFI_WAIT_FOR_EVENT WaitForEvent;
     void*              SignalEvent;
     EFI_CLOSE_EVENT    CloseEvent;
-    void*              CheckEvent;
+    EFI_CHECK_EVENT    CheckEvent;
 
     //
     // Protocol Handler Services
@@ -1855,7 +2023,7 @@ typedef struct {
     // Miscellaneous Services
     //
     void*                  GetNextMonotonicCount;
-    void*                  Stall;
+    EFI_STALL              Stall;
     EFI_SET_WATCHDOG_TIMER SetWatchdogTimer;
 
     //
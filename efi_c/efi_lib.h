@@ -15,12 +15,23 @@
 // -----------------
 #define ARRAY_SIZE(x) (sizeof (x) / sizeof (x)[0])
 #define max(x, y) ((x) > (y) ? (x) : (y))
+#define min(x, y) ((x) < (y) ? (x) : (y))
 
 // -----------------
 // Global constants
 // -----------------
 #define PAGE_SIZE 4096  // 4KiB
 
+// Page mapping flags for arch_map_range(), translated to page table entry bits by each arch
+#define MAP_WRITE (1 << 0)      // Writable
+#define MAP_USER  (1 << 1)      // Accessible from user mode
+#define MAP_WC    (1 << 2)      // Write-combining memory type, e.g. for framebuffers
+#define MAP_UC    (1 << 3)      // Uncacheable memory type, no speculative reads, e.g. for MMIO
+#define MAP_WT    (1 << 4)      // Write-through memory type
+#define MAP_WP    (1 << 5)      // Write-protected memory type
+#define MAP_NX    (1 << 6)      // Not executable
+#define MAP_TYPE_MASK (MAP_WC | MAP_UC | MAP_WT | MAP_WP)   // No memory type flag = write-back (WB)
+
 // ELF Header - x86_64
 typedef struct {
     struct {
@@ -170,6 +181,14 @@ typedef struct {
                                 //   e.g. PSF font, or right->left e.g. terminus?
 } Bitmap_Font;
 
+// memcpy/memset implementations, chosen once at startup from CPU features
+typedef enum {
+    MEM_METHOD_BYTES,   // 1 byte at a time
+    MEM_METHOD_WIDE,    // 64 bit words, or SSE2/NEON vectors if available
+    MEM_METHOD_ERMS,    // x86_64 Enhanced REP MOVSB/STOSB for larger sizes, wide otherwise
+    MEM_METHOD_FSRM,    // x86_64 Fast Short REP MOVSB; REP MOVSB/STOSB for all sizes
+} Mem_Method;
+
 // Example Kernel Parameters
 typedef struct {
     Memory_Map_Info                   mmap; 
@@ -179,11 +198,32 @@ typedef struct {
     EFI_CONFIGURATION_TABLE           *ConfigurationTable;
     UINTN                             num_fonts;
     Bitmap_Font                       *fonts;
+    Mem_Method                        mem_method;
+    UINT32                            *fb_back_buffer;  // Write-back copy of the framebuffer to draw in
 } Kernel_Parms;
 
 // Kernel entry point typedef
 typedef void EFIAPI (*Entry_Point)(Kernel_Parms *);
 
+// Ranges mapped for the kernel besides the identity mapped memory map, 
+//   see map_kernel_page_tables()
+typedef struct {
+    EFI_PHYSICAL_ADDRESS framebuffer;       // Identity mapped write-combining
+    UINTN                framebuffer_size;
+    EFI_PHYSICAL_ADDRESS kernel;            // Mapped at KERNEL_START_ADDRESS
+    UINTN                kernel_size;
+    EFI_PHYSICAL_ADDRESS stack;             // Identity mapped
+    UINTN                stack_size;
+    EFI_MEMORY_ATTRIBUTES_TABLE *memory_attributes; // Runtime regions' access, or NULL
+} Kernel_Page_Map;
+
+// Mapping print_page_tables() expects for a memory type, see expected_mappings[]
+typedef struct {
+    EFI_MEMORY_TYPE type;
+    UINT64          map_flags;      // MAP_* flags if the descriptor has no cacheability attributes
+    bool            mmio;           // Always uncacheable, whatever the attributes
+} Expected_Mapping;
+
 // EFI Configuration Table GUIDs and string names
 typedef struct {
     EFI_GUID guid;
@@ -197,6 +237,7 @@ Efi_Guid_With_String config_table_guids_and_strings[] = {
     {SMBIOS_TABLE_GUID,     u"SMBIOS_TABLE_GUID"},
     {SMBIOS3_TABLE_GUID,    u"SMBIOS3_TABLE_GUID"},
     {MPS_TABLE_GUID,        u"MPS_TABLE_GUID"},
+    {EFI_MEMORY_ATTRIBUTES_TABLE_GUID, u"EFI_MEMORY_ATTRIBUTES_TABLE_GUID"},
 };
 
 // General ACPI table header
@@ -227,6 +268,170 @@ typedef struct {
     uint32_t width;             // Width in pixels 
 } PSF2_Header;
 
+// Wide memory access for memset/memcpy/etc.
+//   64 bit words on all architectures, and 128 bit vectors where SSE2 (x86_64) or 
+//   NEON (aarch64) are always available.
+//   may_alias lets these types read/write memory of any other type e.g. strings.
+#define MEM_WORD_SIZE sizeof(UINT64)
+typedef UINT64 __attribute__ ((may_alias)) Mem_Word;
+
+// Unaligned 64 bit load/store, for when src and dst alignments differ
+typedef struct {
+    UINT64 value;
+} __attribute__ ((packed, may_alias)) Unaligned_UINT64;
+
+// "Has zero byte/CHAR16" bit tricks for a 64 bit word: the high bit of each zero
+//   element is set in the result, and lower elements than the first zero are 0
+#define MEM_WORD_ONES   0x0101010101010101ULL
+#define MEM_WORD_HIGHS  0x8080808080808080ULL
+#define MEM_WORD_ONES16  0x0001000100010001ULL
+#define MEM_WORD_HIGHS16 0x8000800080008000ULL
+#define mem_word_zero_bytes(w)  (((w) - MEM_WORD_ONES)   & ~(w) & MEM_WORD_HIGHS)
+#define mem_word_zero_c16s(w)   (((w) - MEM_WORD_ONES16) & ~(w) & MEM_WORD_HIGHS16)
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define MEM_VEC_SIZE 16
+// GCC/Clang vector extensions; compiles to SSE2 or NEON loads/stores without needing
+//   intrinsic headers, which can pull in hosted libc headers
+typedef UINT8  Mem_Vec     __attribute__ ((vector_size(MEM_VEC_SIZE), may_alias));
+typedef UINT8  Mem_Vec_U   __attribute__ ((vector_size(MEM_VEC_SIZE), may_alias, aligned(1)));
+typedef UINT16 Mem_Vec_16  __attribute__ ((vector_size(MEM_VEC_SIZE)));
+typedef UINT64 Mem_Vec_64  __attribute__ ((vector_size(MEM_VEC_SIZE)));
+typedef char   Mem_Vec_S8  __attribute__ ((vector_size(MEM_VEC_SIZE)));
+#define mem_vec_splat(c)    ((Mem_Vec){0} + (UINT8)(c))
+#define mem_vec_load(p)     (*(Mem_Vec_U *)(p))         // Unaligned load
+#define mem_vec_load_a(p)   (*(Mem_Vec *)(p))           // Aligned load
+#define mem_vec_store(p, v) (*(Mem_Vec *)(p) = (v))     // Aligned store
+#endif
+
+// Buffered console output: printf_c16() & co. append to a per-stream buffer, which is
+//   written with 1 OutputString() call when full, on flush_c16(), or before anything
+//   that reads or moves the cursor/screen state (clear_screen(), get_key(), etc.)
+#define CONSOLE_BUF_LEN 2048    // # of CHAR16s, not including the NULL terminator
+typedef struct {
+    EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream;    // NULL = unused slot
+    UINTN  len;                                 // # of CHAR16s currently buffered
+    UINTN  newlines;                            // # of '\n's in buf, see cursor_row()
+    CHAR16 buf[CONSOLE_BUF_LEN+1];
+} Console_Buffer;
+
+// Block IO handles grouped by media ID; built once by build_disk_table() so disk lookups
+//   don't each need a LocateHandleBuffer() + OpenProtocol() scan of every Block IO handle
+typedef struct {
+    EFI_HANDLE handle;
+    EFI_BLOCK_IO_PROTOCOL *biop;
+} Block_Device;
+
+typedef struct {
+    UINT32 media_id;
+    EFI_HANDLE handle;                  // Whole disk (not a logical partition) handle, or NULL
+    EFI_BLOCK_IO_PROTOCOL *biop;        // Block IO for whole disk, or NULL
+    EFI_DISK_IO_PROTOCOL  *diop;        // Disk IO for whole disk, or NULL
+    EFI_BLOCK_IO2_PROTOCOL *biop2;      // Async Block IO 2 for whole disk, or NULL
+    EFI_DISK_IO2_PROTOCOL  *diop2;      // Async Disk IO 2 for whole disk, or NULL
+    Block_Device *devices;              // Whole disk & partitions with this media ID
+    UINTN num_devices;
+    UINT32  block_size;                 // Whole disk media geometry
+    UINT32  io_align;
+    UINT32  optimal_transfer_blocks;
+    EFI_LBA last_block;
+} Disk_Info;
+
+typedef struct {
+    Disk_Info *disks;                   // 1 entry per media ID, sorted by media ID
+    UINTN num_disks;
+    Block_Device *devices;              // All Block IO devices, sorted by media ID
+    UINTN num_devices;
+    Disk_Info *image_disk;              // Disk for this running disk image, or NULL
+    bool built;
+} Disk_Table;
+
+// Index of files in the disk image's data partition, sorted by name so lookups are a binary 
+//   search; built once by build_data_file_index() from FILE.IDX if it matches FILE.TXT, 
+//   else from FILE.TXT.
+// FILE.IDX is a Data_File_Index_Header followed by num_entries Data_File_Entry structs
+//   already sorted by name, so it is used in place without any text parsing. All values
+//   are little endian; host/mkfileidx generates it from FILE.TXT when building the disk
+//   image. The header holds the size & CRC32 of that FILE.TXT, so a FILE.IDX left over 
+//   from an older image is not used.
+// Example: this FILE.TXT
+//     DISK_SIZE=52428800
+//     FILE_NAME=kernel.elf
+//     FILE_SIZE=12345
+//     DISK_LBA=2048
+//     FILE_NAME=ter-132n.psf
+//     FILE_SIZE=8992
+//     DISK_LBA=2073
+//   is this 184 byte FILE.IDX:
+//     0x00: "FILEIDX2"                 magic
+//     0x08: 52428800                   disk_size
+//     0x10: 2                          num_entries
+//     0x18: FILE.TXT size in bytes     txt_size
+//     0x20: FILE.TXT CRC32             txt_crc32
+//     0x28: "kernel.elf", 0 padded     entries[0].name (56 bytes)
+//     0x60: 2048                       entries[0].disk_lba
+//     0x68: 12345                      entries[0].file_size
+//     0x70: "ter-132n.psf", 0 padded   entries[1].name
+//     0xA8: 2073                       entries[1].disk_lba
+//     0xB0: 8992                       entries[1].file_size
+#define DATA_FILE_NAME_LEN    56            // Including NULL padding
+#define DATA_FILE_INDEX_MAGIC "FILEIDX2"    // 8 bytes, not NULL terminated
+typedef struct {
+    char   name[DATA_FILE_NAME_LEN];
+    UINT64 disk_lba;
+    UINT64 file_size;
+} Data_File_Entry;
+
+typedef struct {
+    char   magic[8];
+    UINT64 disk_size;                   // Total disk image size in bytes
+    UINT64 num_entries;
+    UINT64 txt_size;                    // FILE.TXT this index was generated from
+    UINT64 txt_crc32;
+} Data_File_Index_Header;
+
+typedef struct {
+    Data_File_Entry *entries;           // Sorted by name
+    UINTN num_entries;
+    UINTN disk_size;
+    VOID *buffer;                       // Allocated buffer holding entries
+    bool built;
+} Data_File_Index;
+
+// Queue of in flight async Disk IO 2 reads. Reads are split into chunks, so the device can work 
+//   on several at once while the caller does other work, e.g. zeroing .bss or loading fonts;
+//   disk_read_queue_wait() must be called before using the buffers or leaving Boot Services.
+// Queued reads are off unless built with DISK_READ_ASYNC=1 (e.g. 'DISK_READ_ASYNC=1 make'),
+//   until the async path is tested booting on OVMF & hardware; disk_read() is then always sync
+#ifndef DISK_READ_ASYNC
+#define DISK_READ_ASYNC 0
+#endif
+#define DISK_READ_QUEUE_LEN  8
+#define DISK_READ_CHUNK_SIZE (1024 * 1024)
+typedef struct {
+    EFI_DISK_IO2_TOKEN tokens[DISK_READ_QUEUE_LEN];
+    bool  busy[DISK_READ_QUEUE_LEN];
+    UINTN next;                         // Next token to use, oldest in flight if busy
+    EFI_STATUS status;                  // First error from any queued read
+} Disk_Read_Queue;
+
+// Buffer for a streaming disk to disk copy, see copy_disk(). Each buffer is read into from 1 disk
+//   and then written out to another; with Block IO 2 these run async on the token's event, so 
+//   reads of the next chunks overlap the write of the current one
+#define DISK_COPY_BUFFERS    4                      // At least 2
+#define DISK_COPY_CHUNK_SIZE (4 * 1024 * 1024)      // Default chunk size
+typedef struct {
+    UINT8 *data;
+    EFI_BLOCK_IO2_TOKEN token;          // NULL Event = use blocking Block IO
+    bool busy;                          // Async read or write in flight
+} Disk_Copy_Buffer;
+
+typedef enum {
+    DISK_COPY_FULL,     // Write every chunk
+    DISK_COPY_SPARSE,   // Skip all zero chunks, for a target that is already zeroed
+    DISK_COPY_DELTA,    // Read each target chunk too, skip chunks that are already equal
+} Disk_Copy_Mode;
+
 // -----------------
 // Global variables
 // -----------------
@@ -242,6 +447,21 @@ EFI_HANDLE image = NULL;                        // Image handle
 
 INT32 text_rows = 0, text_cols = 0;             // Current text mode screen rows & columns
 
+Mem_Method mem_method = MEM_METHOD_WIDE;        // memcpy/memset implementation to use
+
+Console_Buffer console_bufs[2] = {0};           // stdout & stderr, if they differ
+
+EFI_FILE_PROTOCOL *esp_root = NULL;             // Cached ESP root directory, see esp_root_dir()
+
+Disk_Table disk_table = {0};                    // Block IO disks by media ID, see build_disk_table()
+
+Data_File_Index data_file_index = {0};          // Data partition files, see build_data_file_index()
+
+UINT32 crc32_tables[8][256] = {0};              // Slice-by-8 CRC32 tables, see crc32_update()
+
+// Probe CPU features (e.g. CPUID) for fastest memcpy/memset method; defined in arch header
+extern Mem_Method arch_probe_mem_method(void);
+
 // ======================
 // Set global variables
 // ======================
@@ -254,230 +474,901 @@ void init_global_variables(EFI_HANDLE handle, EFI_SYSTEM_TABLE *systable) {
     bs = st->BootServices;
     rs = st->RuntimeServices;
     image = handle;
+    mem_method = arch_probe_mem_method();
 }
 
-// ====================
-// Get key from user
-// ====================
-EFI_INPUT_KEY get_key(void) {
-    EFI_EVENT events[1] = { cin->WaitForKey };
-    EFI_INPUT_KEY key = {0};
-    UINTN index = 0;
-
-    bs->WaitForEvent(1, events, &index);
-    cin->ReadKeyStroke(cin, &key);
-    return key;
+// ====================================
+// memset (bytes):
+// Sets len bytes of dst memory with int c, 1 byte at a time
+// Returns dst buffer
+// ================================
+VOID *memset_bytes(VOID *dst, UINT8 c, UINTN len) {
+    UINT8 *p = dst;
+    while (len--) *p++ = c;
+    return dst;
 }
 
 // ====================================
-// memset for compiling with clang/gcc:
-// Sets len bytes of dst memory with int c
+// memset (words):
+// Sets len bytes of dst memory with int c, using aligned 64 bit stores
+//   for the body and byte stores for the unaligned head and tail.
 // Returns dst buffer
 // ================================
-VOID *memset(VOID *dst, UINT8 c, UINTN len) {
+VOID *memset_words(VOID *dst, UINT8 c, UINTN len) {
     UINT8 *p = dst;
+    if (len < 2*MEM_WORD_SIZE) return memset_bytes(dst, c, len);
+
+    // Head: Bytes until dst is word aligned
+    while ((UINTN)p & (MEM_WORD_SIZE-1)) {
+        *p++ = c;
+        len--;
+    }
+
+    // Body: Replicate c into every byte of a 64 bit word e.g. 0xAB -> 0xABABABABABABABAB
+    UINT64 word = c * MEM_WORD_ONES;
+    for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE, p += MEM_WORD_SIZE) 
+        *(Mem_Word *)p = word;
+
+    // Tail: Remaining bytes
     while (len--) *p++ = c;
     return dst;
 }
 
 // ====================================
-// memcpy for compiling with clang/gcc:
-// Sets len bytes of dst memory from src.
+// memcpy (bytes):
+// Sets len bytes of dst memory from src, 1 byte at a time.
 // Assumes memory does not overlap!
 // Returns dst buffer
 // ================================
-VOID *memcpy(VOID *dst, VOID *src, UINTN len) {
+VOID *memcpy_bytes(VOID *dst, VOID *src, UINTN len) {
     UINT8 *p = dst, *q = src;
     while (len--) *p++ = *q++;
     return dst;
 }
 
-// =============================================================================
-// memcmp:
-// Compare up to len bytes of m1 and m2, stop at first
-//   point that they don't equal.
-// Returns 0 if equal, >0 if m1 is greater than m2, <0 if m2 is greater than m1
-// =============================================================================
-INTN memcmp(VOID *m1, VOID *m2, UINTN len) {
-    UINT8 *p = m1;
-    UINT8 *q = m2;
-    for (UINTN i = 0; i < len; i++)
-        if (p[i] != q[i]) return (INTN)(p[i]) - (INTN)(q[i]);
+// ====================================
+// memcpy (words):
+// Sets len bytes of dst memory from src, using aligned 64 bit stores to dst
+//   and unaligned 64 bit loads from src for the body, and byte copies for the
+//   unaligned head and tail.
+// Copies front to back, loading each word before storing it, so memory may 
+//   overlap only if dst is below src (used by memmove()).
+// Returns dst buffer
+// ================================
+VOID *memcpy_words(VOID *dst, VOID *src, UINTN len) {
+    UINT8 *p = dst, *q = src;
+    if (len < 2*MEM_WORD_SIZE) return memcpy_bytes(dst, src, len);
 
-    return 0;
-}
+    // Head: Bytes until dst is word aligned
+    while ((UINTN)p & (MEM_WORD_SIZE-1)) {
+        *p++ = *q++;
+        len--;
+    }
 
-// =====================================================================
-// (ASCII) strlen:
-// Returns: length of string not including NULL terminator
-// =====================================================================
-UINTN strlen(char *s) {
-    UINTN len = 0;
-    while (*s++) len++;
-    return len;
-}
+    // Body: src may still be unaligned, so load through a packed struct
+    for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE, p += MEM_WORD_SIZE, q += MEM_WORD_SIZE) 
+        *(Mem_Word *)p = ((Unaligned_UINT64 *)q)->value;
 
-// =====================================================================
-// (CHAR16) strlen:
-// Returns: length of string not including NULL terminator
-// =====================================================================
-UINTN strlen_c16(CHAR16 *s) {
-    UINTN len = 0;
-    while (*s++) len++;
-    return len;
+    // Tail: Remaining bytes
+    while (len--) *p++ = *q++;
+    return dst;
 }
 
-// =====================================================================
-// (ASCII) strstr:
-// Return a pointer to the beginning of the located
-//   substring, or NULL if the substring is not found.
-//   If needle is the empty string, the return value is always haystack
-//   itself.
-// =====================================================================
-char *strstr(char *haystack, char *needle) {
-    if (!needle) return haystack;
+#ifdef MEM_VEC_SIZE
+// ====================================
+// memset (vector):
+// Sets len bytes of dst memory with int c, using aligned 128 bit SSE2/NEON 
+//   stores for the body, 4 vectors per loop, and words/bytes for the 
+//   unaligned head and tail.
+// Returns dst buffer
+// ================================
+VOID *memset_vec(VOID *dst, UINT8 c, UINTN len) {
+    UINT8 *p = dst;
+    if (len < 4*MEM_VEC_SIZE) return memset_words(dst, c, len);
+
+    // Head: Bytes until dst is vector aligned
+    while ((UINTN)p & (MEM_VEC_SIZE-1)) {
+        *p++ = c;
+        len--;
+    }
 
-    char *p = haystack;
-    while (*p) {
-        if (*p == *needle && !memcmp(p, needle, strlen(needle))) 
-            return p;
-        p++;
+    // Body: 64 bytes per loop, then 16 bytes at a time
+    Mem_Vec vec = mem_vec_splat(c);
+    for (; len >= 4*MEM_VEC_SIZE; len -= 4*MEM_VEC_SIZE, p += 4*MEM_VEC_SIZE) {
+        mem_vec_store(p + 0*MEM_VEC_SIZE, vec);
+        mem_vec_store(p + 1*MEM_VEC_SIZE, vec);
+        mem_vec_store(p + 2*MEM_VEC_SIZE, vec);
+        mem_vec_store(p + 3*MEM_VEC_SIZE, vec);
     }
+    for (; len >= MEM_VEC_SIZE; len -= MEM_VEC_SIZE, p += MEM_VEC_SIZE) 
+        mem_vec_store(p, vec);
 
-    return NULL;
+    // Tail: Remaining bytes, dst is aligned here
+    return memset_words(p, c, len), dst;
 }
 
-// ======================================================================
-// (ASCII) stpstr:
-// Return a pointer to the terminating NULL byte of found substring,
-//   or NULL if the substring is not found.
-//   If needle is the empty string, the return value is always haystack
-//   itself.
-// ======================================================================
-char *stpstr(char *haystack, char *needle) {
-    if (!needle) return haystack;
+// ====================================
+// memcpy (vector):
+// Sets len bytes of dst memory from src, using aligned 128 bit SSE2/NEON 
+//   stores to dst and unaligned loads from src for the body, 4 vectors per 
+//   loop, and words/bytes for the unaligned head and tail.
+// Copies front to back, loading each block before storing it, so memory may 
+//   overlap only if dst is below src (used by memmove()).
+// Returns dst buffer
+// ================================
+VOID *memcpy_vec(VOID *dst, VOID *src, UINTN len) {
+    UINT8 *p = dst, *q = src;
+    if (len < 4*MEM_VEC_SIZE) return memcpy_words(dst, src, len);
 
-    char *p = haystack;
-    while (*p) {
-        if (*p == *needle && !memcmp(p, needle, strlen(needle))) 
-            return p + strlen(needle);
-        p++;
+    // Head: Bytes until dst is vector aligned
+    while ((UINTN)p & (MEM_VEC_SIZE-1)) {
+        *p++ = *q++;
+        len--;
     }
 
-    return NULL;
-}
+    // Body: 64 bytes per loop, then 16 bytes at a time
+    for (; len >= 4*MEM_VEC_SIZE; len -= 4*MEM_VEC_SIZE, p += 4*MEM_VEC_SIZE, q += 4*MEM_VEC_SIZE) {
+        Mem_Vec v0 = mem_vec_load(q + 0*MEM_VEC_SIZE);
+        Mem_Vec v1 = mem_vec_load(q + 1*MEM_VEC_SIZE);
+        Mem_Vec v2 = mem_vec_load(q + 2*MEM_VEC_SIZE);
+        Mem_Vec v3 = mem_vec_load(q + 3*MEM_VEC_SIZE);
+        mem_vec_store(p + 0*MEM_VEC_SIZE, v0);
+        mem_vec_store(p + 1*MEM_VEC_SIZE, v1);
+        mem_vec_store(p + 2*MEM_VEC_SIZE, v2);
+        mem_vec_store(p + 3*MEM_VEC_SIZE, v3);
+    }
+    for (; len >= MEM_VEC_SIZE; len -= MEM_VEC_SIZE, p += MEM_VEC_SIZE, q += MEM_VEC_SIZE) 
+        mem_vec_store(p, mem_vec_load(q));
 
-// =====================================================================
-// (ASCII) isdigit:
-// Returns: true/1 if char c >= 0 and <= 9, else 0/false
-// =====================================================================
-BOOLEAN isdigit(char c) {
-    return c >= '0' && c <= '9';
+    // Tail: Remaining bytes, dst is aligned here
+    return memcpy_words(p, q, len), dst;
 }
+#endif
 
-// =====================================================================
-// CHAR16 isdigit:
-// Returns: true/1 if char c >= 0 and <= 9, else 0/false
-// =====================================================================
-BOOLEAN isdigit_c16(CHAR16 c) {
-    return c >= u'0' && c <= u'9';
+// ====================================
+// memset (wide):
+// Sets len bytes of dst memory with int c, using vectors if available, else words
+// Returns dst buffer
+// ================================
+VOID *memset_wide(VOID *dst, UINT8 c, UINTN len) {
+#ifdef MEM_VEC_SIZE
+    return memset_vec(dst, c, len);
+#else
+    return memset_words(dst, c, len);
+#endif
 }
 
-// =====================================================================
-// CHAR16 isxdigit:
-// Returns: true/1 if char c >= 0   and <= 9   or 
-//                           >= 'a' and <= 'f' or
-//                           >= 'A' and <= 'F'
-// =====================================================================
-BOOLEAN isxdigit_c16(CHAR16 c) {
-    return (c >= u'0' && c <= u'9') ||
-           (c >= u'a' && c <= u'f') ||
-           (c >= u'A' && c <= u'F');
+// ====================================
+// memcpy (wide):
+// Sets len bytes of dst memory from src, using vectors if available, else words
+// Memory may overlap only if dst is below src.
+// Returns dst buffer
+// ================================
+VOID *memcpy_wide(VOID *dst, VOID *src, UINTN len) {
+#ifdef MEM_VEC_SIZE
+    return memcpy_vec(dst, src, len);
+#else
+    return memcpy_words(dst, src, len);
+#endif
 }
 
-// ======================================================
-// (ASCII) strrev:
-//  Reverse a string.
-//  Returns reversed string.
-// ======================================================
-char *strrev(char *s) {
-    if (!s) return s;
+// REP MOVSB/STOSB or equivalent string instructions; defined in arch header
+extern VOID *arch_memset_rep(VOID *dst, UINT8 c, UINTN len);
+extern VOID *arch_memcpy_rep(VOID *dst, VOID *src, UINTN len);
 
-    char *start = s, *end = s + strlen(s)-1;
-    while (start < end) {
-        char temp = *end;  // Swap
-        *end-- = *start;
-        *start++ = temp;
-    }
+// Minimum size to use REP MOVSB/STOSB for with only ERMS, below this the startup overhead 
+//   of the string instructions is slower than wide copies
+#define MEM_REP_THRESHOLD 2048
 
-    return s;
-}
+// ====================================
+// memset for compiling with clang/gcc:
+// Sets len bytes of dst memory with int c
+// Returns dst buffer
+// ================================
+VOID *memset(VOID *dst, UINT8 c, UINTN len) {
+    switch (mem_method) {
+        case MEM_METHOD_BYTES:
+            return memset_bytes(dst, c, len);
 
-// ======================================================
-// (CHAR16) strrev:
-//  Reverse a string.
-//  Returns reversed string.
-// ======================================================
-CHAR16 *strrev_c16(CHAR16 *s) {
-    if (!s) return s;
+        case MEM_METHOD_ERMS:
+            if (len >= MEM_REP_THRESHOLD) return arch_memset_rep(dst, c, len);
+            break;
 
-    CHAR16 *start = s, *end = s + strlen_c16(s)-1;
-    while (start < end) {
-        CHAR16 temp = *end;  // Swap
-        *end-- = *start;
-        *start++ = temp;
-    }
+        case MEM_METHOD_FSRM:
+            return arch_memset_rep(dst, c, len);
 
-    return s;
+        default:
+            break;
+    }
+    return memset_wide(dst, c, len);
 }
 
-// =============================================
-// (ASCII) atoi: 
-// Converts intial value of input string to 
-//   int.
-// Returns converted value or 0 on error
-// =============================================
-INTN atoi(char *s) {
-    INTN result = 0;
-    while (isdigit(*s)) 
-        result = (result * 10) + (*s++ - '0');
-
-    return result;
-}
+// ====================================
+// memcpy for compiling with clang/gcc:
+// Sets len bytes of dst memory from src.
+// Assumes memory does not overlap!
+// Returns dst buffer
+// ================================
+VOID *memcpy(VOID *dst, VOID *src, UINTN len) {
+    switch (mem_method) {
+        case MEM_METHOD_BYTES:
+            return memcpy_bytes(dst, src, len);
 
-// ======================================================
-// (ASCII) itoa:
-//  Convert integer to string representation.
-//  Returns input string.
-// ======================================================
-char *itoa(int32_t number, char *s, uint8_t base) {
-    char *p = s;
-    uint8_t digit = 0;
-    do {
-        digit = number % base;
-        if (digit < 10) *s++ = digit + '0';
-        else            *s++ = 'A' + digit - 10;
-        number /= base;
-    } while (number > 0);
+        case MEM_METHOD_ERMS:
+            if (len >= MEM_REP_THRESHOLD) return arch_memcpy_rep(dst, src, len);
+            break;
 
-    *s = '\0';
-    strrev(p);
+        case MEM_METHOD_FSRM:
+            return arch_memcpy_rep(dst, src, len);
 
-    return p;
+        default:
+            break;
+    }
+    return memcpy_wide(dst, src, len);
 }
 
-// ============================
-// (CHAR16) strcpy:
-//   Copy src string into dst 
-//   Returns dst
-// ============================
-CHAR16 *strcpy_c16(CHAR16 *dst, CHAR16 *src) {
-    if (!dst || !src) return dst;
+// ====================================
+// memmove backwards (words):
+// Sets len bytes of dst memory from src, back to front, using aligned 64 bit 
+//   stores to dst and unaligned 64 bit loads from src for the body, and byte 
+//   copies for the unaligned head and tail.
+// Memory may overlap only if dst is above src.
+// Returns dst buffer
+// ================================
+VOID *memmove_back_words(VOID *dst, VOID *src, UINTN len) {
+    UINT8 *p = (UINT8 *)dst + len, *q = (UINT8 *)src + len;    // 1 past end of buffers
+
+    if (len >= 2*MEM_WORD_SIZE) {
+        // Tail: Bytes until end of dst is word aligned
+        while ((UINTN)p & (MEM_WORD_SIZE-1)) {
+            *--p = *--q;
+            len--;
+        }
 
-    CHAR16 *result = dst;
-    while (*src) *dst++ = *src++;
+        // Body: Load each word before storing it
+        for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE) {
+            p -= MEM_WORD_SIZE;
+            q -= MEM_WORD_SIZE;
+            *(Mem_Word *)p = ((Unaligned_UINT64 *)q)->value;
+        }
+    }
 
-    *dst = u'\0';   // Null terminate
+    // Head: Remaining bytes
+    while (len--) *--p = *--q;
+    return dst;
+}
+
+#ifdef MEM_VEC_SIZE
+// ====================================
+// memmove backwards (vector):
+// Sets len bytes of dst memory from src, back to front, using aligned 128 bit
+//   SSE2/NEON stores to dst and unaligned loads from src for the body, 
+//   4 vectors per loop, and words/bytes for the unaligned head and tail.
+// Memory may overlap only if dst is above src.
+// Returns dst buffer
+// ================================
+VOID *memmove_back_vec(VOID *dst, VOID *src, UINTN len) {
+    UINT8 *p = (UINT8 *)dst + len, *q = (UINT8 *)src + len;    // 1 past end of buffers
+    if (len < 4*MEM_VEC_SIZE) return memmove_back_words(dst, src, len);
+
+    // Tail: Bytes until end of dst is vector aligned
+    while ((UINTN)p & (MEM_VEC_SIZE-1)) {
+        *--p = *--q;
+        len--;
+    }
+
+    // Body: 64 bytes per loop, then 16 bytes at a time; load all before storing
+    for (; len >= 4*MEM_VEC_SIZE; len -= 4*MEM_VEC_SIZE) {
+        p -= 4*MEM_VEC_SIZE;
+        q -= 4*MEM_VEC_SIZE;
+        Mem_Vec v0 = mem_vec_load(q + 0*MEM_VEC_SIZE);
+        Mem_Vec v1 = mem_vec_load(q + 1*MEM_VEC_SIZE);
+        Mem_Vec v2 = mem_vec_load(q + 2*MEM_VEC_SIZE);
+        Mem_Vec v3 = mem_vec_load(q + 3*MEM_VEC_SIZE);
+        mem_vec_store(p + 3*MEM_VEC_SIZE, v3);
+        mem_vec_store(p + 2*MEM_VEC_SIZE, v2);
+        mem_vec_store(p + 1*MEM_VEC_SIZE, v1);
+        mem_vec_store(p + 0*MEM_VEC_SIZE, v0);
+    }
+    for (; len >= MEM_VEC_SIZE; len -= MEM_VEC_SIZE) {
+        p -= MEM_VEC_SIZE;
+        q -= MEM_VEC_SIZE;
+        mem_vec_store(p, mem_vec_load(q));
+    }
+
+    // Head: Remaining bytes at start of buffers
+    return memmove_back_words(dst, src, len), dst;
+}
+#endif
+
+// ====================================
+// memmove:
+// Sets len bytes of dst memory from src, memory may overlap.
+//   Copies front to back if dst is below src, else back to front.
+// Returns dst buffer
+// ================================
+VOID *memmove(VOID *dst, VOID *src, UINTN len) {
+    UINT8 *p = dst, *q = src;
+    if (p == q || len == 0) return dst;
+
+    // No overlap, use fastest memcpy method
+    if (p + len <= q || q + len <= p) return memcpy(dst, src, len);
+
+    if (p < q) return memcpy_wide(dst, src, len);
+
+#ifdef MEM_VEC_SIZE
+    return memmove_back_vec(dst, src, len);
+#else
+    return memmove_back_words(dst, src, len);
+#endif
+}
+
+// =============================================================================
+// Scroll a 32bpp framebuffer up by a number of pixel rows, and fill the 
+//   vacated rows at the bottom with a color.
+//   pitch = pixels per scan line, height = # of rows to scroll within
+// NOTE: This reads the rows it moves, so use it on a write-back copy of the
+//   framebuffer and copy that out, not on the (write-combining) framebuffer.
+// =============================================================================
+void fb_scroll_rows(UINT32 *fb, UINT32 pitch, UINT32 height, UINT32 rows, UINT32 color) {
+    if (rows > height) rows = height;
+
+    // Move rows [rows, height) up to [0, height-rows) with wide copies
+    UINTN row_bytes = (UINTN)pitch * sizeof *fb;
+    memmove(fb, fb + ((UINTN)rows * pitch), (height - rows) * row_bytes);
+
+    // Fill the bottom rows with stores only, nothing is read back
+    UINT32 *bottom = fb + ((UINTN)(height - rows) * pitch);
+    for (UINTN i = 0; i < (UINTN)rows * pitch; i++) bottom[i] = color;
+}
+
+#ifdef MEM_VEC_SIZE
+// =============================================================================
+// Get index of first byte with any bits set in a vector compare result mask
+//   e.g. from (a == b), or MEM_VEC_SIZE if there are none
+// =============================================================================
+UINTN mem_vec_first_set(Mem_Vec mask) {
+#if defined(__x86_64__)
+    UINT32 bits = __builtin_ia32_pmovmskb128((Mem_Vec_S8)mask);    // SSE2 PMOVMSKB
+    return bits ? (UINTN)__builtin_ctz(bits) : MEM_VEC_SIZE;
+#else
+    Mem_Vec_64 halves = (Mem_Vec_64)mask;
+    if (halves[0]) return __builtin_ctzll(halves[0]) / 8;
+    if (halves[1]) return 8 + (__builtin_ctzll(halves[1]) / 8);
+    return MEM_VEC_SIZE;
+#endif
+}
+#endif
+
+// =============================================================================
+// memcmp (bytes):
+// Compare up to len bytes of m1 and m2, 1 byte at a time, stop at first
+//   point that they don't equal.
+// Returns 0 if equal, >0 if m1 is greater than m2, <0 if m2 is greater than m1
+// =============================================================================
+INTN memcmp_bytes(VOID *m1, VOID *m2, UINTN len) {
+    UINT8 *p = m1;
+    UINT8 *q = m2;
+    for (UINTN i = 0; i < len; i++)
+        if (p[i] != q[i]) return (INTN)(p[i]) - (INTN)(q[i]);
+
+    return 0;
+}
+
+// =============================================================================
+// memcmp (words):
+// Compare up to len bytes of m1 and m2, 64 bits at a time, stop at first
+//   point that they don't equal.
+// Returns 0 if equal, >0 if m1 is greater than m2, <0 if m2 is greater than m1
+// =============================================================================
+INTN memcmp_words(VOID *m1, VOID *m2, UINTN len) {
+    UINT8 *p = m1;
+    UINT8 *q = m2;
+    for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE, p += MEM_WORD_SIZE, q += MEM_WORD_SIZE) {
+        UINT64 diff = ((Unaligned_UINT64 *)p)->value ^ ((Unaligned_UINT64 *)q)->value;
+        if (diff) {
+            // Lowest set bit is in the first differing byte (little endian)
+            UINTN i = __builtin_ctzll(diff) / 8;
+            return (INTN)(p[i]) - (INTN)(q[i]);
+        }
+    }
+
+    return memcmp_bytes(p, q, len);
+}
+
+#ifdef MEM_VEC_SIZE
+// =============================================================================
+// memcmp (vector):
+// Compare up to len bytes of m1 and m2, 128 bits at a time with SSE2/NEON, 
+//   stop at first point that they don't equal.
+// Returns 0 if equal, >0 if m1 is greater than m2, <0 if m2 is greater than m1
+// =============================================================================
+INTN memcmp_vec(VOID *m1, VOID *m2, UINTN len) {
+    UINT8 *p = m1;
+    UINT8 *q = m2;
+    for (; len >= MEM_VEC_SIZE; len -= MEM_VEC_SIZE, p += MEM_VEC_SIZE, q += MEM_VEC_SIZE) {
+        UINTN i = mem_vec_first_set((Mem_Vec)(mem_vec_load(p) != mem_vec_load(q)));
+        if (i < MEM_VEC_SIZE) return (INTN)(p[i]) - (INTN)(q[i]);
+    }
+
+    return memcmp_words(p, q, len);
+}
+#endif
+
+// =============================================================================
+// memcmp:
+// Compare up to len bytes of m1 and m2, stop at first
+//   point that they don't equal.
+// Returns 0 if equal, >0 if m1 is greater than m2, <0 if m2 is greater than m1
+// =============================================================================
+INTN memcmp(VOID *m1, VOID *m2, UINTN len) {
+#ifdef MEM_VEC_SIZE
+    return memcmp_vec(m1, m2, len);
+#else
+    return memcmp_words(m1, m2, len);
+#endif
+}
+
+// =============================================================================
+// mem_is_zero (words):
+// Check if len bytes of m are all 0, 64 bits at a time
+// Returns true if all bytes are 0, else false
+// =============================================================================
+bool mem_is_zero_words(VOID *m, UINTN len) {
+    UINT8 *p = m;
+    for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE, p += MEM_WORD_SIZE)
+        if (((Unaligned_UINT64 *)p)->value) return false;
+
+    for (; len > 0; len--, p++)
+        if (*p) return false;
+
+    return true;
+}
+
+#ifdef MEM_VEC_SIZE
+// =============================================================================
+// mem_is_zero (vector):
+// Check if len bytes of m are all 0, ORing 4 SSE2/NEON vectors together so 
+//   there is only 1 test & branch per 64 bytes
+// Returns true if all bytes are 0, else false
+// =============================================================================
+bool mem_is_zero_vec(VOID *m, UINTN len) {
+    UINT8 *p = m;
+    for (; len >= 4*MEM_VEC_SIZE; len -= 4*MEM_VEC_SIZE, p += 4*MEM_VEC_SIZE) {
+        Mem_Vec_64 v = (Mem_Vec_64)(mem_vec_load(p)                | mem_vec_load(p +   MEM_VEC_SIZE) | 
+                                    mem_vec_load(p + 2*MEM_VEC_SIZE) | mem_vec_load(p + 3*MEM_VEC_SIZE));
+        if (v[0] | v[1]) return false;
+    }
+
+    return mem_is_zero_words(p, len);
+}
+#endif
+
+// =============================================================================
+// mem_is_zero:
+// Check if len bytes of m are all 0
+// Returns true if all bytes are 0, else false
+// =============================================================================
+bool mem_is_zero(VOID *m, UINTN len) {
+#ifdef MEM_VEC_SIZE
+    return mem_is_zero_vec(m, len);
+#else
+    return mem_is_zero_words(m, len);
+#endif
+}
+
+// =============================================================================
+// Build CRC32 (IEEE 802.3, reflected polynomial 0xEDB88320) lookup tables for 
+//   slice-by-8: crc32_tables[0] is the usual 1 byte table, and crc32_tables[k] 
+//   is the CRC of a byte followed by k zero bytes, so 8 bytes can be folded in 
+//   with 8 independent table lookups instead of 8 dependent ones.
+// =============================================================================
+VOID crc32_build_tables(VOID) {
+    for (UINT32 i = 0; i < 256; i++) {
+        UINT32 crc = i;
+        for (UINTN bit = 0; bit < 8; bit++) 
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        crc32_tables[0][i] = crc;
+    }
+
+    for (UINT32 i = 0; i < 256; i++) 
+        for (UINTN k = 1; k < 8; k++) 
+            crc32_tables[k][i] = (crc32_tables[k-1][i] >> 8) ^ crc32_tables[0][crc32_tables[k-1][i] & 0xFF];
+}
+
+// =============================================================================
+// CRC32 (slice-by-8):
+// Continue a CRC32 over len more bytes of buf, 8 bytes at a time. Start with 
+//   crc = 0; crc32_update(crc32_update(0, a), b) is the CRC32 of a then b.
+//   Tables are built on first use.
+// Returns updated CRC32
+// =============================================================================
+UINT32 crc32_update(UINT32 crc, VOID *buf, UINTN len) {
+    if (crc32_tables[0][1] == 0) crc32_build_tables();
+
+    UINT32 (*t)[256] = crc32_tables;
+    UINT8 *p = buf;
+    crc = ~crc;
+
+    // Bytes until 8 byte aligned, then 8 bytes at a time (little endian), then any tail
+    for (; len > 0 && ((UINTN)p & (MEM_WORD_SIZE-1)); len--, p++) 
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+
+    for (; len >= MEM_WORD_SIZE; len -= MEM_WORD_SIZE, p += MEM_WORD_SIZE) {
+        UINT64 w = *(Mem_Word *)p ^ crc;
+        crc = t[7][ w        & 0xFF] ^ t[6][(w >>  8) & 0xFF] ^ 
+              t[5][(w >> 16) & 0xFF] ^ t[4][(w >> 24) & 0xFF] ^ 
+              t[3][(w >> 32) & 0xFF] ^ t[2][(w >> 40) & 0xFF] ^ 
+              t[1][(w >> 48) & 0xFF] ^ t[0][ w >> 56        ];
+    }
+
+    for (; len > 0; len--, p++) 
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+
+    return ~crc;
+}
+
+// =====================================================================
+// (ASCII) strlen (bytes):
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_bytes(char *s) {
+    UINTN len = 0;
+    while (*s++) len++;
+    return len;
+}
+
+// =====================================================================
+// (ASCII) strlen (words):
+// Checks 8 characters at a time with aligned 64 bit loads, which never
+//   cross a page boundary past the NULL terminator.
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_words(char *s) {
+    char *p = s;
+
+    // Head: Bytes until word aligned
+    for (; (UINTN)p & (MEM_WORD_SIZE-1); p++) 
+        if (!*p) return p - s;
+
+    // Body: Aligned words until a word has a zero byte
+    UINT64 zeros = 0;
+    for (; !(zeros = mem_word_zero_bytes(*(Mem_Word *)p)); p += MEM_WORD_SIZE)
+        ;
+
+    // Lowest set bit is in the first zero byte (little endian)
+    return (p - s) + (__builtin_ctzll(zeros) / 8);
+}
+
+#ifdef MEM_VEC_SIZE
+// =====================================================================
+// (ASCII) strlen (vector):
+// Checks 16 characters at a time with aligned SSE2/NEON loads, which 
+//   never cross a page boundary past the NULL terminator.
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_vec(char *s) {
+    char *p = s;
+
+    // Head: Bytes until vector aligned
+    for (; (UINTN)p & (MEM_VEC_SIZE-1); p++) 
+        if (!*p) return p - s;
+
+    // Body: Aligned vectors until a vector has a zero byte
+    UINTN i = MEM_VEC_SIZE;
+    for (; (i = mem_vec_first_set((Mem_Vec)(mem_vec_load_a(p) == 0))) == MEM_VEC_SIZE; 
+         p += MEM_VEC_SIZE)
+        ;
+
+    return (p - s) + i;
+}
+#endif
+
+// =====================================================================
+// (ASCII) strlen:
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen(char *s) {
+#ifdef MEM_VEC_SIZE
+    return strlen_vec(s);
+#else
+    return strlen_words(s);
+#endif
+}
+
+// =====================================================================
+// (CHAR16) strlen (CHAR16s):
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_c16_chars(CHAR16 *s) {
+    UINTN len = 0;
+    while (*s++) len++;
+    return len;
+}
+
+// =====================================================================
+// (CHAR16) strlen (words):
+// Checks 4 characters at a time with aligned 64 bit loads, which never
+//   cross a page boundary past the NULL terminator.
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_c16_words(CHAR16 *s) {
+    CHAR16 *p = s;
+    if ((UINTN)s & 1) return strlen_c16_chars(s);   // Can't align an odd address
+
+    // Head: CHAR16s until word aligned
+    for (; (UINTN)p & (MEM_WORD_SIZE-1); p++) 
+        if (!*p) return p - s;
+
+    // Body: Aligned words until a word has a zero CHAR16
+    UINT64 zeros = 0;
+    for (; !(zeros = mem_word_zero_c16s(*(Mem_Word *)p)); p += MEM_WORD_SIZE / sizeof *p)
+        ;
+
+    // Lowest set bit is in the first zero CHAR16 (little endian)
+    return (p - s) + (__builtin_ctzll(zeros) / 16);
+}
+
+#ifdef MEM_VEC_SIZE
+// =====================================================================
+// (CHAR16) strlen (vector):
+// Checks 8 characters at a time with aligned SSE2/NEON loads, which 
+//   never cross a page boundary past the NULL terminator.
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_c16_vec(CHAR16 *s) {
+    CHAR16 *p = s;
+    if ((UINTN)s & 1) return strlen_c16_chars(s);   // Can't align an odd address
+
+    // Head: CHAR16s until vector aligned
+    for (; (UINTN)p & (MEM_VEC_SIZE-1); p++) 
+        if (!*p) return p - s;
+
+    // Body: Aligned vectors until a vector has a zero CHAR16
+    UINTN i = MEM_VEC_SIZE;
+    for (; (i = mem_vec_first_set((Mem_Vec)((Mem_Vec_16)mem_vec_load_a(p) == 0))) == MEM_VEC_SIZE; 
+         p += MEM_VEC_SIZE / sizeof *p)
+        ;
+
+    return (p - s) + (i / sizeof *p);
+}
+#endif
+
+// =====================================================================
+// (CHAR16) strlen:
+// Returns: length of string not including NULL terminator
+// =====================================================================
+UINTN strlen_c16(CHAR16 *s) {
+#ifdef MEM_VEC_SIZE
+    return strlen_c16_vec(s);
+#else
+    return strlen_c16_words(s);
+#endif
+}
+
+// =====================================================================
+// memmem:
+// Find first occurrence of needle bytes in haystack bytes, using
+//   Boyer-Moore-Horspool: on a mismatch, skip ahead by how far the last
+//   haystack byte in the window is from the end of the needle, so most
+//   haystack bytes are never compared.
+// Returns a pointer to the beginning of the located needle, or NULL if 
+//   not found. If needle is empty, returns haystack.
+// =====================================================================
+VOID *memmem(VOID *haystack, UINTN haystack_len, VOID *needle, UINTN needle_len) {
+    UINT8 *h = haystack, *n = needle;
+    if (needle_len == 0) return haystack;
+    if (needle_len > haystack_len) return NULL;
+
+    UINT8 last = n[needle_len-1];
+    if (needle_len == 1) {
+        for (UINTN i = 0; i < haystack_len; i++) 
+            if (h[i] == last) return h + i;
+        return NULL;
+    }
+
+    // Bad character skip table, skips are capped to fit in a byte which is always safe
+    UINT8 skip[256];
+    UINT8 max_skip = needle_len < 255 ? needle_len : 255;
+    memset(skip, max_skip, sizeof skip);
+    for (UINTN i = 0; i < needle_len-1; i++) {
+        UINTN dist = needle_len-1 - i;
+        skip[n[i]] = dist < 255 ? dist : 255;
+    }
+
+    for (UINTN pos = 0; pos <= haystack_len - needle_len; pos += skip[h[pos + needle_len-1]]) {
+        if (h[pos + needle_len-1] == last && !memcmp(h + pos, n, needle_len-1))
+            return h + pos;
+    }
+
+    return NULL;
+}
+
+// =====================================================================
+// (ASCII) strstr:
+// Return a pointer to the beginning of the located
+//   substring, or NULL if the substring is not found.
+//   If needle is the empty string, the return value is always haystack
+//   itself.
+// =====================================================================
+char *strstr(char *haystack, char *needle) {
+    if (!needle) return haystack;
+
+    return memmem(haystack, strlen(haystack), needle, strlen(needle));
+}
+
+// ======================================================================
+// (ASCII) stpstr:
+// Return a pointer to the terminating NULL byte of found substring,
+//   or NULL if the substring is not found.
+//   If needle is the empty string, the return value is always haystack
+//   itself.
+// ======================================================================
+char *stpstr(char *haystack, char *needle) {
+    if (!needle) return haystack;
+
+    UINTN needle_len = strlen(needle);
+    char *pos = memmem(haystack, strlen(haystack), needle, needle_len);
+    return pos ? pos + needle_len : NULL;
+}
+
+// ======================================================================
+// (ASCII) stpstr for many needles in one pass over a haystack of 
+//   haystack_len bytes (does not need to be NULL terminated): first 
+//   occurrence of each needle anywhere. Each haystack byte is checked 
+//   against a table of needle first bytes, so only needles that could 
+//   start there are compared. At most 64 needles.
+// Returns: # of needles found; ends[i] = pointer to end of found 
+//   needle i, or NULL if not found.
+// ======================================================================
+UINTN stpstr_many(char *haystack, UINTN haystack_len, char **needles, UINTN num_needles, char **ends) {
+    UINTN found = 0;
+    for (UINTN i = 0; i < num_needles; i++) ends[i] = NULL;
+
+    // Bitmask of needles for each possible first byte
+    UINT64 first_bytes[256] = {0};
+    UINTN needle_lens[64];
+    if (num_needles > ARRAY_SIZE(needle_lens)) num_needles = ARRAY_SIZE(needle_lens);
+
+    for (UINTN i = 0; i < num_needles; i++) {
+        needle_lens[i] = strlen(needles[i]);
+        if (needle_lens[i] == 0) {
+            ends[i] = haystack;     // Empty needle always matches at start
+            found++;
+            continue;
+        }
+        first_bytes[(UINT8)needles[i][0]] |= 1ULL << i;
+    }
+
+    for (UINTN pos = 0; pos < haystack_len && found < num_needles; pos++) {
+        UINT64 candidates = first_bytes[(UINT8)haystack[pos]];
+        while (candidates) {
+            UINTN i = __builtin_ctzll(candidates);
+            candidates &= candidates-1;     // Clear lowest set bit
+
+            if (needle_lens[i] <= haystack_len - pos && 
+                !memcmp(haystack + pos, needles[i], needle_lens[i])) {
+                ends[i] = haystack + pos + needle_lens[i];
+                found++;
+                first_bytes[(UINT8)needles[i][0]] &= ~(1ULL << i);  // Only need 1st occurrence
+            }
+        }
+    }
+
+    return found;
+}
+
+// =====================================================================
+// (ASCII) isdigit:
+// Returns: true/1 if char c >= 0 and <= 9, else 0/false
+// =====================================================================
+BOOLEAN isdigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// =====================================================================
+// CHAR16 isdigit:
+// Returns: true/1 if char c >= 0 and <= 9, else 0/false
+// =====================================================================
+BOOLEAN isdigit_c16(CHAR16 c) {
+    return c >= u'0' && c <= u'9';
+}
+
+// =====================================================================
+// CHAR16 isxdigit:
+// Returns: true/1 if char c >= 0   and <= 9   or 
+//                           >= 'a' and <= 'f' or
+//                           >= 'A' and <= 'F'
+// =====================================================================
+BOOLEAN isxdigit_c16(CHAR16 c) {
+    return (c >= u'0' && c <= u'9') ||
+           (c >= u'a' && c <= u'f') ||
+           (c >= u'A' && c <= u'F');
+}
+
+// ======================================================
+// (ASCII) strrev:
+//  Reverse a string.
+//  Returns reversed string.
+// ======================================================
+char *strrev(char *s) {
+    if (!s) return s;
+
+    char *start = s, *end = s + strlen(s)-1;
+    while (start < end) {
+        char temp = *end;  // Swap
+        *end-- = *start;
+        *start++ = temp;
+    }
+
+    return s;
+}
+
+// ======================================================
+// (CHAR16) strrev:
+//  Reverse a string.
+//  Returns reversed string.
+// ======================================================
+CHAR16 *strrev_c16(CHAR16 *s) {
+    if (!s) return s;
+
+    CHAR16 *start = s, *end = s + strlen_c16(s)-1;
+    while (start < end) {
+        CHAR16 temp = *end;  // Swap
+        *end-- = *start;
+        *start++ = temp;
+    }
+
+    return s;
+}
+
+// =============================================
+// (ASCII) atoi: 
+// Converts intial value of input string to 
+//   int.
+// Returns converted value or 0 on error
+// =============================================
+INTN atoi(char *s) {
+    INTN result = 0;
+    while (isdigit(*s)) 
+        result = (result * 10) + (*s++ - '0');
+
+    return result;
+}
+
+// ======================================================
+// (ASCII) itoa:
+//  Convert integer to string representation.
+//  Returns input string.
+// ======================================================
+char *itoa(int32_t number, char *s, uint8_t base) {
+    char *p = s;
+    uint8_t digit = 0;
+    do {
+        digit = number % base;
+        if (digit < 10) *s++ = digit + '0';
+        else            *s++ = 'A' + digit - 10;
+        number /= base;
+    } while (number > 0);
+
+    *s = '\0';
+    strrev(p);
+
+    return p;
+}
+
+// ============================
+// (CHAR16) strcpy:
+//   Copy src string into dst 
+//   Returns dst
+// ============================
+CHAR16 *strcpy_c16(CHAR16 *dst, CHAR16 *src) {
+    if (!dst || !src) return dst;
+
+    CHAR16 *result = dst;
+    while (*src) *dst++ = *src++;
+
+    *dst = u'\0';   // Null terminate
 
     return result;
 }
@@ -512,6 +1403,19 @@ char *stpcpy(char *dst, char *src) {
     return dst;
 }
 
+// ================================
+// (ASCII) strncmp:
+//   Compare 2 strings, each character, up to at most len bytes
+//   Returns difference in strings at last point of comparison:
+//   0 if strings are equal, <0 if s2 is greater, >0 if s1 is greater
+// ================================
+INTN strncmp(char *s1, char *s2, UINTN len) {
+    for (; len > 0; s1++, s2++, len--) 
+        if (*s1 != *s2 || !*s1) return (UINT8)*s1 - (UINT8)*s2;
+
+    return 0;
+}
+
 // ================================
 // CHAR16 strncmp:
 //   Compare 2 strings, each character, up to at most len bytes
@@ -627,387 +1531,550 @@ VOID *get_config_table_by_guid(EFI_GUID guid) {
     return NULL;    // Did not find config table
 }
 
-// ==========================================
-// (CHAR16) Add integer as string to buffer
-// ==========================================
-BOOLEAN
-add_int_to_buf_c16(UINTN number, UINT8 base, BOOLEAN signed_num, UINTN min_digits, CHAR16 *buf, 
-                   UINTN *buf_idx) {
-    const CHAR16 *digits = u"0123456789ABCDEF";
-    CHAR16 buffer[24];  // Hopefully enough for UINTN_MAX (UINT64_MAX) + sign character
-    UINTN i = 0;
-    BOOLEAN negative = FALSE;
+// ===========================================================================
+// Get console buffer for a text output stream, claiming a free slot if needed
+// Returns NULL if all slots are in use; output to that stream is unbuffered
+// ===========================================================================
+Console_Buffer *console_buffer(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream) {
+    Console_Buffer *free_slot = NULL;
 
-    if (base > 16) {
-        cerr->OutputString(cerr, u"Invalid base specified!\r\n");
-        return FALSE;    // Invalid base
+    for (UINTN i = 0; i < ARRAY_SIZE(console_bufs); i++) {
+        if (console_bufs[i].stream == stream) return &console_bufs[i];
+        if (!console_bufs[i].stream && !free_slot) free_slot = &console_bufs[i];
     }
 
-    // Only use and print negative numbers if decimal and signed True
-    if (base == 10 && signed_num && (INTN)number < 0) {
-       number = -(INTN)number;  // Get absolute value of correct signed value to get digits to print
-       negative = TRUE;
+    if (free_slot) {
+        free_slot->stream = stream;
+        free_slot->len = free_slot->newlines = 0;
     }
+    return free_slot;
+}
 
-    do {
-       buffer[i++] = digits[number % base];
-       number /= base;
-    } while (number > 0);
-
-    while (i < min_digits) buffer[i++] = u'0'; // Pad with 0s
+// ===================================================================
+// (CHAR16) Write a console buffer with OutputString() and empty it.
+//   Caller must be at TPL_CALLBACK, so timer callbacks that print (e.g.
+//   the menu clock) can not change the buffer in between.
+// Returns: OutputString() status
+// ===================================================================
+EFI_STATUS output_console_buffer(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, Console_Buffer *cb) {
+    if (cb->len == 0) return EFI_SUCCESS;
 
-    // Add negative sign for decimal numbers
-    if (base == 10 && negative) buffer[i++] = u'-';
+    cb->buf[cb->len] = u'\0';
+    cb->len = cb->newlines = 0;
+    return stream->OutputString(stream, cb->buf);
+}
 
-    // NULL terminate string
-    buffer[i--] = u'\0';
+// ===================================================================
+// (CHAR16) Write any buffered output for a stream with OutputString()
+//   Runs at TPL_CALLBACK, so timer callbacks that print (e.g. the
+//   menu clock) can not interleave with a partially written buffer.
+// Returns true on success, false if OutputString() failed
+// ===================================================================
+bool flush_c16(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream) {
+    Console_Buffer *cb = console_buffer(stream);
+    if (!cb || cb->len == 0) return true;
 
-    // Reverse buffer to read left to right
-    strrev_c16(buffer);
+    EFI_TPL old_tpl = bs->RaiseTPL(TPL_CALLBACK);
+    EFI_STATUS status = output_console_buffer(stream, cb);
+    bs->RestoreTPL(old_tpl);
 
-    // Add number string to input buffer for printing
-    for (CHAR16 *p = buffer; *p; p++) {
-        buf[*buf_idx] = *p;
-        *buf_idx += 1;
-    }
-    return TRUE;
+    return !EFI_ERROR(status);
 }
 
 // ========================================================================
-// (CHAR16) Fill formatted string buffer with printf() format conversions
+// (CHAR16) Append len characters of str to a stream's console buffer,
+//   flushing first if they would not fit. Strings larger than the buffer
+//   are written directly after flushing, to keep output in order.
+//   The space check, flush & append all run at TPL_CALLBACK: a timer 
+//   callback that prints between a check and the append could otherwise 
+//   fill the buffer and the append would overflow it.
+// Returns true on success, false if OutputString() failed
 // ========================================================================
-bool format_string_c16(CHAR16 *buf, CHAR16 *fmt, va_list args) {
-    bool result = true;
-    CHAR16 charstr[2] = {0};    
-    UINTN buf_idx = 0;
-
-    for (UINTN i = 0; fmt[i] != u'\0'; i++) {
-        if (fmt[i] == u'%') {
-            bool alternate_form = false;
-            UINTN min_field_width = 0;
-            UINTN precision = 0;
-            UINTN length_bits = 0;  
-            UINTN num_printed = 0;      // # of digits/chars printed for numbers or strings
-            UINT8 base = 0;
-            bool input_precision = false;
-            bool signed_num   = false;
-            bool int_num      = false;
-            bool double_num   = false;
-            bool left_justify = false;  // Left justify text from '-' flag instead of default right justify
-            bool space_flag   = false;
-            bool plus_flag    = false;
-            CHAR16 padding_char = ' ';  // '0' or ' ' depending on flags
-            i++;
-
-            // Check for flags
-            while (true) {
-                switch (fmt[i]) {
-                    case u'#':
-                        // Alternate form
-                        alternate_form = true;
-                        i++;
-                        continue;
-
-                    case u'0':
-                        // 0-pad numbers on the left, unless '-' or precision is also defined
-                        padding_char = '0'; 
-                        i++;
-                        continue;
-
-                    case u' ':
-                        // Print a space before positive signed number conversion or empty string
-                        //   number conversions
-                        space_flag = true;
-                        if (plus_flag) space_flag = false;  // Plus flag '+' overrides space flag
-                        i++;
-                        continue;
-
-                    case u'+':
-                        // Always print +/- before a signed number conversion
-                        plus_flag = true;
-                        if (space_flag) space_flag = false; // Plus flag '+' overrides space flag
-                        i++;
-                        continue;
-
-                    case u'-':
-                        left_justify = true;
-                        i++;
-                        continue;
-
-                    default:
-                        break;
-                }
-                break; // No more flags
-            }
+bool write_c16(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, CHAR16 *str, UINTN len) {
+    Console_Buffer *cb = console_buffer(stream);
+    if (!cb) return !EFI_ERROR(stream->OutputString(stream, str));
 
-            // Check for minimum field width e.g. in "8.2" this would be 8
-            if (fmt[i] == u'*') {
-                // Get int argument for min field width
-                min_field_width = va_arg(args, int);
-                i++;
-            } else {
-                // Get number literal from format string
-                while (isdigit_c16(fmt[i])) 
-                    min_field_width = (min_field_width * 10) + (fmt[i++] - u'0');
-            }
+    EFI_TPL old_tpl = bs->RaiseTPL(TPL_CALLBACK);
+    EFI_STATUS status = EFI_SUCCESS;
 
-            // Check for precision/maximum field width e.g. in "8.2" this would be 2
-            if (fmt[i] == u'.') {
-                input_precision = true; 
-                i++;
-                if (fmt[i] == u'*') {
-                    // Get int argument for precision
-                    precision = va_arg(args, int);
-                    i++;
-                } else {
-                    // Get number literal from format string
-                    while (isdigit_c16(fmt[i])) 
-                        precision = (precision * 10) + (fmt[i++] - u'0');
-                }
-            }
+    if (cb->len + len > CONSOLE_BUF_LEN) status = output_console_buffer(stream, cb);
 
-            // Check for Length modifiers e.g. h/hh/l/ll
-            if (fmt[i] == u'h') {
-                i++;
-                length_bits = 16;       // h
-                if (fmt[i] == u'h') {
-                    i++;
-                    length_bits = 8;    // hh
-                }
-            } else if (fmt[i] == u'l') {
-                i++;
-                length_bits = 32;       // l
-                if (fmt[i] == u'l') {
-                    i++;
-                    length_bits = 64;    // ll
-                }
-            }
+    if (!EFI_ERROR(status)) {
+        if (len > CONSOLE_BUF_LEN) 
+            status = stream->OutputString(stream, str);
+        else {
+            for (UINTN i = 0; i < len; i++) cb->newlines += str[i] == u'\n';
+            memcpy(cb->buf + cb->len, str, len * sizeof *str);
+            cb->len += len;
+        }
+    }
 
-            // Check for conversion specifier
-            switch (fmt[i]) {
-                case u'c': {
-                    // Print CHAR16 value; printf("%c", char)
-                    if (length_bits == 8)
-                        charstr[0] = (char)va_arg(args, int);   // %hhc "ascii" or other 8 bit char
-                    else
-                        charstr[0] = (CHAR16)va_arg(args, int); // Assuming 16 bit char16_t
-
-                    // Only add non-null characters, to not end string early
-                    if (charstr[0]) buf[buf_idx++] = charstr[0];    
-                }
-                break;
+    bs->RestoreTPL(old_tpl);
+    return !EFI_ERROR(status);
+}
 
-                case u's': {
-                    // Print CHAR16 string; printf("%s", string)
-                    if (length_bits == 8) {
-                        char *string = va_arg(args, char*);         // %hhs; Assuming 8 bit ascii chars
-                        while (*string) {
-                            buf[buf_idx++] = *string++;
-                            if (++num_printed == precision) break;  // Stop printing at max characters
-                        }
-
-                    } else {
-                        CHAR16 *string = va_arg(args, CHAR16*);     // Assuming 16 bit char16_t
-                        while (*string) {
-                            buf[buf_idx++] = *string++;
-                            if (++num_printed == precision) break;  // Stop printing at max characters
-                        }
-                    }
-                }
-                break;
+// ==========================================================================
+// Console state wrappers: flush pending output first, so that the screen &
+//   cursor state the firmware sees matches what has been printed so far
+// ==========================================================================
+EFI_STATUS clear_screen(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream) {
+    flush_c16(stream);
+    return stream->ClearScreen(stream);
+}
 
-                case u'd': {
-                    // Print INT32; printf("%d", number_int32)
-                    int_num = true;
-                    base = 10;
-                    signed_num = true;
-                }
-                break;
+EFI_STATUS set_cursor_position(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, UINTN col, UINTN row) {
+    flush_c16(stream);
+    return stream->SetCursorPosition(stream, col, row);
+}
 
-                case u'x': {
-                    // Print hex UINTN; printf("%x", number_uintn)
-                    int_num = true;
-                    base = 16;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'x';
-                    }
-                }
-                break;
+EFI_STATUS set_attribute(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, UINTN attribute) {
+    flush_c16(stream);
+    return stream->SetAttribute(stream, attribute);
+}
 
-                case u'u': {
-                    // Print UINT32; printf("%u", number_uint32)
-                    int_num = true;
-                    base = 10;
-                    signed_num = false;
-                }
-                break;
+// Current mode/cursor info, e.g. text_mode(cout)->CursorColumn
+SIMPLE_TEXT_OUTPUT_MODE *text_mode(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream) {
+    flush_c16(stream);
+    return stream->Mode;
+}
 
-                case u'b': {
-                    // Print UINTN as binary; printf("%b", number_uintn)
-                    int_num = true;
-                    base = 2;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'b';
-                    }
-                }
-                break;
+// ==========================================================================
+// Cursor row once buffered output is written, without flushing it: the 
+//   firmware's row plus buffered newlines. Lines wider than the screen are
+//   counted as 1 row. For paging long output, which only flushes when the
+//   page is full and get_key() waits.
+// ==========================================================================
+INT32 cursor_row(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream) {
+    Console_Buffer *cb = console_buffer(stream);
+    return stream->Mode->CursorRow + (cb ? (INT32)cb->newlines : 0);
+}
 
-                case u'o': {
-                    // Print UINTN as octal; printf("%o", number_uintn)
-                    int_num = true;
-                    base = 8;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'o';
-                    }
-                }
-                break;
+// ====================
+// Get key from user
+// ====================
+EFI_INPUT_KEY get_key(void) {
+    EFI_EVENT events[1] = { cin->WaitForKey };
+    EFI_INPUT_KEY key = {0};
+    UINTN index = 0;
 
-                case u'f': {
-                    // Print INTN rounded float value
-                    double_num = true;
-                    signed_num = true;
-                    base = 10;
-                    if (!input_precision) precision = 6;    // Default decimal places to print
-                }
-                break;
+    flush_c16(cout);
+    bs->WaitForEvent(1, events, &index);
+    cin->ReadKeyStroke(cin, &key);
+    return key;
+}
 
-                default:
-                    strcpy_c16(buf, u"Invalid format specifier: %");
-                    charstr[0] = fmt[i];
-                    strcat_c16(buf, charstr);
-                    strcat_c16(buf, u"\r\n");
-                    result = false;
-                    goto end;
-                    break;
-            }
+// Add a char to a format_string() buffer. buf_idx keeps counting past max_len, 
+//   so field width padding is relative to the full conversion even when truncated
+#define PUT_FMT_CHAR(c) do {                        \
+    __typeof__(*buf) fmt_char = (c);                \
+    if (buf_idx < max_len) buf[buf_idx] = fmt_char; \
+    buf_idx++;                                      \
+} while (0)
+
+// "00" to "99", for converting decimal numbers 2 digits per division
+const char digit_pairs[200] = 
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Powers of 10 that fit in a UINT64, for counting decimal digits
+const UINT64 powers_of_10[20] = {
+    1ULL,                10ULL,                100ULL,                1000ULL, 
+    10000ULL,            100000ULL,            1000000ULL,            10000000ULL, 
+    100000000ULL,        1000000000ULL,        10000000000ULL,        100000000000ULL, 
+    1000000000000ULL,    10000000000000ULL,    100000000000000ULL,    1000000000000000ULL, 
+    10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
 
-            if (int_num) {
-                // Number conversion: Integer
-                UINT64 number = 0;
-                switch (length_bits) {
-                    case 0:
-                    case 32: 
-                    default:
-                        // l
-                        number = va_arg(args, UINT32);
-                        if (signed_num) number = (INT32)number;
-                        break;
-
-                    case 8:
-                        // hh
-                        number = (UINT8)va_arg(args, int);
-                        if (signed_num) number = (INT8)number;
-                        break;
-
-                    case 16:
-                        // h
-                        number = (UINT16)va_arg(args, int);
-                        if (signed_num) number = (INT16)number;
-                        break;
-
-                    case 64:
-                        // ll
-                        number = va_arg(args, UINT64);
-                        if (signed_num) number = (INT64)number;
-                        break;
-                }
-
-                // Add space before positive number for ' ' flag
-                if (space_flag && signed_num && (INTN)number >= 0) buf[buf_idx++] = u' ';    
-
-                // Add sign +/- before signed number for '+' flag
-                if (plus_flag && signed_num) buf[buf_idx++] = (INTN)number >= 0 ? u'+' : u'-';
-
-                add_int_to_buf_c16(number, base, signed_num, precision, buf, &buf_idx);
-            }
+// =====================================================================
+// Get # of digits needed to print a number in a given base (2-16)
+//   Bit length for powers of 2, and a log10 estimate from the bit 
+//   length corrected with 1 table compare for base 10.
+// Returns # of digits, at least 1 (for 0)
+// =====================================================================
+UINTN int_num_digits(UINT64 number, UINT8 base) {
+    UINTN bits = 64 - __builtin_clzll(number | 1);
 
-            if (double_num) {
-                // Number conversion: Float/Double
-                double number = va_arg(args, double);
-                INTN whole_num = 0;
-
-                // Get digits before decimal point
-                whole_num = (INTN)number;
-                if (whole_num < 0) whole_num = -whole_num;
-
-                UINTN num_digits = 0;
-                do {
-                   num_digits++; 
-                   whole_num /= 10;
-                } while (whole_num > 0);
-
-                // Add digits to write buffer
-                add_int_to_buf_c16(number, base, signed_num, num_digits, buf, &buf_idx);
-
-                // Print decimal digits equal to precision value, 
-                //   if precision is explicitly 0 then do not print
-                if (!input_precision || precision != 0) {
-                    buf[buf_idx++] = u'.';      // Add decimal point
-
-                    if (number < 0.0) number = -number; // Ensure number is positive
-                    whole_num = (INTN)number;
-                    number -= whole_num;                // Get only decimal digits
-                    signed_num = FALSE;                 // Don't print negative sign for decimals
-
-                    // Move precision # of decimal digits before decimal point 
-                    //   using base 10, number = number * 10^precision
-                    for (UINTN i = 0; i < precision; i++)
-                        number *= 10;
-
-                    // Add digits to write buffer
-                    add_int_to_buf_c16(number, base, signed_num, precision, buf, &buf_idx);
-                }
-            }
+    switch (base) {
+        case 2:  return bits;
+        case 8:  return (bits + 2) / 3;
+        case 16: return (bits + 3) / 4;
 
-            // Flags are defined such that 0 is overruled by left justify and precision
-            if (padding_char == u'0' && (left_justify || precision > 0))
-                padding_char = u' ';
-
-            // Add padding depending on flags (0 or space) and left/right justify
-            INTN diff = min_field_width - buf_idx;
-            if (diff > 0) {
-                if (left_justify) {
-                    // Append padding to minimum width, always spaces
-                    while (diff--) buf[buf_idx++] = u' ';   
-                } else {
-                    // Right justify
-                    // Copy buffer to end of buffer
-                    INTN dst = min_field_width-1, src = buf_idx-1;
-                    while (src >= 0)  buf[dst--] = buf[src--];  // e.g. "TEST\0\0" -> "TETEST"
-
-                    // Overwrite beginning of buffer with padding
-                    dst = (int_num && alternate_form) ? 2 : 0;  // Skip 0x/0b/0o/... prefix
-                    while (diff--) buf[dst++] = padding_char;   // e.g. "TETEST" -> "  TEST"
-                }
-            }
+        case 10: {
+            UINTN estimate = (bits * 1233) >> 12;  // 1233/4096 ~= log10(2)
+            return estimate + ((number | 1) >= powers_of_10[estimate]);
+        }
 
-        } else {
-            // Not formatted string, print next character
-            buf[buf_idx++] = fmt[i];
+        default: {
+            UINTN num_digits = 1;
+            while (number >= base) {
+                number /= base;
+                num_digits++;
+            }
+            return num_digits;
         }
     }
+}
 
-    end:
-    buf[buf_idx] = u'\0'; 
-    va_end(args);
-    return result;
+// printf() flag characters, as bits in format_flags[]
+enum {
+    FMT_FLAG_ALTERNATE = (1 << 0),  // '#'
+    FMT_FLAG_ZERO      = (1 << 1),  // '0'
+    FMT_FLAG_SPACE     = (1 << 2),  // ' '
+    FMT_FLAG_PLUS      = (1 << 3),  // '+'
+    FMT_FLAG_LEFT      = (1 << 4),  // '-'
+};
+
+const UINT8 format_flags[128] = {
+    ['#'] = FMT_FLAG_ALTERNATE,
+    ['0'] = FMT_FLAG_ZERO,
+    [' '] = FMT_FLAG_SPACE,
+    ['+'] = FMT_FLAG_PLUS,
+    ['-'] = FMT_FLAG_LEFT,
+};
+
+// printf() conversion specifiers
+typedef enum {
+    FMT_CONV_INVALID,
+    FMT_CONV_CHAR,
+    FMT_CONV_STRING,
+    FMT_CONV_INT,
+    FMT_CONV_FLOAT,
+} Format_Conversion;
+
+typedef struct {
+    Format_Conversion conversion;
+    UINT8 base;
+    bool  signed_num;
+    char  *prefix;      // Prefix for alternate form '#' flag
+} Format_Spec;
+
+const Format_Spec format_specs[] = {
+    { FMT_CONV_INVALID, 0,  false, ""   },
+    { FMT_CONV_CHAR,    0,  false, ""   },  // %c: CHAR16, or char for %hhc
+    { FMT_CONV_STRING,  0,  false, ""   },  // %s: CHAR16 string, or char string for %hhs
+    { FMT_CONV_INT,     10, true,  ""   },  // %d: INT32, or h/hh/l/ll sizes
+    { FMT_CONV_INT,     10, false, ""   },  // %u: UINT32
+    { FMT_CONV_INT,     16, false, "0x" },  // %x: Hex
+    { FMT_CONV_INT,     2,  false, "0b" },  // %b: Binary
+    { FMT_CONV_INT,     8,  false, "0o" },  // %o: Octal
+    { FMT_CONV_FLOAT,   10, true,  ""   },  // %f: Double
+};
+
+// Conversion specifier character -> format_specs[] index, 0 = invalid
+const UINT8 format_spec_index[128] = {
+    ['c'] = 1, ['s'] = 2, ['d'] = 3, ['u'] = 4, ['x'] = 5, ['b'] = 6, ['o'] = 7, ['f'] = 8,
+};
+
+// Look up a format char in a 128 entry table, 0 for chars outside ASCII
+#define FORMAT_LOOKUP(table, c) ((UINTN)(c) < ARRAY_SIZE(table) ? (table)[(UINTN)(c)] : 0)
+
+// ==============================================================================
+// Format engine template, instantiated once per string char type CHAR_T with
+//   function name suffix SUFFIX (_c16 for CHAR16, none for ASCII). Defines:
+//
+//   add_int_to_buf<SUFFIX>(): Add integer as string to buffer, padded with 0s to 
+//     min_digits. Returns TRUE on success, FALSE for an invalid base.
+//
+//   format_string<SUFFIX>(): Fill formatted string buffer of size chars with 
+//     printf() format conversions. Flags and conversion specifiers are looked up 
+//     in format_flags[] and format_specs[]. Output is truncated to fit and 
+//     always NULL terminated if size > 0. Returns # of chars written not 
+//     including NULL terminator, or -1 for an invalid format specifier.
+// ==============================================================================
+#define DEFINE_FORMAT_FUNCS(CHAR_T, SUFFIX)                                                                      \
+BOOLEAN                                                                                                          \
+add_int_to_buf##SUFFIX(UINTN number, UINT8 base, BOOLEAN signed_num, UINTN min_digits, CHAR_T *buf,              \
+                       UINTN max_len, UINTN *buf_idx) {                                                          \
+    const char *digits = "0123456789ABCDEF";                                                                     \
+    CHAR_T scratch[64];     /* Digits that don't all fit in buf; UINT64_MAX in base 2 is 64 digits */            \
+                                                                                                                 \
+    if (base < 2 || base > 16) {                                                                                 \
+        CHAR16 msg[] = u"Invalid base specified!\r\n";                                                           \
+        write_c16(cerr, msg, ARRAY_SIZE(msg)-1);                                                                 \
+        return FALSE;   /* Invalid base */                                                                       \
+    }                                                                                                            \
+                                                                                                                 \
+    /* Only use and print negative numbers if decimal and signed True */                                         \
+    if (base == 10 && signed_num && (INTN)number < 0) {                                                          \
+        number = -(INTN)number;                                                                                  \
+        if (*buf_idx < max_len) buf[*buf_idx] = '-';                                                             \
+        *buf_idx += 1;                                                                                           \
+    }                                                                                                            \
+                                                                                                                 \
+    /* Pad with 0s, buf_idx counts all chars but only the first max_len are written */                           \
+    UINTN num_digits = int_num_digits(number, base);                                                             \
+    for (UINTN i = num_digits; i < min_digits; i++) {                                                            \
+        if (*buf_idx < max_len) buf[*buf_idx] = '0';                                                             \
+        *buf_idx += 1;                                                                                           \
+    }                                                                                                            \
+                                                                                                                 \
+    /* Write digits right to left, straight into buf if they all fit */                                          \
+    bool fits = *buf_idx <= max_len && num_digits <= max_len - *buf_idx;                                         \
+    CHAR_T *start = fits ? buf + *buf_idx : scratch;                                                             \
+    CHAR_T *p = start + num_digits;                                                                              \
+                                                                                                                 \
+    switch (base) {                                                                                              \
+        case 16:                                                                                                 \
+            do {                                                                                                 \
+                *--p = digits[number & 0xF];                                                                     \
+                number >>= 4;                                                                                    \
+            } while (number > 0);                                                                                \
+            break;                                                                                               \
+                                                                                                                 \
+        case 2:                                                                                                  \
+            do {                                                                                                 \
+                *--p = '0' + (number & 1);                                                                       \
+                number >>= 1;                                                                                    \
+            } while (number > 0);                                                                                \
+            break;                                                                                               \
+                                                                                                                 \
+        case 10:                                                                                                 \
+            /* 2 digits per division, looked up from "00".."99" */                                               \
+            while (number >= 100) {                                                                              \
+                const char *pair = &digit_pairs[(number % 100) * 2];                                             \
+                number /= 100;                                                                                   \
+                *--p = pair[1];                                                                                  \
+                *--p = pair[0];                                                                                  \
+            }                                                                                                    \
+            if (number >= 10) {                                                                                  \
+                *--p = digit_pairs[number*2 + 1];                                                                \
+                *--p = digit_pairs[number*2];                                                                    \
+            } else {                                                                                             \
+                *--p = '0' + number;                                                                             \
+            }                                                                                                    \
+            break;                                                                                               \
+                                                                                                                 \
+        default:                                                                                                 \
+            do {                                                                                                 \
+                *--p = digits[number % base];                                                                    \
+                number /= base;                                                                                  \
+            } while (number > 0);                                                                                \
+            break;                                                                                               \
+    }                                                                                                            \
+                                                                                                                 \
+    /* Copy only the digits that fit when truncating output */                                                   \
+    if (!fits) {                                                                                                 \
+        for (UINTN i = 0; i < num_digits && *buf_idx + i < max_len; i++)                                         \
+            buf[*buf_idx + i] = scratch[i];                                                                      \
+    }                                                                                                            \
+    *buf_idx += num_digits;                                                                                      \
+    return TRUE;                                                                                                 \
+}                                                                                                                \
+                                                                                                                 \
+INTN format_string##SUFFIX(CHAR_T *buf, UINTN size, CHAR_T *fmt, va_list args) {                                 \
+    bool result = true;                                                                                          \
+    UINTN buf_idx = 0;                  /* # of chars output so far, including any not written */                \
+    UINTN max_len = size ? size-1 : 0;  /* Max # of chars to write, leaving room for NULL terminator */          \
+                                                                                                                 \
+    while (*fmt && buf_idx < max_len) {                                                                          \
+        /* Not formatted string, print next character */                                                         \
+        if (*fmt != '%') {                                                                                       \
+            buf[buf_idx++] = *fmt++;                                                                             \
+            continue;                                                                                            \
+        }                                                                                                        \
+        fmt++;                                                                                                   \
+                                                                                                                 \
+        UINTN conv_start = buf_idx;     /* Start of this conversion in buf, for field width padding */           \
+        UINTN min_field_width = 0;                                                                               \
+        UINTN precision = 0;                                                                                     \
+        UINTN length_bits = 0;                                                                                   \
+        bool input_precision = false;                                                                            \
+                                                                                                                 \
+        /* Flags, e.g. in "%-08x" these would be '-' and '0' */                                                  \
+        UINT8 flags = 0;                                                                                         \
+        for (UINT8 flag; (flag = FORMAT_LOOKUP(format_flags, *fmt)); fmt++) flags |= flag;                       \
+                                                                                                                 \
+        /* Minimum field width e.g. in "8.2" this would be 8 */                                                  \
+        if (*fmt == '*') {                                                                                       \
+            min_field_width = va_arg(args, int);                                                                 \
+            fmt++;                                                                                               \
+        } else {                                                                                                 \
+            while (*fmt >= '0' && *fmt <= '9')                                                                   \
+                min_field_width = (min_field_width * 10) + (*fmt++ - '0');                                       \
+        }                                                                                                        \
+                                                                                                                 \
+        /* Precision/maximum field width e.g. in "8.2" this would be 2 */                                        \
+        if (*fmt == '.') {                                                                                       \
+            input_precision = true;                                                                              \
+            fmt++;                                                                                               \
+            if (*fmt == '*') {                                                                                   \
+                precision = va_arg(args, int);                                                                   \
+                fmt++;                                                                                           \
+            } else {                                                                                             \
+                while (*fmt >= '0' && *fmt <= '9')                                                               \
+                    precision = (precision * 10) + (*fmt++ - '0');                                               \
+            }                                                                                                    \
+        }                                                                                                        \
+                                                                                                                 \
+        /* Length modifiers h/hh/l/ll */                                                                         \
+        if (*fmt == 'h') {                                                                                       \
+            fmt++;                                                                                               \
+            length_bits = 16;       /* h */                                                                      \
+            if (*fmt == 'h') {                                                                                   \
+                fmt++;                                                                                           \
+                length_bits = 8;    /* hh */                                                                     \
+            }                                                                                                    \
+        } else if (*fmt == 'l') {                                                                                \
+            fmt++;                                                                                               \
+            length_bits = 32;       /* l */                                                                      \
+            if (*fmt == 'l') {                                                                                   \
+                fmt++;                                                                                           \
+                length_bits = 64;   /* ll */                                                                     \
+            }                                                                                                    \
+        }                                                                                                        \
+                                                                                                                 \
+        /* Conversion specifier */                                                                               \
+        const Format_Spec *spec = &format_specs[FORMAT_LOOKUP(format_spec_index, *fmt)];                         \
+        bool signed_num = spec->signed_num;                                                                      \
+        const char *prefix = (flags & FMT_FLAG_ALTERNATE) ? spec->prefix : "";                                   \
+                                                                                                                 \
+        switch (spec->conversion) {                                                                              \
+            case FMT_CONV_CHAR: {                                                                                \
+                /* %hhc "ascii" or other 8 bit char, else a CHAR_T */                                            \
+                CHAR_T c = (length_bits == 8) ? (char)va_arg(args, int) : (CHAR_T)va_arg(args, int);             \
+                                                                                                                 \
+                /* Only add non-null characters, to not end string early */                                      \
+                if (c) PUT_FMT_CHAR(c);                                                                          \
+            }                                                                                                    \
+            break;                                                                                               \
+                                                                                                                 \
+            case FMT_CONV_STRING: {                                                                              \
+                /* %hhs is an 8 bit ascii string, else a CHAR_T string; stop at precision chars */               \
+                UINTN num_printed = 0;                                                                           \
+                if (length_bits == 8) {                                                                          \
+                    for (char *s = va_arg(args, char *); *s; s++) {                                              \
+                        PUT_FMT_CHAR(*s);                                                                        \
+                        if (++num_printed == precision) break;                                                   \
+                    }                                                                                            \
+                } else {                                                                                         \
+                    for (CHAR_T *s = va_arg(args, CHAR_T *); *s; s++) {                                          \
+                        PUT_FMT_CHAR(*s);                                                                        \
+                        if (++num_printed == precision) break;                                                   \
+                    }                                                                                            \
+                }                                                                                                \
+            }                                                                                                    \
+            break;                                                                                               \
+                                                                                                                 \
+            case FMT_CONV_INT: {                                                                                 \
+                UINT64 number = 0;                                                                               \
+                switch (length_bits) {                                                                           \
+                    case 8:  number = (UINT8)va_arg(args, int);  if (signed_num) number = (INT8)number;  break;  \
+                    case 16: number = (UINT16)va_arg(args, int); if (signed_num) number = (INT16)number; break;  \
+                    case 64: number = va_arg(args, UINT64);      if (signed_num) number = (INT64)number; break;  \
+                    default: number = va_arg(args, UINT32);      if (signed_num) number = (INT32)number; break;  \
+                }                                                                                                \
+                                                                                                                 \
+                /* Add alternate form prefix e.g. 0x */                                                          \
+                for (const char *p = prefix; *p; p++) PUT_FMT_CHAR(*p);                                          \
+                                                                                                                 \
+                /* Add space before positive number for ' ' flag, '+' flag overrides it */                       \
+                if ((flags & (FMT_FLAG_SPACE | FMT_FLAG_PLUS)) == FMT_FLAG_SPACE &&                              \
+                    signed_num && (INTN)number >= 0)                                                             \
+                    PUT_FMT_CHAR(' ');                                                                           \
+                                                                                                                 \
+                /* Add sign +/- before signed number for '+' flag */                                             \
+                if ((flags & FMT_FLAG_PLUS) && signed_num)                                                       \
+                    PUT_FMT_CHAR((INTN)number >= 0 ? '+' : '-');                                                 \
+                                                                                                                 \
+                add_int_to_buf##SUFFIX(number, spec->base, signed_num, precision, buf, max_len, &buf_idx);       \
+            }                                                                                                    \
+            break;                                                                                               \
+                                                                                                                 \
+            case FMT_CONV_FLOAT: {                                                                               \
+                /* Rounded down to precision decimal places, default 6 */                                        \
+                double number = va_arg(args, double);                                                            \
+                if (!input_precision) precision = 6;                                                             \
+                                                                                                                 \
+                /* Digits before decimal point, with sign even if they are 0 e.g. -0.5 */                        \
+                INTN whole_num = (INTN)number;                                                                   \
+                if (number < 0.0 && whole_num == 0) PUT_FMT_CHAR('-');                                           \
+                add_int_to_buf##SUFFIX(whole_num, 10, signed_num, 0, buf, max_len, &buf_idx);                    \
+                                                                                                                 \
+                /* Print decimal digits equal to precision value, */                                             \
+                /*   if precision is explicitly 0 then do not print */                                           \
+                if (precision != 0) {                                                                            \
+                    PUT_FMT_CHAR('.');                                                                           \
+                                                                                                                 \
+                    /* Move precision # of decimal digits before decimal point */                                \
+                    /*   using base 10, number = number * 10^precision */                                        \
+                    number -= whole_num;                                                                         \
+                    if (number < 0.0) number = -number;                                                          \
+                    for (UINTN i = 0; i < precision; i++)                                                        \
+                        number *= 10;                                                                            \
+                                                                                                                 \
+                    add_int_to_buf##SUFFIX((UINTN)number, 10, false, precision, buf, max_len, &buf_idx);         \
+                }                                                                                                \
+            }                                                                                                    \
+            break;                                                                                               \
+                                                                                                                 \
+            default: {                                                                                           \
+                /* Overwrite output with error message, as much as fits */                                       \
+                char msg[] = "Invalid format specifier: %?\r\n";                                                 \
+                msg[ARRAY_SIZE(msg)-4] = (char)*fmt;                                                             \
+                for (buf_idx = 0; buf_idx < max_len && buf_idx < ARRAY_SIZE(msg)-1; buf_idx++)                   \
+                    buf[buf_idx] = msg[buf_idx];                                                                 \
+                result = false;                                                                                  \
+                goto end;                                                                                        \
+            }                                                                                                    \
+            break;                                                                                               \
+        }                                                                                                        \
+        fmt++;                                                                                                   \
+                                                                                                                 \
+        /* Add padding to minimum field width, relative to the start of this conversion */                       \
+        UINTN conv_len = buf_idx - conv_start;                                                                   \
+        if (min_field_width > conv_len) {                                                                        \
+            UINTN diff = min_field_width - conv_len;                                                             \
+            if (flags & FMT_FLAG_LEFT) {                                                                         \
+                /* Left justify: append padding, always spaces */                                                \
+                while (diff--) PUT_FMT_CHAR(' ');                                                                \
+            } else {                                                                                             \
+                /* Right justify: move conversion right by diff chars, dropping any that */                      \
+                /*   no longer fit e.g. "TEST\0\0" -> "TETEST" */                                                \
+                UINTN end = conv_start + min_field_width;                                                        \
+                if (end > max_len) end = max_len;                                                                \
+                                                                                                                 \
+                /* 0 padding is only for numbers, and is overruled by precision; */                              \
+                /*   0s go after any 0x/0b/0o prefix, spaces before it */                                        \
+                CHAR_T padding_char = ' ';                                                                       \
+                UINTN pad_start = conv_start;                                                                    \
+                if ((flags & FMT_FLAG_ZERO) && precision == 0 &&                                                 \
+                    (spec->conversion == FMT_CONV_INT || spec->conversion == FMT_CONV_FLOAT)) {                  \
+                    padding_char = '0';                                                                          \
+                    for (const char *p = prefix; *p; p++) pad_start++;                                           \
+                }                                                                                                \
+                for (UINTN dst = end; dst > pad_start + diff; dst--) buf[dst-1] = buf[dst-1-diff];               \
+                                                                                                                 \
+                /* Overwrite start of conversion with padding e.g. "TETEST" -> "  TEST" */                       \
+                for (UINTN dst = pad_start; dst < pad_start + diff && dst < end; dst++)                          \
+                    buf[dst] = padding_char;                                                                     \
+                buf_idx = conv_start + min_field_width;                                                          \
+            }                                                                                                    \
+        }                                                                                                        \
+    }                                                                                                            \
+                                                                                                                 \
+    end:                                                                                                         \
+    if (buf_idx > max_len) buf_idx = max_len;   /* Output was truncated */                                       \
+    if (size) buf[buf_idx] = '\0';                                                                               \
+    va_end(args);                                                                                                \
+    return result ? (INTN)buf_idx : -1;                                                                          \
 }
 
+// CHAR16 add_int_to_buf_c16() and format_string_c16()
+DEFINE_FORMAT_FUNCS(CHAR16, _c16)
+
 // ==================================================================================
 // (CHAR16) Print formatted strings to a file stream, using a va_list for arguments
 // ==================================================================================
 bool vfprintf_c16(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, CHAR16 *fmt, va_list args) {
     CHAR16 buf[1024];   // Format string buffer for % strings
-    if (!format_string_c16(buf, fmt, args)) 
+    INTN len = format_string_c16(buf, ARRAY_SIZE(buf), fmt, args);
+    if (len < 0) 
         return false;
     
-    return !EFI_ERROR(stream->OutputString(stream, buf));
+    return write_c16(stream, buf, len);
 }
 
 // ============================================
@@ -1021,399 +2088,78 @@ bool printf_c16(CHAR16 *fmt, ...) {
 
 // ===================================================
 // (CHAR16) Print formatted strings to a file stream
-// ===================================================
-bool fprintf_c16(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, CHAR16 *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    return vfprintf_c16(stream, fmt, args);
-}
-
-// ==============================================
-// (CHAR16) Print formatted strings to a string
-// ==============================================
-bool sprintf_c16(CHAR16 *s, CHAR16 *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    return format_string_c16(s, fmt, args);
-}
-
-// ==========================================
-// (ASCII) Add integer as string to buffer
-// ==========================================
-BOOLEAN
-add_int_to_buf(UINTN number, UINT8 base, BOOLEAN signed_num, UINTN min_digits, char *buf, 
-               UINTN *buf_idx) {
-    const char *digits = "0123456789ABCDEF";
-    char buffer[24];  // Hopefully enough for UINTN_MAX (UINT64_MAX) + sign character
-    UINTN i = 0;
-    BOOLEAN negative = FALSE;
-
-    if (base > 16) {
-        cerr->OutputString(cerr, u"Invalid base specified!\r\n");
-        return FALSE;    // Invalid base
-    }
-
-    // Only use and print negative numbers if decimal and signed True
-    if (base == 10 && signed_num && (INTN)number < 0) {
-       number = -(INTN)number;  // Get absolute value of correct signed value to get digits to print
-       negative = TRUE;
-    }
-
-    do {
-       buffer[i++] = digits[number % base];
-       number /= base;
-    } while (number > 0);
-
-    while (i < min_digits) buffer[i++] = u'0'; // Pad with 0s
-
-    // Add negative sign for decimal numbers
-    if (base == 10 && negative) buffer[i++] = u'-';
-
-    // NULL terminate string
-    buffer[i--] = u'\0';
-
-    // Reverse buffer to read left to right
-    strrev(buffer);
-
-    // Add number string to input buffer for printing
-    for (char *p = buffer; *p; p++) {
-        buf[*buf_idx] = *p;
-        *buf_idx += 1;
-    }
-    return TRUE;
-}
-
-// ========================================================================
-// (ASCII) Fill formatted string buffer with printf() format conversions
-// ========================================================================
-bool format_string(char *buf, char *fmt, va_list args) {
-    bool result = true;
-    char charstr[2] = {0};    
-    UINTN buf_idx = 0;
-
-    for (UINTN i = 0; fmt[i] != u'\0'; i++) {
-        if (fmt[i] == u'%') {
-            bool alternate_form = false;
-            UINTN min_field_width = 0;
-            UINTN precision = 0;
-            UINTN length_bits = 0;  
-            UINTN num_printed = 0;      // # of digits/chars printed for numbers or strings
-            UINT8 base = 0;
-            bool input_precision = false;
-            bool signed_num   = false;
-            bool int_num      = false;
-            bool double_num   = false;
-            bool left_justify = false;  // Left justify text from '-' flag instead of default right justify
-            bool space_flag   = false;
-            bool plus_flag    = false;
-            char padding_char = ' ';  // '0' or ' ' depending on flags
-            i++;
-
-            // Check for flags
-            while (true) {
-                switch (fmt[i]) {
-                    case u'#':
-                        // Alternate form
-                        alternate_form = true;
-                        i++;
-                        continue;
-
-                    case u'0':
-                        // 0-pad numbers on the left, unless '-' or precision is also defined
-                        padding_char = '0'; 
-                        i++;
-                        continue;
-
-                    case u' ':
-                        // Print a space before positive signed number conversion or empty string
-                        //   number conversions
-                        space_flag = true;
-                        if (plus_flag) space_flag = false;  // Plus flag '+' overrides space flag
-                        i++;
-                        continue;
-
-                    case u'+':
-                        // Always print +/- before a signed number conversion
-                        plus_flag = true;
-                        if (space_flag) space_flag = false; // Plus flag '+' overrides space flag
-                        i++;
-                        continue;
-
-                    case u'-':
-                        left_justify = true;
-                        i++;
-                        continue;
-
-                    default:
-                        break;
-                }
-                break; // No more flags
-            }
-
-            // Check for minimum field width e.g. in "8.2" this would be 8
-            if (fmt[i] == u'*') {
-                // Get int argument for min field width
-                min_field_width = va_arg(args, int);
-                i++;
-            } else {
-                // Get number literal from format string
-                while (isdigit_c16(fmt[i])) 
-                    min_field_width = (min_field_width * 10) + (fmt[i++] - u'0');
-            }
-
-            // Check for precision/maximum field width e.g. in "8.2" this would be 2
-            if (fmt[i] == u'.') {
-                input_precision = true; 
-                i++;
-                if (fmt[i] == u'*') {
-                    // Get int argument for precision
-                    precision = va_arg(args, int);
-                    i++;
-                } else {
-                    // Get number literal from format string
-                    while (isdigit_c16(fmt[i])) 
-                        precision = (precision * 10) + (fmt[i++] - u'0');
-                }
-            }
-
-            // Check for Length modifiers e.g. h/hh/l/ll
-            if (fmt[i] == u'h') {
-                i++;
-                length_bits = 16;       // h
-                if (fmt[i] == u'h') {
-                    i++;
-                    length_bits = 8;    // hh
-                }
-            } else if (fmt[i] == u'l') {
-                i++;
-                length_bits = 32;       // l
-                if (fmt[i] == u'l') {
-                    i++;
-                    length_bits = 64;    // ll
-                }
-            }
-
-            // Check for conversion specifier
-            switch (fmt[i]) {
-                case u'c': {
-                    // Print char value; printf("%c", char)
-                    charstr[0] = (char)va_arg(args, int);   // %hhc "ascii" or other 8 bit char
-
-                    // Only add non-null characters, to not end string early
-                    if (charstr[0]) buf[buf_idx++] = charstr[0];    
-                }
-                break;
-
-                case u's': {
-                    // Print string; printf("%s", string)
-                    if (length_bits == 8) {
-                        char *string = va_arg(args, char*);         // %hhs; Assuming 8 bit ascii chars
-                        while (*string) {
-                            buf[buf_idx++] = *string++;
-                            if (++num_printed == precision) break;  // Stop printing at max characters
-                        }
-
-                    } else {
-                        char *string = va_arg(args, char*);     // Assuming 16 bit char16_t
-                        while (*string) {
-                            buf[buf_idx++] = *string++;
-                            if (++num_printed == precision) break;  // Stop printing at max characters
-                        }
-                    }
-                }
-                break;
-
-                case u'd': {
-                    // Print INT32; printf("%d", number_int32)
-                    int_num = true;
-                    base = 10;
-                    signed_num = true;
-                }
-                break;
-
-                case u'x': {
-                    // Print hex UINTN; printf("%x", number_uintn)
-                    int_num = true;
-                    base = 16;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'x';
-                    }
-                }
-                break;
-
-                case u'u': {
-                    // Print UINT32; printf("%u", number_uint32)
-                    int_num = true;
-                    base = 10;
-                    signed_num = false;
-                }
-                break;
-
-                case u'b': {
-                    // Print UINTN as binary; printf("%b", number_uintn)
-                    int_num = true;
-                    base = 2;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'b';
-                    }
-                }
-                break;
-
-                case u'o': {
-                    // Print UINTN as octal; printf("%o", number_uintn)
-                    int_num = true;
-                    base = 8;
-                    signed_num = false;
-                    if (alternate_form) {
-                        buf[buf_idx++] = u'0';
-                        buf[buf_idx++] = u'o';
-                    }
-                }
-                break;
-
-                case u'f': {
-                    // Print INTN rounded float value
-                    double_num = true;
-                    signed_num = true;
-                    base = 10;
-                    if (!input_precision) precision = 6;    // Default decimal places to print
-                }
-                break;
-
-                default:
-                    strcpy(buf, "Invalid format specifier: %");
-                    charstr[0] = fmt[i];
-                    strcat(buf, charstr);
-                    strcat(buf, "\r\n");
-                    result = false;
-                    goto end;
-                    break;
-            }
-
-            if (int_num) {
-                // Number conversion: Integer
-                UINT64 number = 0;
-                switch (length_bits) {
-                    case 0:
-                    case 32: 
-                    default:
-                        // l
-                        number = va_arg(args, UINT32);
-                        if (signed_num) number = (INT32)number;
-                        break;
-
-                    case 8:
-                        // hh
-                        number = (UINT8)va_arg(args, int);
-                        if (signed_num) number = (INT8)number;
-                        break;
-
-                    case 16:
-                        // h
-                        number = (UINT16)va_arg(args, int);
-                        if (signed_num) number = (INT16)number;
-                        break;
-
-                    case 64:
-                        // ll
-                        number = va_arg(args, UINT64);
-                        if (signed_num) number = (INT64)number;
-                        break;
-                }
-
-                // Add space before positive number for ' ' flag
-                if (space_flag && signed_num && (INTN)number >= 0) buf[buf_idx++] = u' ';    
-
-                // Add sign +/- before signed number for '+' flag
-                if (plus_flag && signed_num) buf[buf_idx++] = (INTN)number >= 0 ? u'+' : u'-';
-
-                add_int_to_buf(number, base, signed_num, precision, buf, &buf_idx);
-            }
-
-            if (double_num) {
-                // Number conversion: Float/Double
-                double number = va_arg(args, double);
-                UINTN whole_num = 0;
-
-                // Get digits before decimal point
-                whole_num = (UINTN)number;
-                UINTN num_digits = 0;
-                do {
-                   num_digits++; 
-                   whole_num /= 10;
-                } while (whole_num > 0);
-
-                // Add digits to write buffer
-                add_int_to_buf(number, base, signed_num, num_digits, buf, &buf_idx);
-
-                // Print decimal digits equal to precision value, 
-                //   if precision is explicitly 0 then do not print
-                if (!input_precision || precision != 0) {
-                    buf[buf_idx++] = u'.';      // Add decimal point
-
-                    whole_num = (UINTN)number;          // Get only digits before decimal
-                    if (number < 0.0) number = -number; // Ensure number is positive
-                    signed_num = FALSE;                 // Don't print negative decimal digits
-
-                    number -= whole_num;                // Get only decimal digits
+// ===================================================
+bool fprintf_c16(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *stream, CHAR16 *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    return vfprintf_c16(stream, fmt, args);
+}
 
-                    // Move precision # of decimal digits before decimal point 
-                    //   using base 10, number = number * 10^precision
-                    for (UINTN i = 0; i < precision; i++)
-                        number *= 10;
+// ==================================================================
+// (CHAR16) Print formatted strings to a string
+//   No size limit; prefer snprintf_c16() when the buffer size is known
+// ==================================================================
+bool sprintf_c16(CHAR16 *s, CHAR16 *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    return format_string_c16(s, UINT64_MAX, fmt, args) >= 0;
+}
 
-                    whole_num = (UINTN)number;  // Get only digits before decimal
+// ===========================================================================
+// (CHAR16) Print formatted strings to a string of size CHAR16s, using a 
+//   va_list for arguments. Output is truncated to fit and always NULL 
+//   terminated if size > 0.
+// Returns # of CHAR16s written not including NULL terminator, 
+//   or -1 for an invalid format specifier
+// ===========================================================================
+INTN vsnprintf_c16(CHAR16 *s, UINTN size, CHAR16 *fmt, va_list args) {
+    return format_string_c16(s, size, fmt, args);
+}
 
-                    // Add digits to write buffer
-                    add_int_to_buf(number, base, signed_num, precision, buf, &buf_idx);
-                }
-            }
+// ===========================================================================
+// (CHAR16) Print formatted strings to a string of size CHAR16s
+// Returns # of CHAR16s written not including NULL terminator, 
+//   or -1 for an invalid format specifier
+// ===========================================================================
+INTN snprintf_c16(CHAR16 *s, UINTN size, CHAR16 *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    return format_string_c16(s, size, fmt, args);
+}
 
-            // Flags are defined such that 0 is overruled by left justify and precision
-            if (padding_char == u'0' && (left_justify || precision > 0))
-                padding_char = u' ';
-
-            // Add padding depending on flags (0 or space) and left/right justify
-            INTN diff = min_field_width - buf_idx;
-            if (diff > 0) {
-                if (left_justify) {
-                    // Append padding to minimum width, always spaces
-                    while (diff--) buf[buf_idx++] = u' ';   
-                } else {
-                    // Right justify
-                    // Copy buffer to end of buffer
-                    INTN dst = min_field_width-1, src = buf_idx-1;
-                    while (src >= 0)  buf[dst--] = buf[src--];  // e.g. "TEST\0\0" -> "TETEST"
-
-                    // Overwrite beginning of buffer with padding
-                    dst = (int_num && alternate_form) ? 2 : 0;  // Skip 0x/0b/0o/... prefix
-                    while (diff--) buf[dst++] = padding_char;   // e.g. "TETEST" -> "  TEST"
-                }
-            }
+// ASCII add_int_to_buf() and format_string()
+DEFINE_FORMAT_FUNCS(char, )
 
-        } else {
-            // Not formatted string, print next character
-            buf[buf_idx++] = fmt[i];
-        }
-    }
+// ===============================================================
+// (ASCII) Print formatted strings to a string
+//   No size limit; prefer snprintf() when the buffer size is known
+// ===============================================================
+bool sprintf(char *s, char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    return format_string(s, UINT64_MAX, fmt, args) >= 0;
+}
 
-    end:
-    buf[buf_idx] = u'\0'; 
-    va_end(args);
-    return result;
+// ==========================================================================
+// (ASCII) Print formatted strings to a string of size chars, using a 
+//   va_list for arguments. Output is truncated to fit and always NULL 
+//   terminated if size > 0.
+// Returns # of chars written not including NULL terminator, 
+//   or -1 for an invalid format specifier
+// ==========================================================================
+INTN vsnprintf(char *s, UINTN size, char *fmt, va_list args) {
+    return format_string(s, size, fmt, args);
 }
 
-// =============================================
-// (ASCII) Print formatted strings to a string
-// =============================================
-bool sprintf(char *s, char *fmt, ...) {
+// ==========================================================================
+// (ASCII) Print formatted strings to a string of size chars
+// Returns # of chars written not including NULL terminator, 
+//   or -1 for an invalid format specifier
+// ==========================================================================
+INTN snprintf(char *s, UINTN size, char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    return format_string(s, fmt, args);
+    return format_string(s, size, fmt, args);
 }
 
 // =======================================================================
@@ -1480,6 +2226,24 @@ BOOLEAN get_num(UINTN *number, UINT8 base) {
     return true;
 }
 
+// ===================================================================
+// Get Y/N answer from user, shown at the same position, until enter
+//   or escape is pressed
+// Returns: true if the last key pressed was Y, else false
+// ===================================================================
+bool get_yes_no(void) {
+    bool yes = false, no = false;
+    EFI_INPUT_KEY key = get_key();
+    while (key.UnicodeChar != u'\r' && key.ScanCode != SCANCODE_ESC) {
+        yes = (key.UnicodeChar == 'Y' || key.UnicodeChar == 'y');
+        no  = (key.UnicodeChar == 'N' || key.UnicodeChar == 'n');
+        if (yes || no) printf_c16(u"\b%c", key.UnicodeChar);    // Overwrite character at same position
+        key = get_key();
+    }
+    printf_c16(u"\r\n");
+    return yes;
+}
+
 // ====================
 // Print a GUID value
 // ====================
@@ -1515,6 +2279,57 @@ void print_acpi_table_header(ACPI_TABLE_HEADER header) {
            (UINTN)header.creator_revision);
 }
 
+// ===================================================================
+// Get memory bounds of all loadable program headers in an ELF file,
+//   aligned to the largest program header alignment.
+//
+// Returns: # of bytes of memory needed to load the ELF program, and
+//   lowest aligned virtual address in mem_min
+// ===================================================================
+UINTN elf_memory_bounds(ELF_Header_64 *ehdr, UINTN *mem_min) {
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
+
+    UINTN max_alignment = PAGE_SIZE;    
+    UINTN lowest = UINT64_MAX, highest = 0;
+
+    for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
+        // Only interested in loadable program headers
+        if (phdr->p_type != PT_LOAD) continue;
+
+        // Update max alignment as needed
+        if (max_alignment < phdr->p_align) max_alignment = phdr->p_align;
+
+        UINTN hdr_begin = phdr->p_vaddr;        
+        UINTN hdr_end   = phdr->p_vaddr + phdr->p_memsz + max_alignment-1;
+
+        // Limit memory range to aligned values
+        //   e.g. 4096-1 = 4095 or 0x00000FFF (32 bit); ~4095 = 0xFFFFF000
+        hdr_begin &= ~(max_alignment-1);    
+        hdr_end   &= ~(max_alignment-1);   
+
+        // Get new minimum & maximum memory bounds for all program sections
+        if (hdr_begin < lowest)  lowest  = hdr_begin;
+        if (hdr_end   > highest) highest = hdr_end;
+    }
+
+    *mem_min = lowest;
+    return highest - lowest;
+}
+
+// ===================================================================
+// Check that no loadable program header has more file data than memory,
+//   so its p_memsz - p_filesz (.bss) tail can not wrap around.
+//
+// Returns: true if all loadable program headers can be loaded
+// ===================================================================
+bool elf_segments_valid(ELF_Header_64 *ehdr) {
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
+
+    for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) 
+        if (phdr->p_type == PT_LOAD && phdr->p_filesz > phdr->p_memsz) return false;
+    return true;
+}
+
 // ===================================================================
 // Print information for an ELF file
 // NOTE: Assumes file is ELF64 PIE (Position Independent Executable)
@@ -1533,8 +2348,6 @@ void print_elf_info(VOID *elf_buffer) {
     ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
     printf_c16(u"\r\nLoadable Program Headers:\r\n");
 
-    UINTN max_alignment = PAGE_SIZE;    
-    UINTN mem_min = UINT64_MAX, mem_max = 0;
     for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
         // Only interested in loadable program headers
         if (phdr->p_type != PT_LOAD) continue;
@@ -1544,29 +2357,15 @@ void print_elf_info(VOID *elf_buffer) {
                (UINTN)i, phdr->p_offset, phdr->p_vaddr, phdr->p_paddr,
                phdr->p_filesz, phdr->p_memsz, phdr->p_align);
 
-        // Update max alignment as needed
-        if (max_alignment < phdr->p_align) max_alignment = phdr->p_align;
-
-        UINTN hdr_begin = phdr->p_vaddr;        
-        UINTN hdr_end   = phdr->p_vaddr + phdr->p_memsz + max_alignment-1;
-
-        // Limit memory range to aligned values
-        //   e.g. 4096-1 = 4095 or 0x00000FFF (32 bit); ~4095 = 0xFFFFF000
-        hdr_begin &= ~(max_alignment-1);    
-        hdr_end   &= ~(max_alignment-1);   
-
-        // Get new minimum & maximum memory bounds for all program sections
-        if (hdr_begin < mem_min) mem_min = hdr_begin;
-        if (hdr_end   > mem_max) mem_max = hdr_end;
-
-        if (cout->Mode->CursorRow >= text_rows-2) {
+        if (cursor_row(cout) >= text_rows-2) {
             printf_c16(u"\r\nPress any key to continue...\r\n");
             get_key();
-            cout->ClearScreen(cout);
+            clear_screen(cout);
         }
     }
 
-    UINTN max_memory_needed = mem_max - mem_min;   
+    UINTN mem_min = 0;
+    UINTN max_memory_needed = elf_memory_bounds(ehdr, &mem_min);
     printf_c16(u"\r\nMemory needed for file: %#llx bytes\r\n", max_memory_needed);
 }
 
@@ -1622,20 +2421,24 @@ void print_pe_info(VOID *pe_buffer) {
                shdr->VirtualSize, shdr->VirtualAddress, 
                shdr->SizeOfRawData, shdr->PointerToRawData);
 
-        if (cout->Mode->CursorRow >= text_rows-2) {
+        if (cursor_row(cout) >= text_rows-2) {
             printf_c16(u"\r\nPress any key to continue...\r\n");
             get_key();
-            cout->ClearScreen(cout);
+            clear_screen(cout);
         }
     }
 }
 
 // ============================================================================
 // Get EFI_FILE_PROTOCOL* to root directory '/' of EFI System Partition (ESP)
-// NOTE: Caller must close open root directory pointer with 
-//   e.g. "root->Close(root);"
+//   The root directory is opened on the first call and cached for the rest
+//   of the application, so later calls do no protocol lookups.
+// NOTE: Caller must NOT close the returned root directory pointer; 
+//   use close_esp_root_dir() before ExitBootServices() instead.
 // ============================================================================
 EFI_FILE_PROTOCOL *esp_root_dir(VOID) {
+    if (esp_root) return esp_root;
+
     EFI_FILE_PROTOCOL *root = NULL;
     EFI_LOADED_IMAGE_PROTOCOL *lip = NULL;
     EFI_GUID lip_guid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
@@ -1667,84 +2470,439 @@ EFI_FILE_PROTOCOL *esp_root_dir(VOID) {
         goto done;
     }
 
-    // Open root directory via OpenVolume()
-    status = sfsp->OpenVolume(sfsp, &root);
-    if (EFI_ERROR(status)) 
-        error(status, u"Could not Open Volume for root directory\r\n");
+    // Open root directory via OpenVolume()
+    status = sfsp->OpenVolume(sfsp, &root);
+    if (EFI_ERROR(status)) 
+        error(status, u"Could not Open Volume for root directory\r\n");
+
+    done:
+    esp_root = root;
+    return root;
+}
+
+// ===================================================================
+// Close cached ESP root directory from esp_root_dir(), if open.
+//   Must be called before ExitBootServices(); a later esp_root_dir()
+//   call will reopen it.
+// ===================================================================
+VOID close_esp_root_dir(VOID) {
+    if (!esp_root) return;
+    esp_root->Close(esp_root);
+    esp_root = NULL;
+}
+
+// ===================================================================
+// Read a fully qualified file path in the EFI System Partition into 
+//   an output buffer. File path must start with root '\',
+//   escaped as needed by the caller with '\\'.
+//
+// Returns: 
+//  - non-null pointer to allocated buffer with file data, 
+//      allocated with Boot Services AllocatePool(), or NULL if not 
+//      found (silently) or error (with an error message).
+//  - Size of returned buffer, if not NULL
+//
+//  NOTE: Caller will have to use FreePool() on returned buffer to 
+//    free allocated memory.
+// ===================================================================
+VOID *read_esp_file_to_buffer(CHAR16 *path, UINTN *file_size) {
+    VOID *file_buffer = NULL;
+    EFI_FILE_PROTOCOL *root = NULL, *file = NULL;
+    EFI_STATUS status;
+
+    *file_size = 0;
+
+    root = esp_root_dir();
+    if (!root) {
+        error(0, u"Could not get root directory of ESP.\r\n");
+        goto cleanup;
+    }
+
+    // Open file in input path (qualified from root directory)
+    status = root->Open(root, &file, path, EFI_FILE_MODE_READ, 0);
+    if (status == EFI_NOT_FOUND) goto cleanup;  // Optional files are not an error; callers check NULL
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not open file '%s'\r\n", path);
+        goto cleanup;
+    }
+
+    // Get info for file, to grab file size
+    EFI_FILE_INFO file_info;
+    EFI_GUID fi_guid = EFI_FILE_INFO_ID;
+    UINTN buf_size = sizeof(EFI_FILE_INFO);
+    status = file->GetInfo(file, &fi_guid, &buf_size, &file_info);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not get file info for file '%s'\r\n", path);
+        goto cleanup;
+    }
+
+    // Allocate buffer for file
+    buf_size = file_info.FileSize;
+    status = bs->AllocatePool(EfiLoaderData, buf_size, &file_buffer);
+    if (EFI_ERROR(status) || buf_size != file_info.FileSize) {
+        error(status, u"Could not allocate memory for file '%s'\r\n", path);
+        goto cleanup;
+    }
+
+    // Read file into buffer
+    status = file->Read(file, &buf_size, file_buffer);
+    if (EFI_ERROR(status) || buf_size != file_info.FileSize) {
+        error(status, u"Could not read file '%s' into buffer\r\n", path);
+        goto cleanup;
+    }
+
+    // Set output file size in buffer
+    *file_size = buf_size;
+
+    cleanup:
+    // Close open file pointer; root directory stays open for later reads
+    if (file) file->Close(file);
+
+    // Will return buffer with file data or NULL on errors
+    return file_buffer; 
+}
+
+// ===================================================================
+// Build table of all Block IO handles grouped by media ID, with the
+//   whole disk Block IO & Disk IO protocols and media geometry for
+//   each disk, and which disk this running disk image is on.
+//   Only scans handles on the first call; use free_disk_table() to
+//   force a rescan, e.g. after connecting controllers.
+//
+// Returns: EFI_SUCCESS if table was built or already built
+// ===================================================================
+EFI_STATUS build_disk_table(VOID) {
+    if (disk_table.built) return EFI_SUCCESS;
+
+    EFI_STATUS status = EFI_SUCCESS;
+    EFI_GUID bio_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
+    EFI_GUID dio_guid = EFI_DISK_IO_PROTOCOL_GUID;
+    EFI_GUID bio2_guid = EFI_BLOCK_IO2_PROTOCOL_GUID;
+    EFI_GUID dio2_guid = EFI_DISK_IO2_PROTOCOL_GUID;
+    EFI_GUID lip_guid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
+    UINTN num_handles = 0;
+    EFI_HANDLE *handle_buffer = NULL;
+
+    status = bs->LocateHandleBuffer(ByProtocol, &bio_guid, NULL, &num_handles, &handle_buffer);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not locate any Block IO Protocols.\r\n");
+        goto done;
+    }
+
+    // Worst case is 1 disk per handle; allocate disks & devices in 1 buffer
+    VOID *table_buffer = NULL;
+    status = bs->AllocatePool(EfiLoaderData, 
+                              num_handles * (sizeof(Disk_Info) + sizeof(Block_Device)),
+                              &table_buffer);
+    if (EFI_ERROR(status)) {
+        error(status, u"Could not allocate memory for disk table.\r\n");
+        goto done;
+    }
+
+    Disk_Info *disks = table_buffer;
+    Block_Device *devices = (Block_Device *)(disks + num_handles);
+    UINTN num_devices = 0, num_disks = 0;
+
+    // Open Block IO on every handle once
+    for (UINTN i = 0; i < num_handles; i++) {
+        EFI_BLOCK_IO_PROTOCOL *biop = NULL;
+        status = bs->OpenProtocol(handle_buffer[i], 
+                                  &bio_guid,
+                                  (VOID **)&biop,
+                                  image,
+                                  NULL,
+                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+        if (EFI_ERROR(status)) {
+            fprintf_c16(cerr, u"Could not Open Block IO protocol on handle %u.\r\n", i);
+            continue;
+        }
+
+        // Insertion sort by media ID, stable so firmware handle order is kept per disk
+        UINTN j = num_devices++;
+        for (; j > 0 && devices[j-1].biop->Media->MediaId > biop->Media->MediaId; j--)
+            devices[j] = devices[j-1];
+        devices[j] = (Block_Device){ .handle = handle_buffer[i], .biop = biop };
+    }
+
+    // Group devices into disks by media ID
+    Disk_Info *disk = NULL;
+    for (UINTN i = 0; i < num_devices; i++) {
+        EFI_BLOCK_IO_MEDIA *media = devices[i].biop->Media;
+
+        if (!disk || disk->media_id != media->MediaId) {
+            disk = &disks[num_disks++];
+            *disk = (Disk_Info){ .media_id = media->MediaId, .devices = &devices[i] };
+        }
+        disk->num_devices++;
+
+        // NOTE: This assumes the first Block IO found with logical partition false is the entire disk
+        if (disk->biop || media->LogicalPartition) continue;
+
+        disk->handle                  = devices[i].handle;
+        disk->biop                    = devices[i].biop;
+        disk->block_size              = media->BlockSize;
+        disk->io_align                = media->IoAlign;
+        disk->last_block              = media->LastBlock;
+
+        // Older Block IO media structs end before this field; 0 = no optimal transfer length
+        disk->optimal_transfer_blocks = disk->biop->Revision >= EFI_BLOCK_IO_PROTOCOL_REVISION3 ? 
+                                        media->OptimalTransferLengthGranularity : 0;
+
+        // Get Disk IO Protocol on same handle as whole disk Block IO protocol
+        status = bs->OpenProtocol(disk->handle, 
+                                  &dio_guid,
+                                  (VOID **)&disk->diop,
+                                  image,
+                                  NULL,
+                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+        if (EFI_ERROR(status)) disk->diop = NULL;
+
+        // Get async Block IO 2 & Disk IO 2 protocols if supported, else use sync protocols
+        if (EFI_ERROR(bs->OpenProtocol(disk->handle, &bio2_guid, (VOID **)&disk->biop2, image, NULL,
+                                       EFI_OPEN_PROTOCOL_GET_PROTOCOL)))
+            disk->biop2 = NULL;
+
+        if (EFI_ERROR(bs->OpenProtocol(disk->handle, &dio2_guid, (VOID **)&disk->diop2, image, NULL,
+                                       EFI_OPEN_PROTOCOL_GET_PROTOCOL)))
+            disk->diop2 = NULL;
+    }
+
+    disk_table = (Disk_Table){
+        .disks       = disks,
+        .num_disks   = num_disks,
+        .devices     = devices,
+        .num_devices = num_devices,
+        .built       = true,
+    };
+    status = EFI_SUCCESS;
+
+    // Find disk for this running disk image, from the loaded image's device handle
+    EFI_LOADED_IMAGE_PROTOCOL *lip = NULL;
+    EFI_BLOCK_IO_PROTOCOL *image_biop = NULL;
+    if (!EFI_ERROR(bs->OpenProtocol(image, &lip_guid, (VOID **)&lip, image, NULL, 
+                                    EFI_OPEN_PROTOCOL_GET_PROTOCOL)) &&
+        !EFI_ERROR(bs->OpenProtocol(lip->DeviceHandle, &bio_guid, (VOID **)&image_biop, image, NULL,
+                                    EFI_OPEN_PROTOCOL_GET_PROTOCOL))) {
+        for (UINTN i = 0; i < num_disks; i++) {
+            if (disks[i].media_id == image_biop->Media->MediaId) {
+                disk_table.image_disk = &disks[i];
+                break;
+            }
+        }
+    }
+
+    done:
+    if (handle_buffer) bs->FreePool(handle_buffer);   // Free allocated handle buffer
+    return status;
+}
+
+// ===================================================================
+// Free disk table from build_disk_table(), if built. The next disk
+//   lookup will rebuild it.
+// ===================================================================
+VOID free_disk_table(VOID) {
+    if (disk_table.disks) bs->FreePool(disk_table.disks);
+    disk_table = (Disk_Table){0};
+}
+
+// ===================================================================
+// Find disk info for a given Block IO media ID, building the disk 
+//   table first if needed.
+//
+// Returns: Pointer to disk info in disk table, or NULL if not found
+// ===================================================================
+Disk_Info *find_disk(UINT32 media_id) {
+    if (EFI_ERROR(build_disk_table())) return NULL;
+
+    for (UINTN i = 0; i < disk_table.num_disks; i++) 
+        if (disk_table.disks[i].media_id == media_id) return &disk_table.disks[i];
+
+    return NULL;
+}
+
+// ===================================================================
+// Wait for a queued disk read to finish, if in flight
+// ===================================================================
+VOID disk_read_queue_finish(Disk_Read_Queue *queue, UINTN i) {
+    if (!queue->busy[i]) return;
+
+    UINTN index = 0;
+    EFI_STATUS status = bs->WaitForEvent(1, &queue->tokens[i].Event, &index);
+    if (!EFI_ERROR(status)) status = queue->tokens[i].TransactionStatus;
+    if (EFI_ERROR(status) && !EFI_ERROR(queue->status)) queue->status = status;
+
+    queue->busy[i] = false;
+}
+
+// ===================================================================
+// Sync read of size bytes at a byte offset on a disk into buffer.
+//   Whole blocks are read with Block IO ReadBlocks() straight into 
+//   the buffer, in chunks that are a multiple of the media's optimal
+//   transfer length granularity, if the buffer meets the media's 
+//   IoAlign requirement there. Only the partial head & tail blocks,
+//   or unaligned buffers, use Disk IO, which may bounce buffer in 
+//   firmware.
+//
+// Returns: EFI_SUCCESS or error status
+// ===================================================================
+EFI_STATUS disk_read_blocks(Disk_Info *disk, UINT64 offset, UINTN size, VOID *buffer) {
+    EFI_STATUS status = EFI_SUCCESS;
+    UINTN block_size = disk->block_size;
+    UINTN io_align = disk->io_align > 1 ? disk->io_align : 1;   // 0 or 1 = any alignment
+
+    // Whole blocks in [offset, offset+size), and where they go in the buffer
+    UINT64 first_lba = 0, end_lba = 0;
+    UINT8 *body = NULL;
+    if (disk->biop && block_size > 0) {
+        first_lba = (offset + (block_size-1)) / block_size;
+        end_lba   = (offset + size) / block_size;
+        body      = (UINT8 *)buffer + (first_lba * block_size - offset);
+    }
+
+    if (first_lba >= end_lba || ((UINTN)body & (io_align-1))) {
+        if (!disk->diop) return EFI_UNSUPPORTED;
+        return disk->diop->ReadDisk(disk->diop, disk->media_id, offset, size, buffer);
+    }
+
+    // Partial block at head & tail with Disk IO
+    UINTN head = first_lba * block_size - offset;
+    UINTN tail = (offset + size) - end_lba * block_size;
+    if ((head || tail) && !disk->diop) return EFI_UNSUPPORTED;
 
-    done:
-    return root;
+    if (head) {
+        status = disk->diop->ReadDisk(disk->diop, disk->media_id, offset, head, buffer);
+        if (EFI_ERROR(status)) return status;
+    }
+
+    if (tail) {
+        status = disk->diop->ReadDisk(disk->diop, disk->media_id, end_lba * block_size, tail, 
+                                      body + (end_lba - first_lba) * block_size);
+        if (EFI_ERROR(status)) return status;
+    }
+
+    // Whole blocks with Block IO, in multiples of the optimal transfer length if given
+    UINTN chunk_blocks = max(DISK_READ_CHUNK_SIZE / block_size, 1);
+    UINTN granularity  = disk->optimal_transfer_blocks;
+    if (granularity > 0) chunk_blocks = max(chunk_blocks / granularity, 1) * granularity;
+
+    for (UINT64 lba = first_lba; lba < end_lba; lba += chunk_blocks) {
+        UINTN blocks = min(chunk_blocks, end_lba - lba);
+        status = disk->biop->ReadBlocks(disk->biop, disk->media_id, lba, blocks * block_size, 
+                                        body + (lba - first_lba) * block_size);
+        if (EFI_ERROR(status)) return status;
+    }
+
+    return status;
 }
 
 // ===================================================================
-// Read a fully qualified file path in the EFI System Partition into 
-//   an output buffer. File path must start with root '\',
-//   escaped as needed by the caller with '\\'.
-//
-// Returns: 
-//  - non-null pointer to allocated buffer with file data, 
-//      allocated with Boot Services AllocatePool(), or NULL if not 
-//      found or error.
-//  - Size of returned buffer, if not NULL
+// Read size bytes at a byte offset on a disk into buffer. If built 
+//   with DISK_READ_ASYNC, the disk has Disk IO 2 and a queue is given,
+//   the read is queued in chunks and returns without waiting for it 
+//   to finish, waiting only for the oldest read if the queue is full.
+//   Otherwise this is a sync read with disk_read_blocks().
 //
-//  NOTE: Caller will have to use FreePool() on returned buffer to 
-//    free allocated memory.
+// Returns: EFI_SUCCESS or error status from starting the read(s).
+//   Errors from async reads are returned by disk_read_queue_wait()
 // ===================================================================
-VOID *read_esp_file_to_buffer(CHAR16 *path, UINTN *file_size) {
-    VOID *file_buffer = NULL;
-    EFI_FILE_PROTOCOL *root = NULL, *file = NULL;
-    EFI_STATUS status;
+EFI_STATUS disk_read(Disk_Info *disk, UINT64 offset, UINTN size, VOID *buffer, Disk_Read_Queue *queue) {
+    EFI_STATUS status = EFI_SUCCESS;
 
-    *file_size = 0;
+    if (!DISK_READ_ASYNC || !queue || !disk->diop2) {
+        if (disk->biop || disk->diop) return disk_read_blocks(disk, offset, size, buffer);
 
-    root = esp_root_dir();
-    if (!root) {
-        error(0, u"Could not get root directory of ESP.\r\n");
-        goto cleanup;
+        // NULL token is a sync read
+        if (disk->diop2) return disk->diop2->ReadDiskEx(disk->diop2, disk->media_id, offset, NULL, size, buffer);
+        return EFI_NOT_FOUND;
     }
 
-    // Open file in input path (qualified from root directory)
-    status = root->Open(root, &file, path, EFI_FILE_MODE_READ, 0);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not open file '%s'\r\n", path);
-        goto cleanup;
-    }
+    while (size > 0) {
+        UINTN chunk = min(size, DISK_READ_CHUNK_SIZE);
+        UINTN i = queue->next;
+        queue->next = (queue->next + 1) % DISK_READ_QUEUE_LEN;
 
-    // Get info for file, to grab file size
-    EFI_FILE_INFO file_info;
-    EFI_GUID fi_guid = EFI_FILE_INFO_ID;
-    UINTN buf_size = sizeof(EFI_FILE_INFO);
-    status = file->GetInfo(file, &fi_guid, &buf_size, &file_info);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not get file info for file '%s'\r\n", path);
-        goto cleanup;
+        disk_read_queue_finish(queue, i);   // Queue full, wait for oldest read
+
+        EFI_DISK_IO2_TOKEN *token = &queue->tokens[i];
+        if (!token->Event) {
+            status = bs->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &token->Event);
+            if (EFI_ERROR(status)) {
+                token->Event = NULL;
+                return status;
+            }
+        }
+
+        token->TransactionStatus = EFI_SUCCESS;
+        status = disk->diop2->ReadDiskEx(disk->diop2, disk->media_id, offset, token, chunk, buffer);
+        if (EFI_ERROR(status)) return status;
+        queue->busy[i] = true;
+
+        offset += chunk;
+        buffer = (UINT8 *)buffer + chunk;
+        size   -= chunk;
     }
 
-    // Allocate buffer for file
-    buf_size = file_info.FileSize;
-    status = bs->AllocatePool(EfiLoaderData, buf_size, &file_buffer);
-    if (EFI_ERROR(status) || buf_size != file_info.FileSize) {
-        error(status, u"Could not allocate memory for file '%s'\r\n", path);
-        goto cleanup;
+    return status;
+}
+
+// ===================================================================
+// Wait for all queued disk reads to finish, and close their events.
+//   The queue can be reused afterwards.
+//
+// Returns: EFI_SUCCESS or first error from any queued read
+// ===================================================================
+EFI_STATUS disk_read_queue_wait(Disk_Read_Queue *queue) {
+    for (UINTN i = 0; i < DISK_READ_QUEUE_LEN; i++) {
+        disk_read_queue_finish(queue, i);
+        if (queue->tokens[i].Event) bs->CloseEvent(queue->tokens[i].Event);
     }
 
-    // Read file into buffer
-    status = file->Read(file, &buf_size, file_buffer);
-    if (EFI_ERROR(status) || buf_size != file_info.FileSize) {
-        error(status, u"Could not read file '%s' into buffer\r\n", path);
-        goto cleanup;
+    EFI_STATUS status = queue->status;
+    *queue = (Disk_Read_Queue){0};
+    return status;
+}
+
+// ===================================================================
+// Start reading or writing size bytes at a block aligned byte offset
+//   on a disk, to or from a disk copy buffer. Uses async Block IO 2 
+//   if the disk has it and the buffer has an event, else a blocking 
+//   Block IO read/write.
+//
+// Returns: EFI_SUCCESS or error status from starting the read/write.
+//   Errors from async reads/writes are returned by disk_copy_wait()
+// ===================================================================
+EFI_STATUS disk_copy_start(Disk_Info *disk, bool write, UINT64 offset, UINTN size, Disk_Copy_Buffer *buf) {
+    EFI_STATUS status = EFI_SUCCESS;
+    EFI_LBA lba = offset / disk->block_size;
+
+    if (disk->biop2 && buf->token.Event) {
+        EFI_BLOCK_IO2_PROTOCOL *biop2 = disk->biop2;
+        buf->token.TransactionStatus = EFI_SUCCESS;
+        status = write ? biop2->WriteBlocksEx(biop2, disk->media_id, lba, &buf->token, size, buf->data)
+                       : biop2->ReadBlocksEx(biop2, disk->media_id, lba, &buf->token, size, buf->data);
+        buf->busy = !EFI_ERROR(status);
+        return status;
     }
 
-    // Set output file size in buffer
-    *file_size = buf_size;
+    if (!disk->biop) return EFI_UNSUPPORTED;
+    EFI_BLOCK_IO_PROTOCOL *biop = disk->biop;
+    return write ? biop->WriteBlocks(biop, disk->media_id, lba, size, buf->data)
+                 : biop->ReadBlocks(biop, disk->media_id, lba, size, buf->data);
+}
 
-    cleanup:
-    // Close open file/dir pointers
-    if (file) file->Close(file);
-    if (root) root->Close(root);
+// ===================================================================
+// Wait for a disk copy buffer's async read or write to finish, if 
+//   any, so the buffer can be used or reused.
+//
+// Returns: EFI_SUCCESS or error status of the async read/write
+// ===================================================================
+EFI_STATUS disk_copy_wait(Disk_Copy_Buffer *buf) {
+    if (!buf->busy) return EFI_SUCCESS;
 
-    // Will return buffer with file data or NULL on errors
-    return file_buffer; 
+    UINTN index = 0;
+    bs->WaitForEvent(1, &buf->token.Event, &index);
+    buf->busy = false;
+    return buf->token.TransactionStatus;
 }
 
 // =================================================================
@@ -1764,56 +2922,10 @@ read_disk_lbas_to_buffer(EFI_LBA disk_lba, UINTN data_size, UINT32 disk_mediaID,
     EFI_PHYSICAL_ADDRESS buffer = 0;
     EFI_STATUS status = EFI_SUCCESS;
 
-    // Loop through and get Block IO protocol for input media ID, for entire disk
-    //   NOTE: This assumes the first Block IO found with logical partition false is the entire disk
-    EFI_GUID bio_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
-    EFI_BLOCK_IO_PROTOCOL *biop;
-    UINTN num_handles = 0;
-    EFI_HANDLE *handle_buffer = NULL;
-
-    status = bs->LocateHandleBuffer(ByProtocol, &bio_guid, NULL, &num_handles, &handle_buffer);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not locate any Block IO Protocols.\r\n");
-        goto done;
-    }
-
-    BOOLEAN found = false;
-    UINTN i = 0;
-    for (; i < num_handles; i++) {
-        status = bs->OpenProtocol(handle_buffer[i], 
-                                  &bio_guid,
-                                  (VOID **)&biop,
-                                  image,
-                                  NULL,
-                                  EFI_OPEN_PROTOCOL_GET_PROTOCOL);
-
-        if (EFI_ERROR(status)) {
-            fprintf_c16(cerr, u"Could not Open Block IO protocol on handle %u.\r\n", i);
-            continue;
-        }
-
-        if (biop->Media->MediaId == disk_mediaID && !biop->Media->LogicalPartition) {
-            found = true;
-            break;
-        }
-    }
-
-    if (!found) {
-        error(0, u"Could not find Block IO protocol for disk with ID %u.\r\n", disk_mediaID);
-        goto done;
-    }
-
-    // Get Disk IO Protocol on same handle as Block IO protocol
-    EFI_GUID dio_guid = EFI_DISK_IO_PROTOCOL_GUID;
-    EFI_DISK_IO_PROTOCOL *diop;
-    status = bs->OpenProtocol(handle_buffer[i], 
-                              &dio_guid,
-                              (VOID **)&diop,
-                              image,
-                              NULL,
-                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not Open Disk IO protocol on handle %u.\r\n", i);
+    // Get whole disk Block IO & Disk IO protocols for input media ID
+    Disk_Info *disk = find_disk(disk_mediaID);
+    if (!disk || !disk->diop) {
+        error(0, u"Could not find Disk IO protocol for disk with ID %u.\r\n", disk_mediaID);
         goto done;
     }
 
@@ -1828,14 +2940,15 @@ read_disk_lbas_to_buffer(EFI_LBA disk_lba, UINTN data_size, UINT32 disk_mediaID,
         goto done;
     }
 
-    // Use Disk IO Read to read into allocated buffer
-    status = diop->ReadDisk(diop, disk_mediaID, disk_lba * biop->Media->BlockSize, data_size, (VOID *)buffer);
-    if (EFI_ERROR(status)) 
+    // Read into allocated buffer; page aligned, so whole blocks can be read with Block IO directly
+    status = disk_read(disk, disk_lba * disk->block_size, data_size, (VOID *)buffer, NULL);
+    if (EFI_ERROR(status)) {
         error(status, u"Could not read Disk LBAs into buffer.\r\n");
+        bs->FreePages(buffer, pages_needed);
+        buffer = 0;
+    }
 
     done:
-    if (handle_buffer) bs->FreePool(handle_buffer);   // Free allocated handle buffer
-
     return buffer;
 }
 
@@ -2022,58 +3135,244 @@ EFI_STATUS check_gop_mode(UINT32 *ret_mode, UINT32 xres, UINT32 yres) {
 // Get Media ID value for this running disk image
 // ================================================
 EFI_STATUS get_disk_image_mediaID(UINT32 *mediaID) {
-    EFI_STATUS status = EFI_SUCCESS;
+    EFI_STATUS status = build_disk_table();
+    if (EFI_ERROR(status)) return status;
 
-    // Get media ID for this disk image 
-    EFI_GUID lip_guid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
-    EFI_LOADED_IMAGE_PROTOCOL *lip = NULL;
-    status = bs->OpenProtocol(image,
-                              &lip_guid,
-                              (VOID **)&lip,
-                              image,
-                              NULL,
-                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not open Loaded Image Protocol\r\n");
-        goto done;
+    if (!disk_table.image_disk) {
+        error(EFI_NOT_FOUND, u"Could not find Block IO Protocol for this loaded image.\r\n");
+        return EFI_NOT_FOUND;
     }
 
-    // Get Block IO protocol for loaded image's device handle
-    EFI_GUID bio_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
-    EFI_BLOCK_IO_PROTOCOL *biop = NULL;
-    status = bs->OpenProtocol(lip->DeviceHandle,
-                              &bio_guid,
-                              (VOID **)&biop,
-                              image,
-                              NULL,
-                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
-    if (EFI_ERROR(status)) {
-        error(status, u"Could not open Block IO Protocol for this loaded image.\r\n");
-        goto done;
+    *mediaID = disk_table.image_disk->media_id;  // Media ID for this running disk image itself
+    return EFI_SUCCESS;
+}
+
+// ===================================================================
+// Parse unsigned decimal number at start of [s, end) 
+// ===================================================================
+UINTN parse_uint(char *s, char *end) {
+    UINTN result = 0;
+    for (; s < end && isdigit(*s); s++) 
+        result = (result * 10) + (*s - '0');
+
+    return result;
+}
+
+// ===================================================================
+// Build index of data partition files, from the binary FILE.IDX in
+//   the ESP if it exists and is valid, else by parsing FILE.TXT once:
+//   "DISK_SIZE=" line, then "FILE_NAME=", "FILE_SIZE=", "DISK_LBA=" 
+//   lines for each file.
+//   Only reads the ESP on the first call.
+//
+// Returns: true if index was built or already built
+// ===================================================================
+bool build_data_file_index(VOID) {
+    if (data_file_index.built) return true;
+
+    EFI_FILE_PROTOCOL *root = esp_root_dir();
+    if (!root) return false;
+
+    // FILE.TXT from the disk image tool is always needed, to check that FILE.IDX was 
+    //   generated from it and not from an older image
+    CHAR16 *txt_name = u"\\EFI\\BOOT\\FILE.TXT";
+    UINTN buf_size = 0;
+    char *text = read_esp_file_to_buffer(txt_name, &buf_size);
+    if (!text) {
+        error(0, u"Could not find or read file '%s' to buffer\r\n", txt_name);
+        return false;
+    }
+
+    // Use binary index as is, if found & matching FILE.TXT; NULL = not present
+    CHAR16 *idx_name = u"\\EFI\\BOOT\\FILE.IDX";
+    UINTN idx_size = 0;
+    VOID *buffer = read_esp_file_to_buffer(idx_name, &idx_size);
+    if (buffer) {
+        Data_File_Index_Header *hdr = buffer;
+        Data_File_Entry *entries = (Data_File_Entry *)(hdr + 1);
+        bool valid = idx_size >= sizeof *hdr && 
+                     !memcmp(hdr->magic, DATA_FILE_INDEX_MAGIC, sizeof hdr->magic) &&
+                     hdr->num_entries <= (idx_size - sizeof *hdr) / sizeof *entries &&
+                     hdr->txt_size == buf_size && 
+                     hdr->txt_crc32 == crc32_update(0, text, buf_size);
+
+        // Binary search needs entries sorted by name
+        for (UINTN i = 1; valid && i < hdr->num_entries; i++) 
+            valid = strncmp(entries[i-1].name, entries[i].name, DATA_FILE_NAME_LEN) < 0;
+
+        if (valid) {
+            bs->FreePool(text);
+            data_file_index = (Data_File_Index){
+                .entries     = entries,
+                .num_entries = hdr->num_entries,
+                .disk_size   = hdr->disk_size,
+                .buffer      = buffer,
+                .built       = true,
+            };
+            return true;
+        }
+
+        error(0, u"Invalid or out of date file index '%s', using FILE.TXT\r\n", idx_name);
+        bs->FreePool(buffer);
     }
 
-    *mediaID = biop->Media->MediaId;  // Media ID for this running disk image itself
+    // Fall back to parsing FILE.TXT
+
+    // Count files for entries array size
+    char *end = text + buf_size;
+    char *name_key = "FILE_NAME=";
+    UINTN name_key_len = strlen(name_key), max_entries = 0;
+    for (char *pos = text; (pos = memmem(pos, end - pos, name_key, name_key_len)); pos += name_key_len)
+        max_entries++;
+
+    Data_File_Entry *entries = NULL;
+    if (max_entries > 0 && 
+        EFI_ERROR(bs->AllocatePool(EfiLoaderData, max_entries * sizeof *entries, (VOID **)&entries))) {
+        error(0, u"Could not allocate memory for data file index\r\n");
+        bs->FreePool(text);
+        return false;
+    }
+
+    // Parse "KEY=VALUE" lines; FILE_NAME starts a new entry, which is insertion sorted 
+    //   by name once its other values are filled in
+    UINTN num_entries = 0, disk_size = 0;
+    Data_File_Entry *entry = NULL;
+    for (char *line = text, *eol; line < end; line = eol + 1) {
+        eol = memmem(line, end - line, "\n", 1);
+        if (!eol) eol = end;
+
+        char *value = memmem(line, eol - line, "=", 1);
+        if (!value) continue;
+        UINTN key_len = ++value - line;
+        char *value_end = eol;
+        if (value_end > value && value_end[-1] == '\r') value_end--;
+
+        if (key_len == name_key_len && !memcmp(line, name_key, key_len)) {
+            UINTN name_len = value_end - value;
+            if (name_len >= DATA_FILE_NAME_LEN) {
+                error(0, u"Data file name too long in FILE.TXT, skipping\r\n");
+                entry = NULL;
+                continue;
+            }
+
+            char name[DATA_FILE_NAME_LEN] = {0};
+            memcpy(name, value, name_len);
+
+            UINTN i = num_entries++;
+            for (; i > 0 && strncmp(entries[i-1].name, name, DATA_FILE_NAME_LEN) > 0; i--)
+                entries[i] = entries[i-1];
+
+            entry = &entries[i];
+            *entry = (Data_File_Entry){0};
+            memcpy(entry->name, name, DATA_FILE_NAME_LEN);
+
+        } else if (key_len == 10 && !memcmp(line, "DISK_SIZE=", key_len)) {
+            disk_size = parse_uint(value, value_end);
+
+        } else if (entry && key_len == 10 && !memcmp(line, "FILE_SIZE=", key_len)) {
+            entry->file_size = parse_uint(value, value_end);
+
+        } else if (entry && key_len == 9 && !memcmp(line, "DISK_LBA=", key_len)) {
+            entry->disk_lba = parse_uint(value, value_end);
+        }
+    }
+
+    bs->FreePool(text);
+
+    data_file_index = (Data_File_Index){
+        .entries     = entries,
+        .num_entries = num_entries,
+        .disk_size   = disk_size,
+        .buffer      = entries,
+        .built       = true,
+    };
+    return true;
+}
+
+// ===================================================================
+// Free data file index from build_data_file_index(), if built
+// ===================================================================
+VOID free_data_file_index(VOID) {
+    if (data_file_index.buffer) bs->FreePool(data_file_index.buffer);
+    data_file_index = (Data_File_Index){0};
+}
+
+// ===================================================================
+// Find data partition file by name, building the index first if 
+//   needed. Name can also be a prefix of the file name, e.g. "kernel"
+//   for "kernel.elf"; the first match in sorted order is used.
+//
+// Returns: Pointer to index entry, or NULL if not found
+// ===================================================================
+Data_File_Entry *find_data_file(char *name) {
+    if (!build_data_file_index()) return NULL;
+
+    UINTN name_len = strlen(name);
+    if (name_len >= DATA_FILE_NAME_LEN) return NULL;
+
+    // Binary search for first entry >= name; an exact or prefix match sorts there
+    Data_File_Entry *entries = data_file_index.entries;
+    UINTN lo = 0, hi = data_file_index.num_entries;
+    while (lo < hi) {
+        UINTN mid = lo + (hi - lo) / 2;
+        if (strncmp(entries[mid].name, name, DATA_FILE_NAME_LEN) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo < data_file_index.num_entries && !strncmp(entries[lo].name, name, name_len))
+        return &entries[lo];
+
+    return NULL;
+}
+
+// ===================================================================
+// Read size bytes at offset within a file in the disk image's data 
+//   partition, directly into an existing buffer, e.g. to stream 
+//   parts of a file to their final location without a copy.
+//   If queue is not NULL, the read may be async; see disk_read().
+//
+// Returns: EFI_SUCCESS or error status
+// ===================================================================
+EFI_STATUS read_data_partition_file(Data_File_Entry *file, UINT64 offset, UINTN size, VOID *buffer,
+                                    Disk_Read_Queue *queue) {
+    if (offset > file->file_size || size > file->file_size - offset) {
+        error(EFI_INVALID_PARAMETER, u"Read past end of data partition file '%.*hhs'\r\n", 
+              (int)DATA_FILE_NAME_LEN, file->name);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    EFI_STATUS status = build_disk_table();
+    if (EFI_ERROR(status)) return status;
+
+    Disk_Info *disk = disk_table.image_disk;
+    if (!disk || (!disk->diop && !disk->diop2 && !disk->biop)) {
+        error(EFI_NOT_FOUND, u"Could not find Disk IO protocol for disk image.\r\n");
+        return EFI_NOT_FOUND;
+    }
+
+    status = disk_read(disk, (file->disk_lba * disk->block_size) + offset, size, buffer, queue);
+    if (EFI_ERROR(status)) 
+        error(status, u"Could not read data partition file '%.*hhs' into buffer.\r\n",
+              (int)DATA_FILE_NAME_LEN, file->name);
 
-    done:
     return status;
 }
 
 // ===============================================================
 // Read a file in the GPT disk image's raw data partition,
-//   using information found in the FILE.TXT file in the ESP,
-//   created when making the disk image.
+//   using the data file index from FILE.IDX or FILE.TXT in the 
+//   ESP, created when making the disk image.
 //
 // Returns: 
 //  - non-null pointer to allocated buffer with file data, 
 //      allocated with Boot Services AllocatePool(), or NULL if not 
-//      found or error.
+//      found (silently) or error (with an error message).
 //  - Size of returned buffer, if not NULL.
 //
 //  NOTE: Caller will have to use FreePool() on returned buffer to 
 //    free allocated memory.
 // ===============================================================
 VOID *read_data_partition_file_to_buffer(char *in_name, bool executable, UINTN *ret_size) {
-    VOID *esp_file = NULL;
     VOID *data_file = NULL;
     EFI_STATUS status = EFI_SUCCESS;
 
@@ -2085,48 +3384,25 @@ VOID *read_data_partition_file_to_buffer(char *in_name, bool executable, UINTN *
         goto cleanup;
     }
 
-    // Get FILE.TXT file from path "/EFI/BOOT/FILE.TXT"
-    CHAR16 *file_name = u"\\EFI\\BOOT\\FILE.TXT";
-    UINTN buf_size = 0;
-    esp_file = read_esp_file_to_buffer(file_name, &buf_size);
-    if (!esp_file) {
-        error(0, u"Could not find or read file '%s' to buffer\r\n", file_name);
-        goto cleanup;
-    }
-
-    // Get disk LBA and file size from FILE.TXT for input file name 
-    char *str_pos = stpstr(esp_file, in_name);
-    if (!str_pos) {
-        error(0, u"Could not find file '%s' in data partition\r\n", in_name);
-        goto cleanup;
-    }
-
-    str_pos = stpstr(str_pos, "FILE_SIZE=");
-    if (!str_pos) {
-        error(0, u"Could not find file size for '%s'\r\n", in_name);
+    // Get disk LBA and file size for input file name from data file index
+    Data_File_Entry *entry = find_data_file(in_name);
+    if (!entry) {
+        error(0, u"Could not find file '%hhs' in data partition\r\n", in_name);
         goto cleanup;
     }
 
-    UINTN file_size = atoi(str_pos);
-
-    str_pos = stpstr(str_pos, "DISK_LBA=");
-    if (!str_pos) {
-        error(0, u"Could not find disk lba value for '%s'\r\n", in_name);
-        goto cleanup;
-    }
-
-    UINTN disk_lba = atoi(str_pos);
+    UINTN file_size = entry->file_size;
+    UINTN disk_lba = entry->disk_lba;
 
     // Read disk lbas for file into buffer
     data_file = (VOID *)read_disk_lbas_to_buffer(disk_lba, file_size, image_mediaID, executable);
     *ret_size = file_size;
     if (!data_file) {
-        error(0, u"Could not find or read data partition file '%s' to buffer\r\n", in_name);
+        error(0, u"Could not find or read data partition file '%hhs' to buffer\r\n", in_name);
         *ret_size = 0;
     } 
 
     cleanup:
-    if (esp_file) bs->FreePool(esp_file);  
     return data_file;
 }
 
@@ -2359,17 +3635,153 @@ void identity_map_page(UINTN address, Memory_Map_Info *mmap) {
     arch_map_page(address, address, mmap);
 }
 
+// ======================================================================
+// Identity map a page aligned range of memory with MAP_* flags
+// ======================================================================
+extern void arch_map_range(uint64_t physical_address, uint64_t virtual_address, uint64_t length, 
+                           uint64_t map_flags, Memory_Map_Info *mmap);
+
+void identity_map_range(UINTN address, UINTN length, UINT64 map_flags, Memory_Map_Info *mmap) {
+    arch_map_range(address, address, length, map_flags, mmap);
+}
+
+// ======================================================================
+// Get MAP_* flags to map a memory descriptor with from its type and 
+//   attributes: MMIO is uncacheable, so it is never read speculatively,
+//   and everything else uses the most cacheable type it supports (WB for
+//   RAM). Types that only hold data are not executable. 
+// NOTE: XP & RO in GetMemoryMap() descriptors only say the memory can be
+//   protected that way, and some firmware sets them on all memory, so they
+//   are not used; runtime regions get their access from the memory 
+//   attributes table instead, see identity_map_memory_attributes().
+// ======================================================================
+UINT64 efi_memory_map_flags(EFI_MEMORY_DESCRIPTOR *desc) {
+    UINT64 flags = MAP_WRITE | MAP_USER;
+
+    if (desc->Type == EfiMemoryMappedIO || desc->Type == EfiMemoryMappedIOPortSpace)
+        flags |= MAP_UC;
+    else if (desc->Attribute & EFI_MEMORY_WB) 
+        ;   // WB, no memory type flag
+    else if (desc->Attribute & EFI_MEMORY_WT) 
+        flags |= MAP_WT;
+    else if (desc->Attribute & EFI_MEMORY_WC) 
+        flags |= MAP_WC;
+    else if (desc->Attribute & EFI_MEMORY_WP) 
+        flags |= MAP_WP;
+    else if (desc->Attribute & EFI_MEMORY_UC || 
+             desc->Type == EfiReservedMemoryType || desc->Type == EfiUnusableMemory) 
+        flags |= MAP_UC;
+    // Else RAM with no reported cacheability, keep WB 
+
+    if (desc->Type == EfiBootServicesData         ||
+        desc->Type == EfiRuntimeServicesData      ||
+        desc->Type == EfiConventionalMemory       ||
+        desc->Type == EfiUnusableMemory           ||
+        desc->Type == EfiACPIReclaimMemory        ||
+        desc->Type == EfiACPIMemoryNVS            ||
+        desc->Type == EfiMemoryMappedIO           ||
+        desc->Type == EfiMemoryMappedIOPortSpace) {
+
+        flags |= MAP_NX;
+    }
+    return flags;
+}
+
+// ======================================================================
+// Get name of MAP_* flags memory type
+// ======================================================================
+char *map_flags_type_name(UINT64 map_flags) {
+    switch (map_flags & MAP_TYPE_MASK) {
+        case MAP_WC: return "WC";
+        case MAP_UC: return "UC";
+        case MAP_WT: return "WT";
+        case MAP_WP: return "WP";
+        case 0:      return "WB";
+        default:     return "??";
+    }
+}
+
+// ======================================================================
+// Get the next range of physically contiguous descriptors with the same
+//   MAP_* flags in the memory map, starting at descriptor *i, and advance
+//   *i past it. Contiguous descriptors are 1 range so e.g. large pages 
+//   can span them.
+// Returns: true and range [*start, *end) with *map_flags, or false if no
+//   descriptors left
+// ======================================================================
+bool next_mmap_range(Memory_Map_Info *mmap, UINTN *i, UINTN *start, UINTN *end, UINT64 *map_flags) {
+    const UINTN num_descs = mmap->size / mmap->desc_size;
+    if (*i >= num_descs) return false;
+
+    EFI_MEMORY_DESCRIPTOR *desc = 
+        (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)mmap->map + (*i * mmap->desc_size));
+    *start     = desc->PhysicalStart;
+    *end       = desc->PhysicalStart + (desc->NumberOfPages * PAGE_SIZE);
+    *map_flags = efi_memory_map_flags(desc);
+
+    for ((*i)++; *i < num_descs; (*i)++) {
+        desc = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)mmap->map + (*i * mmap->desc_size));
+        if (desc->PhysicalStart != *end || efi_memory_map_flags(desc) != *map_flags) break;
+        *end += desc->NumberOfPages * PAGE_SIZE;
+    }
+    return true;
+}
+
 // ======================================================================
 // Initialize new paging setup by identity mapping all available memory 
-//   from EFI memory map
+//   from EFI memory map, with each descriptor's memory type & access
 // ======================================================================
 void identity_map_efi_mmap(Memory_Map_Info *mmap) {
+    UINTN i = 0, start = 0, end = 0;
+    UINT64 map_flags = 0;
+    while (next_mmap_range(mmap, &i, &start, &end, &map_flags)) 
+        identity_map_range(start, end - start, map_flags, mmap);
+}
+
+// ======================================================================
+// Get entry i of the memory attributes table
+// ======================================================================
+EFI_MEMORY_DESCRIPTOR *memory_attributes_entry(EFI_MEMORY_ATTRIBUTES_TABLE *mat, UINTN i) {
+    return (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)(mat + 1) + (i * mat->DescriptorSize));
+}
+
+// ======================================================================
+// Get the runtime services code or data memory map descriptor that a 
+//   memory attributes table entry starts in, or NULL if none; the table
+//   only sets the access of runtime regions, never e.g. EfiLoaderCode
+// ======================================================================
+EFI_MEMORY_DESCRIPTOR *memory_attributes_descriptor(Memory_Map_Info *mmap, EFI_MEMORY_DESCRIPTOR *entry) {
     for (UINTN i = 0; i < mmap->size / mmap->desc_size; i++) {
         EFI_MEMORY_DESCRIPTOR *desc = 
             (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)mmap->map + (i * mmap->desc_size));
+        if (entry->PhysicalStart < desc->PhysicalStart || 
+            entry->PhysicalStart - desc->PhysicalStart >= desc->NumberOfPages * PAGE_SIZE) 
+            continue;
+
+        return desc->Type == EfiRuntimeServicesCode || desc->Type == EfiRuntimeServicesData ? 
+               desc : NULL;
+    }
+    return NULL;
+}
 
-        for (UINTN j = 0; j < desc->NumberOfPages; j++)
-            identity_map_page(desc->PhysicalStart + (j * PAGE_SIZE), mmap);
+// ======================================================================
+// Identity map the runtime regions in the memory attributes table, if 
+//   any, with the memory type of the memory map descriptor each is in:
+//   RO entries are not writable and XP entries are not executable. Done
+//   before the memory map, so these ranges keep their access.
+// ======================================================================
+void identity_map_memory_attributes(EFI_MEMORY_ATTRIBUTES_TABLE *mat, Memory_Map_Info *mmap) {
+    if (!mat) return;
+
+    for (UINTN i = 0; i < mat->NumberOfEntries; i++) {
+        EFI_MEMORY_DESCRIPTOR *entry = memory_attributes_entry(mat, i);
+        EFI_MEMORY_DESCRIPTOR *desc = memory_attributes_descriptor(mmap, entry);
+        if (!desc) continue;    // Not a runtime region, mapped as the memory map says
+
+        UINT64 map_flags = (efi_memory_map_flags(desc) & ~MAP_NX) | MAP_WRITE;
+        if (entry->Attribute & EFI_MEMORY_RO) map_flags &= ~MAP_WRITE;
+        if (entry->Attribute & EFI_MEMORY_XP) map_flags |= MAP_NX;
+        identity_map_range(entry->PhysicalStart, entry->NumberOfPages * PAGE_SIZE, map_flags, mmap);
     }
 }
 
@@ -0,0 +1,153 @@
+//
+// bench.c: Host microbenchmarks for efi_lib.h helpers. Prints 1 CSV line per
+//   function and size: name,bytes,ns_per_op,gb_per_s; each time is the best of
+//   REPEATS runs, so reruns are comparable.
+//
+#include "host_efi.h"
+
+#define REPEATS 5
+#define TOTAL_BYTES (64ULL * 1024 * 1024)  // Bytes to process per run of a function & size
+
+// Keep the compiler from dropping or merging benchmarked calls
+#define CLOBBER() __asm__ __volatile__ ("" : : : "memory")
+
+// =================================================================
+// Print 1 CSV line for ops calls of bytes each that took seconds
+// =================================================================
+void report(const char *name, UINTN bytes, UINTN ops, double seconds) {
+    host_printf("%s,%llu,%.2f,%.3f\n", name, (unsigned long long)bytes,
+                (seconds * 1e9) / ops, seconds > 0 ? ((double)bytes * ops) / seconds / 1e9 : 0.0);
+}
+
+// Best of REPEATS times for a statement run iters times
+#define TIME_BEST(best, iters, stmt)                                \
+    do {                                                            \
+        best = 1e30;                                                \
+        for (UINTN r_ = 0; r_ < REPEATS; r_++) {                    \
+            double t_ = host_seconds();                             \
+            for (UINTN k_ = 0; k_ < (iters); k_++) { stmt; CLOBBER(); } \
+            t_ = host_seconds() - t_;                               \
+            if (t_ < best) best = t_;                               \
+        }                                                           \
+    } while (0)
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;      // Only benchmark results go to stdout
+
+    // memcpy/memset sweep from 16 bytes to 64MiB, past the last level cache, in 4x steps;
+    //   the other helpers stop at 1MiB
+    const UINTN copy_sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 256*1024, 
+                                 1024*1024, 4*1024*1024, 16*1024*1024, 64*1024*1024 };
+    const UINTN sizes[] = { 16, 256, 4096, 65536, 1024*1024 };
+    const UINTN MAX_SIZE = copy_sizes[ARRAY_SIZE(copy_sizes)-1];
+    UINT8 *src = host_alloc(MAX_SIZE + 64, 64);
+    UINT8 *dst = host_alloc(MAX_SIZE + 64, 64);
+    memset_bytes(src, 'A', MAX_SIZE + 64);
+    src[MAX_SIZE] = '\0';   // For strlen
+
+    struct { char *name; VOID *(*func)(VOID *, VOID *, UINTN); } copy_funcs[] = {
+        { "memcpy_bytes", memcpy_bytes },
+        { "memcpy_words", memcpy_words },
+        { "memcpy_wide",  memcpy_wide  },
+        { "memcpy",       memcpy       },
+        { "memmove",      memmove      },
+    };
+
+    struct { char *name; VOID *(*func)(VOID *, UINT8, UINTN); } set_funcs[] = {
+        { "memset_bytes", memset_bytes },
+        { "memset_words", memset_words },
+        { "memset_wide",  memset_wide  },
+        { "memset",       memset       },
+    };
+
+    struct { char *name; INTN (*func)(VOID *, VOID *, UINTN); } cmp_funcs[] = {
+        { "memcmp_bytes", memcmp_bytes },
+        { "memcmp_words", memcmp_words },
+        { "memcmp",       memcmp       },
+    };
+
+    struct { char *name; bool (*func)(VOID *, UINTN); } zero_funcs[] = {
+        { "mem_is_zero_words", mem_is_zero_words },
+        { "mem_is_zero",       mem_is_zero       },
+    };
+
+    struct { char *name; UINTN (*func)(char *); } strlen_funcs[] = {
+        { "strlen_bytes", strlen_bytes },
+        { "strlen_words", strlen_words },
+        { "strlen",       strlen       },
+    };
+
+    host_printf("# mem_method=%u\nname,bytes,ns_per_op,gb_per_s\n", mem_method);
+    double best = 0;
+
+    for (UINTN i = 0; i < ARRAY_SIZE(copy_sizes); i++) {
+        UINTN size = copy_sizes[i];
+        UINTN iters = TOTAL_BYTES / size;
+
+        // Misaligned dst by 1 byte, to also time head/tail handling
+        for (UINTN j = 0; j < ARRAY_SIZE(copy_funcs); j++) {
+            TIME_BEST(best, iters, copy_funcs[j].func(dst + 1, src, size));
+            report(copy_funcs[j].name, size, iters, best);
+        }
+
+        for (UINTN j = 0; j < ARRAY_SIZE(set_funcs); j++) {
+            TIME_BEST(best, iters, set_funcs[j].func(dst + 1, 'B', size));
+            report(set_funcs[j].name, size, iters, best);
+        }
+    }
+
+    for (UINTN i = 0; i < ARRAY_SIZE(sizes); i++) {
+        UINTN size = sizes[i];
+        UINTN iters = TOTAL_BYTES / size;
+
+        memcpy(dst, src, size);     // Equal buffers to compare all bytes
+        for (UINTN j = 0; j < ARRAY_SIZE(cmp_funcs); j++) {
+            TIME_BEST(best, iters, cmp_funcs[j].func(dst, src, size));
+            report(cmp_funcs[j].name, size, iters, best);
+        }
+
+        memset(dst, 0, size);       // All zero buffer to check all bytes
+        for (UINTN j = 0; j < ARRAY_SIZE(zero_funcs); j++) {
+            TIME_BEST(best, iters, zero_funcs[j].func(dst, size));
+            report(zero_funcs[j].name, size, iters, best);
+        }
+
+        char saved = src[size];
+        src[size] = '\0';
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_funcs); j++) {
+            TIME_BEST(best, iters, strlen_funcs[j].func((char *)src));
+            report(strlen_funcs[j].name, size, iters, best);
+        }
+        src[size] = saved;
+
+        TIME_BEST(best, iters, crc32_update(0, src, size));
+        report("crc32_update", size, iters, best);
+    }
+
+    // Formatted strings, using a typical line from print_memory_map()
+    const UINTN FORMAT_ITERS = 100000;
+    CHAR16 buf_c16[128];
+    char buf[128];
+    INTN len = 0;
+
+    TIME_BEST(best, FORMAT_ITERS,
+              len = snprintf_c16(buf_c16, ARRAY_SIZE(buf_c16),
+                                 u"%u: Typ: %u, Phy: %x, Vrt: %x, Pgs: %u, Att: %x\r\n",
+                                 k_, 7, 0x100000 + k_, 0, 0x7F00, 0xF));
+    report("snprintf_c16", len * sizeof *buf_c16, FORMAT_ITERS, best);
+
+    TIME_BEST(best, FORMAT_ITERS,
+              len = snprintf(buf, sizeof buf, "%u: Typ: %u, Phy: %x, Vrt: %x, Pgs: %u, Att: %x\r\n",
+                             k_, 7, 0x100000 + k_, 0, 0x7F00, 0xF));
+    report("snprintf", len, FORMAT_ITERS, best);
+
+    // printf_c16 through the console buffer & stub OutputString()
+    TIME_BEST(best, FORMAT_ITERS,
+              printf_c16(u"%u: Typ: %u, Phy: %x, Vrt: %x, Pgs: %u, Att: %x\r\n",
+                         k_, 7, 0x100000 + k_, 0, 0x7F00, 0xF));
+    flush_c16(cout);
+    report("printf_c16", len * sizeof(CHAR16), FORMAT_ITERS, best);
+
+    return 0;
+}
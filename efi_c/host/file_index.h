@@ -0,0 +1,27 @@
+//
+// file_index.h: Write the FILE.IDX binary data file index (see Data_File_Index in
+//   efi_lib.h) from an index built by build_data_file_index(), for host/mkfileidx & tests.
+//
+#pragma once
+
+// =================================================================
+// Lay out data_file_index, built from the FILE.TXT in txt, as FILE.IDX: 
+//   header, then the entries in their (already sorted) index order
+// Returns: host_alloc()'d FILE.IDX contents & size
+// =================================================================
+VOID *make_file_index(VOID *txt, UINTN txt_size, UINTN *size) {
+    Data_File_Index_Header hdr = {
+        .magic       = DATA_FILE_INDEX_MAGIC,   // Not NULL terminated
+        .disk_size   = data_file_index.disk_size,
+        .num_entries = data_file_index.num_entries,
+        .txt_size    = txt_size,
+        .txt_crc32   = crc32_update(0, txt, txt_size),
+    };
+    UINTN entries_size = data_file_index.num_entries * sizeof *data_file_index.entries;
+
+    *size = sizeof hdr + entries_size;
+    UINT8 *buf = host_alloc(*size, 8);
+    memcpy(buf, &hdr, sizeof hdr);
+    if (entries_size) memcpy(buf + sizeof hdr, data_file_index.entries, entries_size);
+    return buf;
+}
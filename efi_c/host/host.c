@@ -0,0 +1,92 @@
+//
+// host.c: libc helpers for the Linux host tests & benchmarks, see host.h
+//
+#define _DEFAULT_SOURCE     // MAP_ANONYMOUS, clock_gettime(), posix_memalign()
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+int host_printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int result = vprintf(fmt, args);
+    va_end(args);
+    return result;
+}
+
+double host_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+void *host_alloc(uint64_t size, uint64_t align) {
+    if (align < sizeof(void *)) align = sizeof(void *);
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, align, size ? size : 1)) {
+        fprintf(stderr, "host_alloc: out of memory (%llu bytes)\n", (unsigned long long)size);
+        exit(2);
+    }
+    return ptr;
+}
+
+void host_free(void *ptr) {
+    free(ptr);
+}
+
+// =================================================================
+// Map pages of memory followed by an inaccessible guard page, so 
+//   any read past the end of the last page faults
+// =================================================================
+uint8_t *host_guard_pages(uint64_t pages) {
+    uint8_t *p = mmap(NULL, (pages + 1) * 4096, PROT_READ | PROT_WRITE, 
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED || mprotect(p + (pages * 4096), 4096, PROT_NONE)) {
+        perror("host_guard_pages");
+        exit(2);
+    }
+    return p;
+}
+
+char *host_getenv(const char *name) {
+    return getenv(name);
+}
+
+// =================================================================
+// Read a whole file into a host_alloc() buffer
+// Returns: buffer & size, or NULL if the file could not be read
+// =================================================================
+void *host_read_file(const char *path, uint64_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    void *data = NULL;
+    long len = -1;
+    if (!fseek(fp, 0, SEEK_END) && (len = ftell(fp)) >= 0 && !fseek(fp, 0, SEEK_SET)) {
+        data = host_alloc(len, 8);
+        if (fread(data, 1, len, fp) != (size_t)len) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+
+    *size = data ? (uint64_t)len : 0;
+    return data;
+}
+
+// =================================================================
+// Write size bytes of data to a new or truncated file
+// Returns: true on success
+// =================================================================
+bool host_write_file(const char *path, const void *data, uint64_t size) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return false;
+
+    bool ok = fwrite(data, 1, size, fp) == size;
+    return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,18 @@
+//
+// host.h: libc helpers for the Linux host tests & benchmarks in this folder.
+//   efi_lib.h defines its own memcpy(), snprintf(), etc. with UEFI types, so 
+//   libc headers are only included in host.c, behind these wrappers.
+//
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+int      host_printf(const char *fmt, ...);     // printf() to stdout
+double   host_seconds(void);                    // Monotonic clock in seconds
+void    *host_alloc(uint64_t size, uint64_t align);
+void     host_free(void *ptr);
+uint8_t *host_guard_pages(uint64_t pages);      // pages * 4KiB read/write, then 1 unmapped page
+char    *host_getenv(const char *name);
+void    *host_read_file(const char *path, uint64_t *size);  // host_alloc()'d contents, or NULL
+bool     host_write_file(const char *path, const void *data, uint64_t size);
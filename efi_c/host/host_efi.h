@@ -0,0 +1,596 @@
+//
+// host_efi.h: Build efi.c & efi_lib.h for the Linux host with a stub system table:
+//   boot services memory, memory map, TPL, event & stall calls, a GOP lookup, and a
+//   console that writes to stdout and can be captured by tests. Included once by
+//   each test/benchmark program.
+//
+#pragma once
+
+#include "host.h"
+#include "../efi.c"
+
+// ---------------------
+// Global variables
+// ---------------------
+// Console output; tests can turn off echo and check the captured text instead
+typedef struct {
+    bool   echo;                // Write output to stdout as ASCII
+    bool   capture;             // Append output to text[]
+    UINTN  output_calls;        // # of OutputString() calls
+    UINTN  len;                 // # of CHAR16s in text[]
+    CHAR16 text[1024 * 1024];
+} Host_Console;
+
+Host_Console host_console = { .echo = true };
+
+CHAR16 *host_keys = NULL;       // Keys to return from ReadKeyStroke() in order, then carriage returns
+
+UINT8 host_page_fill = 0xAA;    // AllocatePages() fills new pages with this, like stale memory
+
+EFI_TPL host_tpl = TPL_APPLICATION;     // Current TPL from RaiseTPL()/RestoreTPL()
+
+UINTN host_open_events = 0;     // CreateEvent() - CloseEvent(), to check for leaked events
+
+UINTN host_pages_in_use = 0;    // AllocatePages() - FreePages() pages, to check for leaks
+
+// Memory map returned by GetMemoryMap(): size bytes of desc_size byte descriptors
+EFI_MEMORY_DESCRIPTOR *host_memory_map = NULL;
+UINTN host_memory_map_size = 0;
+UINTN host_memory_map_desc_size = sizeof(EFI_MEMORY_DESCRIPTOR);
+
+EFI_GRAPHICS_OUTPUT_PROTOCOL *host_gop = NULL;  // Returned by LocateProtocol() for GOP, or not found
+
+// Called by RaiseTPL() when raising from TPL_APPLICATION, before the new TPL takes
+//   effect, like a timer callback that fires right before the raise
+void (*host_raise_hook)(void) = NULL;
+
+// Called for each event WaitForEvent() waits on before it returns, e.g. to complete
+//   a fake asynchronous disk read for that event
+void (*host_wait_hook)(EFI_EVENT event) = NULL;
+
+UINTN host_failures = 0;        // # of failed CHECK()s
+
+// Files in the stub ESP, opened by full path e.g. u"\\EFI\\BOOT\\FILE.TXT"; tests 
+//   fill in data/size, and size 0 with data NULL is "not found"
+typedef struct {
+    CHAR16 *path;
+    VOID   *data;
+    UINTN   size;
+} Host_File;
+
+Host_File host_esp_files[8] = {0};
+
+// Fake disk in memory, with Block IO & Disk IO protocols over data; protocols are
+//   first in the struct, so a protocol pointer is also a Host_Disk *
+typedef struct {
+    EFI_BLOCK_IO_PROTOCOL  bio;
+    EFI_DISK_IO_PROTOCOL   dio;
+    EFI_DISK_IO2_PROTOCOL  dio2;    // Only set up by host_disk_init_async()
+    EFI_BLOCK_IO2_PROTOCOL bio2;    // Only set up by host_disk_init_async()
+    EFI_BLOCK_IO_MEDIA     media;
+    UINT8  *data;
+    UINT64  size;
+    UINTN   block_reads;        // # of ReadBlocks() calls
+    UINTN   disk_reads;         // # of ReadDisk() calls
+    UINTN   writes;             // # of WriteBlocks()/WriteDisk() calls
+    UINTN   max_transfer;       // Largest single Block IO transfer in bytes
+    UINTN   misaligned;         // # of Block IO calls with a buffer not aligned to IoAlign
+    UINTN   async_ops;          // # of queued async reads/writes
+    UINTN   in_flight;          // # of queued async reads/writes not yet finished
+    UINTN   max_in_flight;
+    EFI_STATUS async_status;    // Status for finished async transfers; an error skips the transfer
+    UINT64  bytes_written;
+    UINT64  corrupt_start;      // Writes flip the low bit of the 1st byte of each 4KiB
+    UINT64  corrupt_end;        //   page in [corrupt_start, corrupt_end), like a bad disk
+} Host_Disk;
+
+// Queued async disk read/write; it happens when WaitForEvent() waits on its event,
+//   so a caller that uses the buffer before waiting sees stale data
+typedef struct {
+    bool        live;
+    EFI_EVENT   event;
+    Host_Disk  *disk;
+    bool        write;
+    UINT64      offset;
+    UINTN       size;
+    VOID       *buffer;
+    EFI_STATUS *status;         // Token's TransactionStatus
+} Host_Disk_Op;
+
+Host_Disk_Op host_disk_ops[64] = {0};
+
+#define HOST_DISK(ptr, member) ((Host_Disk *)((UINT8 *)(ptr) - __builtin_offsetof(Host_Disk, member)))
+
+// Open file handle; proto is first so an EFI_FILE_PROTOCOL * is also a Host_Open_File *
+typedef struct {
+    EFI_FILE_PROTOCOL proto;
+    Host_File *file;            // NULL for the root directory
+    UINT64     position;
+} Host_Open_File;
+
+// ---------------------
+// Stub functions
+// ---------------------
+EFI_STATUS EFIAPI host_output_string(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, CHAR16 *String) {
+    char ascii[256];
+    UINTN len = 0;
+
+    host_console.output_calls++;
+    for (; *String; String++) {
+        if (host_console.capture && host_console.len < ARRAY_SIZE(host_console.text))
+            host_console.text[host_console.len++] = *String;
+
+        if (*String == u'\n') This->Mode->CursorRow++;
+        if (!host_console.echo || *String == u'\r') continue;
+
+        ascii[len++] = *String < 0x80 ? (char)*String : '?';
+        if (len == sizeof ascii - 1) {
+            ascii[len] = '\0';
+            host_printf("%s", ascii);
+            len = 0;
+        }
+    }
+    ascii[len] = '\0';
+    if (len) host_printf("%s", ascii);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_text_reset(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, BOOLEAN ExtendedVerification) {
+    (void)This, (void)ExtendedVerification;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_set_attribute(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, UINTN Attribute) {
+    This->Mode->Attribute = Attribute;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_clear_screen(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This) {
+    This->Mode->CursorRow = This->Mode->CursorColumn = 0;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_set_cursor_position(EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This, UINTN Column, UINTN Row) {
+    This->Mode->CursorColumn = Column;
+    This->Mode->CursorRow = Row;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_input_reset(EFI_SIMPLE_TEXT_INPUT_PROTOCOL *This, BOOLEAN ExtendedVerification) {
+    (void)This, (void)ExtendedVerification;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_read_key_stroke(EFI_SIMPLE_TEXT_INPUT_PROTOCOL *This, EFI_INPUT_KEY *Key) {
+    (void)This;
+    Key->ScanCode = 0;
+    Key->UnicodeChar = host_keys && *host_keys ? *host_keys++ : u'\r';
+    return EFI_SUCCESS;
+}
+
+EFI_TPL EFIAPI host_raise_tpl(EFI_TPL NewTpl) {
+    if (host_raise_hook && host_tpl == TPL_APPLICATION) {
+        host_tpl = TPL_CALLBACK;    // Hook runs as a callback, so it does not call itself
+        host_raise_hook();
+        host_tpl = TPL_APPLICATION;
+    }
+
+    EFI_TPL old_tpl = host_tpl;
+    host_tpl = NewTpl;
+    return old_tpl;
+}
+
+VOID EFIAPI host_restore_tpl(EFI_TPL OldTpl) {
+    host_tpl = OldTpl;
+}
+
+EFI_STATUS EFIAPI host_allocate_pool(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer) {
+    (void)PoolType;
+    *Buffer = host_alloc(Size, 8);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_free_pool(VOID *Buffer) {
+    host_free(Buffer);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_allocate_pages(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType,
+                                      UINTN Pages, EFI_PHYSICAL_ADDRESS *Memory) {
+    (void)MemoryType;
+    if (Type != AllocateAnyPages) return EFI_UNSUPPORTED;   // Host addresses can not be chosen
+
+    UINT8 *pages = host_alloc(Pages * PAGE_SIZE, PAGE_SIZE);
+    memset_bytes(pages, host_page_fill, Pages * PAGE_SIZE);
+    *Memory = (EFI_PHYSICAL_ADDRESS)pages;
+    host_pages_in_use += Pages;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_free_pages(EFI_PHYSICAL_ADDRESS Memory, UINTN Pages) {
+    host_free((VOID *)Memory);
+    host_pages_in_use -= Pages;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_create_event(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                    VOID *NotifyContext, EFI_EVENT *Event) {
+    (void)Type, (void)NotifyTpl, (void)NotifyFunction, (void)NotifyContext;
+    *Event = host_alloc(1, 8);  // Only used as a unique handle
+    host_open_events++;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_close_event(EFI_EVENT Event) {
+    host_free(Event);
+    host_open_events--;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_set_timer(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime) {
+    (void)Event, (void)Type, (void)TriggerTime;
+    return EFI_SUCCESS;     // Timers never fire on the host
+}
+
+VOID host_disk_complete(EFI_EVENT event);
+
+EFI_STATUS EFIAPI host_wait_for_event(UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index) {
+    for (UINTN i = 0; i < NumberOfEvents; i++) host_disk_complete(Event[i]);
+    if (host_wait_hook)
+        for (UINTN i = 0; i < NumberOfEvents; i++) host_wait_hook(Event[i]);
+    *Index = 0;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_stall(UINTN Microseconds) {
+    double end = host_seconds() + (Microseconds * 1e-6);
+    while (host_seconds() < end) ;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_get_memory_map(UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap,
+                                      UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion) {
+    *DescriptorSize = host_memory_map_desc_size;
+    *DescriptorVersion = 1;
+    *MapKey = 0;
+    if (*MemoryMapSize < host_memory_map_size) {
+        *MemoryMapSize = host_memory_map_size;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *MemoryMapSize = host_memory_map_size;
+    memcpy(MemoryMap, host_memory_map, host_memory_map_size);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_locate_protocol(EFI_GUID *Protocol, VOID *Registration, VOID **Interface) {
+    (void)Registration;
+    EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+    if (!host_gop || memcmp(Protocol, &gop_guid, sizeof gop_guid)) return EFI_NOT_FOUND;
+    *Interface = host_gop;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_file_open(EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle,
+                                 CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes);
+
+EFI_STATUS EFIAPI host_file_close(EFI_FILE_PROTOCOL *This) {
+    if (((Host_Open_File *)This)->file) host_free(This);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_file_read(EFI_FILE_PROTOCOL *This, UINTN *BufferSize, VOID *Buffer) {
+    Host_Open_File *open = (Host_Open_File *)This;
+    if (!open->file) return EFI_UNSUPPORTED;    // No directory listings
+
+    UINTN left = open->position < open->file->size ? open->file->size - open->position : 0;
+    if (*BufferSize > left) *BufferSize = left;
+    memcpy_bytes(Buffer, (UINT8 *)open->file->data + open->position, *BufferSize);
+    open->position += *BufferSize;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_file_get_position(EFI_FILE_PROTOCOL *This, UINT64 *Position) {
+    *Position = ((Host_Open_File *)This)->position;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_file_set_position(EFI_FILE_PROTOCOL *This, UINT64 Position) {
+    ((Host_Open_File *)This)->position = Position;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_file_get_info(EFI_FILE_PROTOCOL *This, EFI_GUID *InformationType,
+                                     UINTN *BufferSize, VOID *Buffer) {
+    (void)InformationType;
+    Host_Open_File *open = (Host_Open_File *)This;
+    if (*BufferSize < sizeof(EFI_FILE_INFO)) {
+        *BufferSize = sizeof(EFI_FILE_INFO);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+
+    EFI_FILE_INFO *info = Buffer;
+    *info = (EFI_FILE_INFO){ .Size = sizeof *info };
+    info->FileSize = info->PhysicalSize = open->file ? open->file->size : 0;
+    return EFI_SUCCESS;
+}
+
+Host_Open_File host_esp_root = {
+    .proto = {
+        .Open        = host_file_open,
+        .Close       = host_file_close,
+        .Read        = host_file_read,
+        .GetPosition = host_file_get_position,
+        .SetPosition = host_file_set_position,
+        .GetInfo     = host_file_get_info,
+    },
+};
+
+EFI_STATUS EFIAPI host_file_open(EFI_FILE_PROTOCOL *This, EFI_FILE_PROTOCOL **NewHandle,
+                                 CHAR16 *FileName, UINT64 OpenMode, UINT64 Attributes) {
+    (void)This, (void)OpenMode, (void)Attributes;
+    for (UINTN i = 0; i < ARRAY_SIZE(host_esp_files); i++) {
+        Host_File *file = &host_esp_files[i];
+        if (!file->path || !file->data || strncmp_u16(file->path, FileName, strlen_c16(file->path) + 1)) continue;
+
+        Host_Open_File *open = host_alloc(sizeof *open, 8);
+        *open = (Host_Open_File){ .proto = host_esp_root.proto, .file = file };
+        *NewHandle = &open->proto;
+        return EFI_SUCCESS;
+    }
+    return EFI_NOT_FOUND;
+}
+
+// Block IO or Disk IO transfer between a fake disk and buffer; block_size is 1 for 
+//   Disk IO, which has no size or alignment requirements
+EFI_STATUS host_disk_transfer(Host_Disk *disk, bool write, UINT64 offset, UINTN size, 
+                              VOID *buffer, UINTN block_size) {
+    if (size % block_size) return EFI_DEVICE_ERROR;    // Block IO: not a whole # of blocks
+    if (offset > disk->size || size > disk->size - offset) return EFI_INVALID_PARAMETER;
+
+    if (block_size > 1) {
+        if (size > disk->max_transfer) disk->max_transfer = size;
+        if (disk->media.IoAlign > 1 && ((UINTN)buffer % disk->media.IoAlign)) disk->misaligned++;
+    }
+
+    if (write) {
+        disk->writes++;
+        disk->bytes_written += size;
+        memcpy_bytes(disk->data + offset, buffer, size);
+
+        UINT64 page = max(offset, disk->corrupt_start);
+        page = (page + (PAGE_SIZE-1)) & ~((UINT64)PAGE_SIZE-1);
+        for (; page < offset + size && page < disk->corrupt_end; page += PAGE_SIZE)
+            disk->data[page] ^= 1;
+    } else 
+        memcpy_bytes(buffer, disk->data + offset, size);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_read_blocks(EFI_BLOCK_IO_PROTOCOL *This, UINT32 MediaId, EFI_LBA Lba,
+                                   UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, bio);
+    disk->block_reads++;
+    return host_disk_transfer(disk, false, Lba * disk->media.BlockSize, BufferSize, Buffer, 
+                              disk->media.BlockSize);
+}
+
+EFI_STATUS EFIAPI host_write_blocks(EFI_BLOCK_IO_PROTOCOL *This, UINT32 MediaId, EFI_LBA Lba,
+                                    UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, bio);
+    return host_disk_transfer(disk, true, Lba * disk->media.BlockSize, BufferSize, Buffer, 
+                              disk->media.BlockSize);
+}
+
+EFI_STATUS EFIAPI host_flush_blocks(EFI_BLOCK_IO_PROTOCOL *This) {
+    (void)This;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI host_read_disk(EFI_DISK_IO_PROTOCOL *This, UINT32 MediaId, UINT64 Offset,
+                                 UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, dio);
+    disk->disk_reads++;
+    return host_disk_transfer(disk, false, Offset, BufferSize, Buffer, 1);
+}
+
+EFI_STATUS EFIAPI host_write_disk(EFI_DISK_IO_PROTOCOL *This, UINT32 MediaId, UINT64 Offset,
+                                  UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    return host_disk_transfer(HOST_DISK(This, dio), true, Offset, BufferSize, Buffer, 1);
+}
+
+// =================================================================
+// Queue an async transfer for a Disk IO 2 / Block IO 2 token; a NULL
+//   token is a sync transfer
+// =================================================================
+EFI_STATUS host_disk_queue(Host_Disk *disk, bool write, UINT64 offset, UINTN size, VOID *buffer,
+                           UINTN block_size, EFI_EVENT event, EFI_STATUS *status) {
+    if (!event) return host_disk_transfer(disk, write, offset, size, buffer, block_size);
+    if (size % block_size) return EFI_DEVICE_ERROR;
+    if (offset > disk->size || size > disk->size - offset) return EFI_INVALID_PARAMETER;
+
+    for (UINTN i = 0; i < ARRAY_SIZE(host_disk_ops); i++) {
+        if (host_disk_ops[i].live) continue;
+
+        host_disk_ops[i] = (Host_Disk_Op){ true, event, disk, write, offset, size, buffer, status };
+        disk->async_ops++;
+        if (++disk->in_flight > disk->max_in_flight) disk->max_in_flight = disk->in_flight;
+        return EFI_SUCCESS;
+    }
+    return EFI_DEVICE_ERROR;    // Too many in flight for the fake device
+}
+
+// =================================================================
+// Finish the queued async transfer for an event, if any
+// =================================================================
+VOID host_disk_complete(EFI_EVENT event) {
+    for (UINTN i = 0; i < ARRAY_SIZE(host_disk_ops); i++) {
+        Host_Disk_Op *op = &host_disk_ops[i];
+        if (!op->live || op->event != event) continue;
+
+        *op->status = op->disk->async_status;
+        if (!EFI_ERROR(*op->status))
+            *op->status = host_disk_transfer(op->disk, op->write, op->offset, op->size, op->buffer, 1);
+        op->disk->in_flight--;
+        op->live = false;
+    }
+}
+
+EFI_STATUS EFIAPI host_read_disk_ex(EFI_DISK_IO2_PROTOCOL *This, UINT32 MediaId, UINT64 Offset,
+                                    EFI_DISK_IO2_TOKEN *Token, UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, dio2);
+    disk->disk_reads++;
+    return host_disk_queue(disk, false, Offset, BufferSize, Buffer, 1,
+                           Token ? Token->Event : NULL, Token ? &Token->TransactionStatus : NULL);
+}
+
+EFI_STATUS EFIAPI host_read_blocks_ex(EFI_BLOCK_IO2_PROTOCOL *This, UINT32 MediaId, EFI_LBA LBA,
+                                      EFI_BLOCK_IO2_TOKEN *Token, UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, bio2);
+    disk->block_reads++;
+    return host_disk_queue(disk, false, LBA * disk->media.BlockSize, BufferSize, Buffer,
+                           disk->media.BlockSize, Token ? Token->Event : NULL,
+                           Token ? &Token->TransactionStatus : NULL);
+}
+
+EFI_STATUS EFIAPI host_write_blocks_ex(EFI_BLOCK_IO2_PROTOCOL *This, UINT32 MediaId, EFI_LBA LBA,
+                                       EFI_BLOCK_IO2_TOKEN *Token, UINTN BufferSize, VOID *Buffer) {
+    (void)MediaId;
+    Host_Disk *disk = HOST_DISK(This, bio2);
+    return host_disk_queue(disk, true, LBA * disk->media.BlockSize, BufferSize, Buffer,
+                           disk->media.BlockSize, Token ? Token->Event : NULL,
+                           Token ? &Token->TransactionStatus : NULL);
+}
+
+// =================================================================
+// Set up a fake disk over size bytes of data, and a Disk_Info for it
+//   with Block IO & Disk IO, as build_disk_table() would
+// =================================================================
+void host_disk_init(Host_Disk *disk, Disk_Info *info, VOID *data, UINT64 size, UINT32 block_size) {
+    *disk = (Host_Disk){
+        .bio = {
+            .Media       = &disk->media,
+            .ReadBlocks  = host_read_blocks,
+            .WriteBlocks = host_write_blocks,
+            .FlushBlocks = host_flush_blocks,
+        },
+        .dio = {
+            .ReadDisk  = host_read_disk,
+            .WriteDisk = host_write_disk,
+        },
+        .media = {
+            .MediaPresent = true,
+            .BlockSize    = block_size,
+            .LastBlock    = (size / block_size) - 1,
+        },
+        .data = data,
+        .size = size,
+    };
+
+    *info = (Disk_Info){
+        .biop       = &disk->bio,
+        .diop       = &disk->dio,
+        .block_size = block_size,
+        .last_block = disk->media.LastBlock,
+    };
+}
+
+// =================================================================
+// Add async Disk IO 2 & Block IO 2 to a fake disk from host_disk_init()
+// =================================================================
+void host_disk_init_async(Host_Disk *disk, Disk_Info *info) {
+    disk->dio2 = (EFI_DISK_IO2_PROTOCOL){ .ReadDiskEx = host_read_disk_ex };
+    disk->bio2 = (EFI_BLOCK_IO2_PROTOCOL){
+        .Media         = &disk->media,
+        .ReadBlocksEx  = host_read_blocks_ex,
+        .WriteBlocksEx = host_write_blocks_ex,
+    };
+    info->diop2 = &disk->dio2;
+    info->biop2 = &disk->bio2;
+}
+
+// ---------------------
+// System table
+// ---------------------
+SIMPLE_TEXT_OUTPUT_MODE host_text_mode = { .MaxMode = 1 };
+
+EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL host_cout = {
+    .Reset             = host_text_reset,
+    .OutputString      = host_output_string,
+    .SetAttribute      = host_set_attribute,
+    .ClearScreen       = host_clear_screen,
+    .SetCursorPosition = host_set_cursor_position,
+    .Mode              = &host_text_mode,
+};
+
+EFI_SIMPLE_TEXT_INPUT_PROTOCOL host_cin = {
+    .Reset         = host_input_reset,
+    .ReadKeyStroke = host_read_key_stroke,
+};
+
+EFI_BOOT_SERVICES host_bs = {
+    .RaiseTPL       = host_raise_tpl,
+    .RestoreTPL     = host_restore_tpl,
+    .AllocatePages  = host_allocate_pages,
+    .FreePages      = host_free_pages,
+    .AllocatePool   = host_allocate_pool,
+    .FreePool       = host_free_pool,
+    .CreateEvent    = host_create_event,
+    .SetTimer       = host_set_timer,
+    .WaitForEvent   = host_wait_for_event,
+    .CloseEvent     = host_close_event,
+    .Stall          = host_stall,
+    .GetMemoryMap   = host_get_memory_map,
+    .LocateProtocol = host_locate_protocol,
+};
+
+EFI_RUNTIME_SERVICES host_rs = {0};
+
+EFI_SYSTEM_TABLE host_st = {
+    .ConIn           = &host_cin,
+    .ConOut          = &host_cout,
+    .StdErr          = &host_cout,
+    .RuntimeServices = &host_rs,
+    .BootServices    = &host_bs,
+};
+
+// =================================================================
+// Set efi_lib.h globals to the stub system table & ESP; text_rows is
+//   big enough that printing never stops to wait for a key
+// =================================================================
+void host_efi_init(void) {
+    init_global_variables(NULL, &host_st);
+    esp_root = &host_esp_root.proto;
+    text_rows = 1000000;
+    text_cols = 200;
+}
+
+// =================================================================
+// Count a failed check, and print where it is
+// Returns: ok
+// =================================================================
+bool host_check(bool ok, const char *what, const char *file, int line) {
+    if (!ok) {
+        host_failures++;
+        host_printf("%s:%d: CHECK(%s) failed\n", file, line, what);
+    }
+    return ok;
+}
+#define CHECK(cond) host_check((cond), #cond, __FILE__, __LINE__)
+
+// =================================================================
+// Print PASS/FAIL line for a test program
+// Returns: exit status for main()
+// =================================================================
+int host_report(const char *name) {
+    flush_c16(cout);
+    host_printf("%s %s", host_failures ? "FAIL" : "PASS", name);
+    if (host_failures) host_printf(" (%llu failed checks)", (unsigned long long)host_failures);
+    host_printf("\n");
+    return host_failures != 0;
+}
@@ -0,0 +1,40 @@
+//
+// mkfileidx.c: Generate FILE.IDX from FILE.TXT, using the same FILE.TXT parser as
+//   the bootloader so the 2 can not disagree. Copy the result to /EFI/BOOT/ in the ESP
+//   next to FILE.TXT; the makefile's ADD_KERNEL does both when building the disk image.
+//
+// Usage: host/mkfileidx FILE.TXT FILE.IDX
+//
+#include "host_efi.h"
+#include "file_index.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        host_printf("Usage: %s FILE.TXT FILE.IDX\n", argv[0]);
+        return 2;
+    }
+
+    host_efi_init();
+
+    UINT64 txt_size = 0;
+    VOID *txt = host_read_file(argv[1], &txt_size);
+    if (!txt) {
+        host_printf("Could not read '%s'\n", argv[1]);
+        return 1;
+    }
+    host_esp_files[0] = (Host_File){ u"\\EFI\\BOOT\\FILE.TXT", txt, txt_size };
+
+    if (!build_data_file_index()) return 1;
+
+    UINTN idx_size = 0;
+    VOID *idx = make_file_index(txt, txt_size, &idx_size);
+    if (!host_write_file(argv[2], idx, idx_size)) {
+        host_printf("Could not write '%s'\n", argv[2]);
+        return 1;
+    }
+
+    host_printf("Wrote %s: %llu files, disk size %llu\n", argv[2], 
+                (unsigned long long)data_file_index.num_entries, 
+                (unsigned long long)data_file_index.disk_size);
+    return 0;
+}
@@ -0,0 +1,127 @@
+//
+// test_console.c: Host tests for console output buffering in efi_lib.h: output
+//   order across flushes & oversized strings, timer callbacks that print
+//   while write_c16() is appending, and paged dumps that only flush per page.
+//
+#include "host_efi.h"
+
+CHAR16 expected[64 * 1024];
+UINTN expected_len = 0;
+
+// =================================================================
+// Append a string to the expected console output
+// =================================================================
+void expect(CHAR16 *str) {
+    for (; *str; str++) expected[expected_len++] = *str;
+}
+
+// =================================================================
+// Flush stdout and check captured output against the expected output
+// =================================================================
+void check_output(const char *what) {
+    flush_c16(cout);
+    bool ok = host_console.len == expected_len &&
+              !memcmp(host_console.text, expected, expected_len * sizeof *expected);
+    if (!CHECK(ok))
+        host_printf("  %s: got %llu CHAR16s, want %llu\n", what,
+                    (unsigned long long)host_console.len, (unsigned long long)expected_len);
+
+    host_console.len = expected_len = 0;
+}
+
+// Printed by the fake timer callback, like print_datetime() printing the clock
+CHAR16 callback_text[41];
+
+void print_from_callback(void) {
+    host_raise_hook = NULL;     // Fire once
+    printf_c16(u"%s", callback_text);
+    expect(callback_text);
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+    host_console.capture = true;
+
+    // Many small writes across several buffer flushes, then a string larger
+    //   than the buffer, stay in order
+    CHAR16 num[32];
+    for (UINTN i = 0; i < 5000; i++) {
+        printf_c16(u"%u,", i);
+        sprintf_c16(num, u"%u,", i);
+        expect(num);
+    }
+
+    CHAR16 big[CONSOLE_BUF_LEN + 1000];
+    for (UINTN i = 0; i < ARRAY_SIZE(big) - 1; i++) big[i] = u'x';
+    big[ARRAY_SIZE(big) - 1] = u'\0';
+    write_c16(cout, big, ARRAY_SIZE(big) - 1);     // printf_c16() truncates at 1023 CHAR16s
+    expect(big);
+    printf_c16(u"END");
+    expect(u"END");
+
+    UINTN calls = host_console.output_calls;
+    check_output("ordered output");
+    CHECK(calls < 5000 / 50);   // Buffered, not 1 OutputString() per printf_c16()
+
+    // A callback that prints right as write_c16() raises the TPL, when the
+    //   buffer is almost full: 2000 + 20 fits, 2000 + 40 from the callback fits,
+    //   but then 2040 + 20 does not. The space check must see the callback's
+    //   text, so the buffer is flushed instead of written past its end
+    for (UINTN i = 0; i < ARRAY_SIZE(callback_text) - 1; i++) callback_text[i] = u'c';
+    callback_text[ARRAY_SIZE(callback_text) - 1] = u'\0';
+
+    CHAR16 fill[CONSOLE_BUF_LEN - 48 + 1];
+    for (UINTN i = 0; i < ARRAY_SIZE(fill) - 1; i++) fill[i] = u'f';
+    fill[ARRAY_SIZE(fill) - 1] = u'\0';
+    write_c16(cout, fill, ARRAY_SIZE(fill) - 1);
+    expect(fill);
+
+    host_raise_hook = print_from_callback;
+    printf_c16(u"main text 20 chars..");
+    expect(u"main text 20 chars..");
+    CHECK(host_raise_hook == NULL);
+
+    Console_Buffer *cb = console_buffer(cout);
+    CHECK(cb->len <= CONSOLE_BUF_LEN);
+    check_output("callback during write");
+
+    CHECK(host_tpl == TPL_APPLICATION);
+
+    // Paged dump of a 200 descriptor memory map on a 25 row screen: pauses when the
+    //   rows written plus buffered reach the bottom, after the header & 22 lines then
+    //   every 23 lines, and only flushes to wait for a key, not once per line
+    EFI_MEMORY_DESCRIPTOR descs[200] = {0};
+    for (UINTN i = 0; i < ARRAY_SIZE(descs); i++) 
+        descs[i] = (EFI_MEMORY_DESCRIPTOR){ .Type = EfiBootServicesData, .PhysicalStart = i * PAGE_SIZE,
+                                            .NumberOfPages = 1, .Attribute = EFI_MEMORY_WB };
+    host_memory_map = descs;
+    host_memory_map_size = sizeof descs;
+    text_rows = 25;
+
+    host_console.len = 0;
+    calls = host_console.output_calls;
+    bs->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, NULL, NULL, &timer_event);
+    print_memory_map();
+
+    UINTN pauses = 0, row = 0, max_row = 0;
+    CHAR16 *pause = u"Press any key to continue...";
+    for (UINTN i = 0; i < host_console.len; i++) {
+        if (i + 28 <= host_console.len && !memcmp(host_console.text + i, pause, 28 * sizeof *pause)) {
+            CHECK(row == 23);       // Only the pause line follows on the last 2 rows
+            pauses++;
+            row = 0;                // Screen cleared after the key
+            i += 29;                // Past the pause line's "\r\n"
+            continue;
+        }
+        if (host_console.text[i] == u'\n') row++;
+        max_row = max(max_row, row);
+    }
+    calls = host_console.output_calls - calls;
+    if (!CHECK(pauses == 8 && max_row <= 24 && calls <= pauses + 2))
+        host_printf("  paged dump: %llu pauses, %llu rows, %llu OutputString() calls\n",
+                    (unsigned long long)pauses, (unsigned long long)max_row, (unsigned long long)calls);
+    host_console.len = 0;
+
+    return host_report("test_console");
+}
@@ -0,0 +1,159 @@
+//
+// test_copy_disk.c: Host tests for copy_disk(): a 512B block disk copied to a 4KiB
+//   block disk with blocking Block IO or async Block IO 2 on either side, for
+//   sizes that are not whole blocks or chunks, and chunk sizes that are not
+//   whole blocks. Sparse & delta copies only write the chunks that differ, and
+//   verifying catches writes that land corrupted.
+//
+#include "host_efi.h"
+
+#define DISK_SIZE (34 * 1024 * 1024)
+
+UINT8 *src_data, *dst_data;
+Host_Disk src_disk, dst_disk;
+Disk_Info src, dst;
+
+// =================================================================
+// Set up both disks, with Block IO 2 on the source if bit 0 of
+//   async is set, and on the target if bit 1 is set
+// =================================================================
+VOID init_disks(UINTN async) {
+    host_disk_init(&src_disk, &src, src_data, DISK_SIZE, 512);
+    host_disk_init(&dst_disk, &dst, dst_data, DISK_SIZE, 4096);
+    if (async & 1) host_disk_init_async(&src_disk, &src);
+    if (async & 2) host_disk_init_async(&dst_disk, &dst);
+}
+
+// =================================================================
+// Fill disk data with a position dependent pattern
+// =================================================================
+VOID fill_pattern(UINT8 *buf, UINTN size, UINT8 seed) {
+    for (UINTN i = 0; i < size; i++) buf[i] = (UINT8)((i * 31) + (i >> 11) + seed);
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+
+    src_data = host_alloc(DISK_SIZE, PAGE_SIZE);
+    dst_data = host_alloc(DISK_SIZE, PAGE_SIZE);
+
+    const UINT64 sizes[]  = { 1, 4096, (3 << 20) + 513, (33 << 20) + 5000 };
+    const UINTN  chunks[] = { DISK_COPY_CHUNK_SIZE, 1, 4096, 100000, 1 << 20 };
+
+    // Full copies: target matches up to the size rounded up to its block size
+    //   and is untouched after, with no events or transfers left behind
+    for (UINTN async = 0; async < 4; async++) {
+        for (UINTN i = 0; i < ARRAY_SIZE(sizes); i++) {
+            for (UINTN j = 0; j < ARRAY_SIZE(chunks); j++) {
+                UINT64 size     = sizes[i];
+                UINT64 rounded  = (size + 4095) & ~4095ULL;
+                fill_pattern(src_data, rounded, (UINT8)(i + j));
+                memset(dst_data, 0xEE, rounded + 1);
+                init_disks(async);
+
+                EFI_STATUS status = copy_disk(&src, &dst, size, chunks[j], DISK_COPY_FULL, false);
+                bool ok = CHECK(!EFI_ERROR(status)) &
+                          CHECK(!memcmp(dst_data, src_data, rounded) && dst_data[rounded] == 0xEE) &
+                          CHECK(src_disk.misaligned == 0 && dst_disk.misaligned == 0) &
+                          CHECK(src_disk.in_flight == 0 && dst_disk.in_flight == 0) &
+                          CHECK(host_open_events == 0 && host_pages_in_use == 0);
+
+                // Async reads run ahead of the writes, in chunks rounded up to blocks
+                if (async & 1 && rounded > 2 * ((chunks[j] + 4095) & ~4095ULL))
+                    ok &= CHECK(src_disk.max_in_flight > 1);
+                if (!ok)
+                    host_printf("  async %llu, size %llu, chunk %llu\n", (unsigned long long)async,
+                                (unsigned long long)size, (unsigned long long)chunks[j]);
+            }
+        }
+    }
+
+    // Sparse copy to a zeroed target skips the all zero chunks in [4MiB, 12MiB), and
+    //   delta copy to a target that differs in 2 bytes only writes their 2 chunks.
+    //   The last chunk is only 1 block, the 1st byte is not zero in any chunk
+    const UINT64 size = (20 << 20) + 4096;
+    for (UINTN async = 0; async < 4; async++) {
+        for (Disk_Copy_Mode mode = DISK_COPY_SPARSE; mode <= DISK_COPY_DELTA; mode++) {
+            fill_pattern(src_data, size, 1);
+            for (UINT64 i = 0; i < size; i += 1 << 20) src_data[i] = 1;
+            memset(src_data + (4 << 20), 0, 8 << 20);
+
+            if (mode == DISK_COPY_SPARSE)
+                memset(dst_data, 0, size);
+            else {
+                memcpy(dst_data, src_data, size);
+                dst_data[(2 << 20) + 5] ^= 1;
+                dst_data[size - 1] ^= 0x80;
+            }
+            init_disks(async);
+
+            EFI_STATUS status = copy_disk(&src, &dst, size, 1 << 20, mode, false);
+            UINT64 want = mode == DISK_COPY_SPARSE ? size - (8 << 20) : (1 << 20) + 4096;
+            bool ok = CHECK(!EFI_ERROR(status)) &
+                      CHECK(!memcmp(dst_data, src_data, size)) &
+                      CHECK(dst_disk.bytes_written == want) &
+                      CHECK(host_open_events == 0 && host_pages_in_use == 0);
+            if (!ok)
+                host_printf("  async %llu, %s\n", (unsigned long long)async,
+                            mode == DISK_COPY_SPARSE ? "sparse" : "delta");
+        }
+    }
+
+    // CRC32 check value, and CRCs continued across split buffers at odd addresses
+    CHECK(crc32_update(0, "123456789", 9) == 0xCBF43926);
+    CHECK(crc32_update(0, "", 0) == 0);
+    fill_pattern(src_data, 1000, 3);
+    CHECK(crc32_update(crc32_update(0, src_data + 3, 123), src_data + 126, 877) ==
+          crc32_update(0, src_data + 3, 1000));
+
+    // Verified copies pass, unless writes are corrupted anywhere in the copy:
+    //   within 1 chunk, across chunks, or only in the last partial chunk
+    const UINT64 verify_size = (10 << 20) + 100;
+    const struct { UINT64 start, end; } corrupt[] = {
+        { 0, 0 },
+        { (1 << 20) + (3 * 4096), (1 << 20) + (4 * 4096) },
+        { (1 << 20) + (3 * 4096), (3 << 20) - (7 * 4096) },
+        { 10 << 20, 11 << 20 },
+    };
+    for (UINTN async = 0; async < 4; async++) {
+        for (UINTN i = 0; i < ARRAY_SIZE(corrupt); i++) {
+            fill_pattern(src_data, verify_size + 4096, 0);
+            memset(dst_data, 0, verify_size + 4096);
+            init_disks(async);
+            dst_disk.corrupt_start = corrupt[i].start;
+            dst_disk.corrupt_end   = corrupt[i].end;
+
+            EFI_STATUS status = copy_disk(&src, &dst, verify_size, 1 << 20, DISK_COPY_FULL, true);
+            bool ok = CHECK(status == (i == 0 ? EFI_SUCCESS : EFI_CRC_ERROR)) &
+                      CHECK(src_disk.in_flight == 0 && dst_disk.in_flight == 0) &
+                      CHECK(host_open_events == 0 && host_pages_in_use == 0);
+            if (!ok)
+                host_printf("  async %llu, corrupt %llu-%llu\n", (unsigned long long)async,
+                            (unsigned long long)corrupt[i].start, (unsigned long long)corrupt[i].end);
+        }
+    }
+
+    // Verified sparse copy also checks the skipped zero chunks on the target
+    fill_pattern(src_data, 4 << 20, 0);
+    memset(src_data + (1 << 20), 0, 2 << 20);
+    memset(dst_data, 0, 4 << 20);
+    dst_data[(2 << 20) + 10] = 1;   // Not zeroed, so the skipped chunk is wrong
+    init_disks(3);
+    CHECK(copy_disk(&src, &dst, 4 << 20, 1 << 20, DISK_COPY_SPARSE, true) == EFI_CRC_ERROR);
+    dst_data[(2 << 20) + 10] = 0;
+    CHECK(!EFI_ERROR(copy_disk(&src, &dst, 4 << 20, 1 << 20, DISK_COPY_SPARSE, true)));
+
+    // A failed read or write is returned, and buffers & events are still freed
+    fill_pattern(src_data, 8 << 20, 0);
+    for (UINTN async = 0; async < 4; async++) {
+        init_disks(async);
+        src_disk.async_status = EFI_DEVICE_ERROR;
+        src_disk.size = 5 << 20;                        // Sync reads past the end fail
+        CHECK(EFI_ERROR(copy_disk(&src, &dst, 8 << 20, 1 << 20, DISK_COPY_FULL, false)));
+        CHECK(src_disk.in_flight == 0 && dst_disk.in_flight == 0);
+        CHECK(host_open_events == 0 && host_pages_in_use == 0);
+    }
+
+    return host_report("test_copy_disk");
+}
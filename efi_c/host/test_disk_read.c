@@ -0,0 +1,94 @@
+//
+// test_disk_read.c: Host tests for disk_read() & the async Disk IO 2 read queue, built
+//   with DISK_READ_ASYNC on since the async path is off by default.
+//
+#define DISK_READ_ASYNC 1
+#include "host_efi.h"
+
+#define DISK_SIZE (32 * 1024 * 1024)
+
+// =================================================================
+// Fill disk data with a position dependent pattern
+// =================================================================
+VOID fill_pattern(UINT8 *buf, UINTN size) {
+    for (UINTN i = 0; i < size; i++) buf[i] = (UINT8)((i * 13) + (i >> 9));
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+
+    UINT8 *data = host_alloc(DISK_SIZE, PAGE_SIZE);
+    fill_pattern(data, DISK_SIZE);
+
+    Host_Disk disk;
+    Disk_Info info;
+    host_disk_init(&disk, &info, data, DISK_SIZE, 512);
+    host_disk_init_async(&disk, &info);
+
+    // Queued read larger than the whole queue: returns with reads still in flight, waits
+    //   only for the oldest read when all tokens are busy, and is complete after
+    //   disk_read_queue_wait()
+    const UINT64 offset = 4096 + 7;
+    const UINTN size = (DISK_READ_QUEUE_LEN + 3) * DISK_READ_CHUNK_SIZE + 100;
+    UINT8 *buf = host_alloc(size, PAGE_SIZE);
+    memset(buf, 0xEE, size);
+
+    Disk_Read_Queue queue = {0};
+    CHECK(!EFI_ERROR(disk_read(&info, offset, size, buf, &queue)));
+    CHECK(disk.in_flight == DISK_READ_QUEUE_LEN);
+    CHECK(disk.max_in_flight == DISK_READ_QUEUE_LEN);
+    CHECK(buf[size - 1] == 0xEE);       // Last chunk not read until waited on
+    CHECK(!memcmp(buf, data + offset, DISK_READ_CHUNK_SIZE));   // Oldest chunks were waited on
+
+    CHECK(!EFI_ERROR(disk_read_queue_wait(&queue)));
+    CHECK(disk.in_flight == 0);
+    CHECK(disk.async_ops == DISK_READ_QUEUE_LEN + 4);
+    CHECK(!memcmp(buf, data + offset, size));
+    CHECK(host_open_events == 0);
+
+    // Queue is reusable after waiting
+    memset(buf, 0xEE, size);
+    CHECK(!EFI_ERROR(disk_read(&info, 0, 1000, buf, &queue)));
+    CHECK(!EFI_ERROR(disk_read(&info, 1000, 5000, buf + 1000, &queue)));
+    CHECK(!EFI_ERROR(disk_read_queue_wait(&queue)));
+    CHECK(!memcmp(buf, data, 6000) && buf[6000] == 0xEE);
+    CHECK(host_open_events == 0);
+
+    // A failed queued read is returned by disk_read_queue_wait(), and the queue
+    //   is still emptied & its events closed
+    disk.async_status = EFI_DEVICE_ERROR;
+    CHECK(!EFI_ERROR(disk_read(&info, 0, 3 * DISK_READ_CHUNK_SIZE, buf, &queue)));
+    CHECK(disk_read_queue_wait(&queue) == EFI_DEVICE_ERROR);
+    CHECK(disk.in_flight == 0 && host_open_events == 0);
+    disk.async_status = EFI_SUCCESS;
+
+    // Errors starting a read are returned right away
+    CHECK(EFI_ERROR(disk_read(&info, DISK_SIZE - 10, 20, buf, &queue)));
+    disk_read_queue_wait(&queue);
+
+    // Without a queue, or without Disk IO 2, reads are sync
+    UINTN async_ops = disk.async_ops;
+    memset(buf, 0xEE, size);
+    CHECK(!EFI_ERROR(disk_read(&info, offset, 3 * DISK_READ_CHUNK_SIZE, buf, NULL)));
+    CHECK(!memcmp(buf, data + offset, 3 * DISK_READ_CHUNK_SIZE));
+
+    info.diop2 = NULL;
+    memset(buf, 0xEE, size);
+    CHECK(!EFI_ERROR(disk_read(&info, offset, 3 * DISK_READ_CHUNK_SIZE, buf, &queue)));
+    CHECK(!memcmp(buf, data + offset, 3 * DISK_READ_CHUNK_SIZE));
+    CHECK(!EFI_ERROR(disk_read_queue_wait(&queue)));
+    CHECK(disk.async_ops == async_ops);
+
+    // Data partition file reads through the queue land at the file's LBA
+    host_disk_init_async(&disk, &info);
+    disk_table = (Disk_Table){ .image_disk = &info, .built = true };
+    Data_File_Entry file = { "ter-132n.psf", 2048, 3 * DISK_READ_CHUNK_SIZE };
+    memset(buf, 0xEE, size);
+    CHECK(!EFI_ERROR(read_data_partition_file(&file, 100, file.file_size - 100, buf, &queue)));
+    CHECK(!EFI_ERROR(disk_read_queue_wait(&queue)));
+    CHECK(!memcmp(buf, data + (2048 * 512) + 100, file.file_size - 100));
+    CHECK(disk.async_ops > async_ops);
+
+    return host_report("test_disk_read");
+}
@@ -0,0 +1,144 @@
+//
+// test_file_index.c: Host tests for the data partition file index: FILE.TXT parsing,
+//   generating FILE.IDX from it, loading FILE.IDX in place, and falling back to
+//   FILE.TXT when FILE.IDX is missing, invalid, or generated from a different FILE.TXT.
+//
+#include "host_efi.h"
+#include "file_index.h"
+
+// Worked example from the Data_File_Index comment in efi_lib.h
+char file_txt[] =
+    "DISK_SIZE=52428800\r\n"
+    "FILE_NAME=kernel.elf\r\n"
+    "FILE_SIZE=12345\r\n"
+    "DISK_LBA=2048\r\n"
+    "FILE_NAME=ter-132n.psf\r\n"
+    "FILE_SIZE=8992\r\n"
+    "DISK_LBA=2073\r\n";
+
+Host_File *txt_file = &host_esp_files[0];
+Host_File *idx_file = &host_esp_files[1];
+
+// =================================================================
+// Check lookups against the worked example, with the index rebuilt
+//   from whatever files are in the stub ESP
+// =================================================================
+void check_example_index(const char *what) {
+    free_data_file_index();
+    host_console.len = 0;
+
+    Data_File_Entry *kernel = find_data_file("kernel");     // Prefix match
+    Data_File_Entry *font   = find_data_file("ter-132n.psf");
+    bool ok = CHECK(kernel && !strncmp(kernel->name, "kernel.elf", DATA_FILE_NAME_LEN) &&
+                    kernel->disk_lba == 2048 && kernel->file_size == 12345) &
+              CHECK(font && font->disk_lba == 2073 && font->file_size == 8992) &
+              CHECK(!find_data_file("kernel.elf2") && !find_data_file("a") && !find_data_file("zzz")) &
+              CHECK(data_file_index.num_entries == 2 && data_file_index.disk_size == 52428800);
+    if (!ok) host_printf("  %s\n", what);
+}
+
+// =================================================================
+// Read a little endian UINT64 at offset in a byte buffer
+// =================================================================
+UINT64 get_u64(UINT8 *buf, UINTN offset) {
+    UINT64 value = 0;
+    for (UINTN i = 8; i > 0; i--) value = (value << 8) | buf[offset + i - 1];
+    return value;
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+    host_console.capture = true;
+
+    // FILE.TXT only: a missing FILE.IDX is not an error, nothing is printed
+    *txt_file = (Host_File){ u"\\EFI\\BOOT\\FILE.TXT", file_txt, sizeof file_txt - 1 };
+    *idx_file = (Host_File){ u"\\EFI\\BOOT\\FILE.IDX", NULL, 0 };
+    check_example_index("from FILE.TXT");
+    flush_c16(cout);
+    CHECK(host_console.len == 0);
+
+    // Generated FILE.IDX matches the worked example's layout byte for byte
+    UINTN idx_size = 0;
+    UINT8 *idx = make_file_index(file_txt, sizeof file_txt - 1, &idx_size);
+    CHECK(idx_size == 184);
+    CHECK(!memcmp(idx, "FILEIDX2", 8));
+    CHECK(get_u64(idx, 0x08) == 52428800 && get_u64(idx, 0x10) == 2);
+    CHECK(get_u64(idx, 0x18) == sizeof file_txt - 1 &&
+          get_u64(idx, 0x20) == crc32_update(0, file_txt, sizeof file_txt - 1));
+    CHECK(!strncmp((char *)idx + 0x28, "kernel.elf", DATA_FILE_NAME_LEN) && idx[0x28 + 10] == 0);
+    CHECK(get_u64(idx, 0x60) == 2048 && get_u64(idx, 0x68) == 12345);
+    CHECK(!strncmp((char *)idx + 0x70, "ter-132n.psf", DATA_FILE_NAME_LEN));
+    CHECK(get_u64(idx, 0xA8) == 2073 && get_u64(idx, 0xB0) == 8992);
+
+    // FILE.IDX matching FILE.TXT: used in place, FILE.TXT is not parsed
+    *idx_file = (Host_File){ u"\\EFI\\BOOT\\FILE.IDX", idx, idx_size };
+    check_example_index("from FILE.IDX");
+    CHECK(data_file_index.buffer &&
+          (UINT8 *)data_file_index.entries == (UINT8 *)data_file_index.buffer + sizeof(Data_File_Index_Header));
+    flush_c16(cout);
+    CHECK(host_console.len == 0);
+
+    // FILE.IDX without FILE.TXT can not be checked: no index
+    txt_file->data = NULL;
+    free_data_file_index();
+    CHECK(!find_data_file("kernel"));
+    txt_file->data = file_txt;
+
+    // FILE.IDX left over from an older disk image, with files since moved: FILE.TXT 
+    //   differs in content only, or in size too, so FILE.TXT is used with an error
+    char moved_txt[] = 
+        "DISK_SIZE=52428800\r\n"
+        "FILE_NAME=kernel.elf\r\n"
+        "FILE_SIZE=12345\r\n"
+        "DISK_LBA=2049\r\n";
+    txt_file->data = moved_txt;
+    txt_file->size = sizeof moved_txt - 1;
+    free_data_file_index();
+    host_console.len = 0;
+    Data_File_Entry *kernel = find_data_file("kernel");
+    flush_c16(cout);
+    CHECK(kernel && kernel->disk_lba == 2049 && data_file_index.num_entries == 1);
+    CHECK(host_console.len > 0);
+
+    char edited_txt[sizeof file_txt];
+    memcpy(edited_txt, file_txt, sizeof file_txt);
+    edited_txt[sizeof file_txt - 4] = '4';      // DISK_LBA=2073 -> 2074, same size
+    txt_file->data = edited_txt;
+    txt_file->size = sizeof file_txt - 1;
+    free_data_file_index();
+    host_console.len = 0;
+    Data_File_Entry *font = find_data_file("ter-132n.psf");
+    flush_c16(cout);
+    CHECK(font && font->disk_lba == 2074);
+    CHECK(host_console.len > 0);
+
+    // Invalid FILE.IDX falls back to FILE.TXT with an error: bad magic, more entries
+    //   than fit in the file, and entries not sorted by name
+    txt_file->data = file_txt;
+    UINT8 *bad = host_alloc(idx_size, 8);
+    idx_file->data = bad;
+
+    memcpy(bad, idx, idx_size);
+    bad[0] = 'X';
+    check_example_index("bad magic");
+    CHECK(host_console.len > 0);
+
+    memcpy(bad, idx, idx_size);
+    bad[0x10] = 3;
+    check_example_index("truncated");
+    CHECK(host_console.len > 0);
+
+    memcpy(bad, idx, idx_size);
+    memcpy(bad + 0x28, idx + 0x70, sizeof(Data_File_Entry));
+    memcpy(bad + 0x70, idx + 0x28, sizeof(Data_File_Entry));
+    check_example_index("unsorted");
+    CHECK(host_console.len > 0);
+
+    // Neither file: no index
+    free_data_file_index();
+    txt_file->data = idx_file->data = NULL;
+    CHECK(!find_data_file("kernel"));
+
+    return host_report("test_file_index");
+}
@@ -0,0 +1,276 @@
+//
+// test_loaders.c: Host tests that load_elf(), load_elf_from_disk() & load_pe() build
+//   byte for byte the same image as the original loaders, which zeroed the whole
+//   image and then copied segments/sections over it. New pages are filled with
+//   0xAA like stale memory, so any byte the new loaders neither copy nor zero shows up.
+//
+#include "host_efi.h"
+
+// =================================================================
+// Original load_elf(): zero all memory needed, then copy each
+//   loadable segment's file data
+// =================================================================
+VOID *reference_load_elf(VOID *elf_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_size) {
+    ELF_Header_64 *ehdr = elf_buffer;
+    if (ehdr->e_type != ET_DYN) return NULL;
+
+    UINTN mem_min = 0;
+    UINTN max_memory_needed = elf_memory_bounds(ehdr, &mem_min);
+
+    EFI_PHYSICAL_ADDRESS program_buffer = 0;
+    UINTN pages_needed = (max_memory_needed + (PAGE_SIZE-1)) / PAGE_SIZE;
+    if (EFI_ERROR(bs->AllocatePages(AllocateAnyPages, EfiLoaderCode, pages_needed, &program_buffer)))
+        return NULL;
+
+    memset((VOID *)program_buffer, 0, max_memory_needed);
+    *file_buffer = program_buffer;
+    *file_size   = pages_needed * PAGE_SIZE;
+
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)((UINT8 *)ehdr + ehdr->e_phoff);
+    for (UINT16 i = 0; i < ehdr->e_phnum; i++, phdr++) {
+        if (phdr->p_type != PT_LOAD) continue;
+
+        UINT8 *dst = (UINT8 *)program_buffer + (phdr->p_vaddr - mem_min);
+        UINT8 *src = (UINT8 *)elf_buffer + phdr->p_offset;
+        memcpy(dst, src, phdr->p_filesz);
+    }
+
+    return (UINT8 *)program_buffer + (ehdr->e_entry - mem_min);
+}
+
+// =================================================================
+// Original load_pe(): zero SizeOfImage bytes, then copy each
+//   section's raw data
+// =================================================================
+VOID *reference_load_pe(VOID *pe_buffer, EFI_PHYSICAL_ADDRESS *file_buffer, UINTN *file_size) {
+    UINT32 pe_sig_pos = *(UINT32 *)((UINT8 *)pe_buffer + 0x3C);
+    PE_Coff_File_Header_64 *coff_hdr = (PE_Coff_File_Header_64 *)((UINT8 *)pe_buffer + pe_sig_pos + 4);
+    PE_Optional_Header_64 *opt_hdr = (PE_Optional_Header_64 *)(coff_hdr + 1);
+
+    EFI_PHYSICAL_ADDRESS program_buffer = 0;
+    UINTN pages_needed = (opt_hdr->SizeOfImage + (PAGE_SIZE-1)) / PAGE_SIZE;
+    if (EFI_ERROR(bs->AllocatePages(AllocateAnyPages, EfiLoaderCode, pages_needed, &program_buffer)))
+        return NULL;
+
+    memset((VOID *)program_buffer, 0, opt_hdr->SizeOfImage);
+    *file_buffer = program_buffer;
+    *file_size   = pages_needed * PAGE_SIZE;
+
+    PE_Section_Header_64 *shdr =
+        (PE_Section_Header_64 *)((UINT8 *)opt_hdr + coff_hdr->SizeOfOptionalHeader);
+    for (UINT16 i = 0; i < coff_hdr->NumberOfSections; i++, shdr++) {
+        if (shdr->SizeOfRawData == 0) continue;
+        memcpy((UINT8 *)program_buffer + shdr->VirtualAddress,
+               (UINT8 *)pe_buffer + shdr->PointerToRawData, shdr->SizeOfRawData);
+    }
+
+    return (UINT8 *)program_buffer + opt_hdr->AddressOfEntryPoint;
+}
+
+// =================================================================
+// Fill a buffer with nonzero pseudo random bytes, so copied data is
+//   never mistaken for zero padding
+// =================================================================
+VOID fill_nonzero(UINT8 *buf, UINTN size, UINT32 seed) {
+    for (UINTN i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (UINT8)((seed >> 16) | 1);
+    }
+}
+
+// =================================================================
+// ELF64 PIE fixture at base vaddr: text at 0, a PT_DYNAMIC header
+//   that is not loaded, rodata after a gap with a small .bss tail,
+//   then data with a multi page .bss; segment offsets in the file
+//   are not page aligned
+// Returns: host_alloc()'d file & size
+// =================================================================
+UINT8 *make_elf_fixture(UINT64 base, UINTN *size) {
+    *size = 0x4000;
+    UINT8 *file = host_alloc(*size, 8);
+    fill_nonzero(file, *size, (UINT32)base + 1);
+
+    ELF_Header_64 *ehdr = (ELF_Header_64 *)file;
+    *ehdr = (ELF_Header_64){
+        .e_ident   = { 0x7F, 'E', 'L', 'F', 2, 1, 1 },
+        .e_type    = ET_DYN,
+        .e_entry   = base + 0x100,
+        .e_phoff   = sizeof *ehdr,
+        .e_ehsize  = sizeof *ehdr,
+        .e_phentsize = sizeof(ELF_Program_Header_64),
+        .e_phnum   = 4,
+    };
+
+    ELF_Program_Header_64 *phdr = (ELF_Program_Header_64 *)(file + ehdr->e_phoff);
+    phdr[0] = (ELF_Program_Header_64){ .p_type = PT_LOAD, .p_offset = 0, .p_vaddr = base,
+                                       .p_filesz = 0x1234, .p_memsz = 0x1234, .p_align = 0x1000 };
+    phdr[1] = (ELF_Program_Header_64){ .p_type = 2, .p_offset = 0x1300, .p_vaddr = base + 0x1300,
+                                       .p_filesz = 0x100, .p_memsz = 0x100, .p_align = 8 };
+    phdr[2] = (ELF_Program_Header_64){ .p_type = PT_LOAD, .p_offset = 0x2008, .p_vaddr = base + 0x3008,
+                                       .p_filesz = 0x7F0, .p_memsz = 0x900, .p_align = 0x1000 };
+    phdr[3] = (ELF_Program_Header_64){ .p_type = PT_LOAD, .p_offset = 0x3010, .p_vaddr = base + 0x5010,
+                                       .p_filesz = 0x300, .p_memsz = 0x4000, .p_align = 0x1000 };
+    return file;
+}
+
+// =================================================================
+// PE32+ PIE fixture: headers, then sections with VirtualSize less
+//   than, greater than, and without raw data, gaps between them, and
+//   SizeOfImage past the last section
+// Returns: host_alloc()'d file & size
+// =================================================================
+UINT8 *make_pe_fixture(UINTN *size) {
+    *size = 0x2000;
+    UINT8 *file = host_alloc(*size, 8);
+    fill_nonzero(file, *size, 42);
+
+    UINT32 pe_sig_pos = 0x80;
+    *(UINT32 *)(file + 0x3C) = pe_sig_pos;
+    memcpy(file + pe_sig_pos, "PE\0\0", 4);
+
+    PE_Coff_File_Header_64 *coff_hdr = (PE_Coff_File_Header_64 *)(file + pe_sig_pos + 4);
+    *coff_hdr = (PE_Coff_File_Header_64){
+        .Machine              = ARCH_COFF_MACHINE,
+        .NumberOfSections     = 4,
+        .SizeOfOptionalHeader = sizeof(PE_Optional_Header_64),
+        .Characteristics      = IMAGE_FILE_EXECUTABLE_IMAGE,
+    };
+
+    PE_Optional_Header_64 *opt_hdr = (PE_Optional_Header_64 *)(coff_hdr + 1);
+    *opt_hdr = (PE_Optional_Header_64){
+        .Magic               = 0x20B,
+        .AddressOfEntryPoint = 0x1010,
+        .SectionAlignment    = 0x1000,
+        .FileAlignment       = 0x200,
+        .SizeOfImage         = 0x9000,
+        .SizeOfHeaders       = 0x400,
+        .DllCharacteristics  = IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE,
+    };
+
+    PE_Section_Header_64 *shdr = (PE_Section_Header_64 *)(opt_hdr + 1);
+    shdr[0] = (PE_Section_Header_64){ .VirtualAddress = 0x1000, .VirtualSize = 0x11F0,
+                                      .PointerToRawData = 0x400, .SizeOfRawData = 0x1200 };
+    shdr[1] = (PE_Section_Header_64){ .VirtualAddress = 0x3000, .VirtualSize = 0x180,
+                                      .PointerToRawData = 0x1600, .SizeOfRawData = 0x200 };
+    shdr[2] = (PE_Section_Header_64){ .VirtualAddress = 0x4000, .VirtualSize = 0x1000,
+                                      .PointerToRawData = 0x1800, .SizeOfRawData = 0x200 };
+    shdr[3] = (PE_Section_Header_64){ .VirtualAddress = 0x6000, .VirtualSize = 0x800 };
+    return file;
+}
+
+// =================================================================
+// Check a loaded image against the reference loader's: same buffer
+//   size & entry point, the same image_size bytes, and the rest of
+//   the last page zeroed rather than left stale
+// =================================================================
+void check_same_image(const char *what, VOID *entry, EFI_PHYSICAL_ADDRESS buffer, UINTN size,
+                      VOID *ref_entry, EFI_PHYSICAL_ADDRESS ref_buffer, UINTN ref_size,
+                      UINTN image_size) {
+    bool ok = CHECK(entry && ref_entry) &&
+              CHECK(size == ref_size) &
+              CHECK((UINT8 *)entry - (UINT8 *)buffer == (UINT8 *)ref_entry - (UINT8 *)ref_buffer) &
+              CHECK(!memcmp_bytes((VOID *)buffer, (VOID *)ref_buffer, image_size)) &
+              CHECK(mem_is_zero((UINT8 *)buffer + image_size, size - image_size));
+    if (!ok) host_printf("  %s\n", what);
+}
+
+// =================================================================
+// Load an ELF fixture from memory & from a fake disk, and compare
+//   both with the reference loader
+// =================================================================
+void check_elf(const char *what, UINT8 *file, UINTN file_size) {
+    UINTN mem_min = 0;
+    UINTN image_size = elf_memory_bounds((ELF_Header_64 *)file, &mem_min);
+
+    EFI_PHYSICAL_ADDRESS ref_buffer = 0, buffer = 0;
+    UINTN ref_size = 0, size = 0;
+    VOID *ref_entry = reference_load_elf(file, &ref_buffer, &ref_size);
+    VOID *entry = load_elf(file, &buffer, &size);
+    check_same_image(what, entry, buffer, size, ref_entry, ref_buffer, ref_size, image_size);
+
+    // Same file at LBA 100 of the data partition's disk, headers from the 1st 4KiB
+    const UINT64 LBA = 100;
+    UINTN disk_size = ((LBA * 512) + file_size + 511) & ~511ULL;
+    UINT8 *disk_data = host_alloc(disk_size, 8);
+    memcpy(disk_data + (LBA * 512), file, file_size);
+
+    Host_Disk disk;
+    Disk_Info info;
+    host_disk_init(&disk, &info, disk_data, disk_size, 512);
+    disk_table = (Disk_Table){ .image_disk = &info, .built = true };
+
+    Data_File_Entry data_file = { "kernel.elf", LBA, file_size };
+    UINT8 hdr_buffer[PAGE_SIZE];
+    memcpy(hdr_buffer, file, min(file_size, sizeof hdr_buffer));
+
+    EFI_PHYSICAL_ADDRESS disk_buffer = 0;
+    UINTN disk_image_size = 0;
+    VOID *disk_entry = load_elf_from_disk(hdr_buffer, &data_file, NULL, &disk_buffer, &disk_image_size);
+    check_same_image(what, disk_entry, disk_buffer, disk_image_size, ref_entry, ref_buffer, ref_size,
+                     image_size);
+
+    disk_table = (Disk_Table){0};
+    host_free(disk_data);
+}
+
+// =================================================================
+// Check an invalid ELF file is rejected from memory & from disk before
+//   anything is allocated or written
+// =================================================================
+void check_bad_elf(const char *what, UINT8 *file, UINTN file_size) {
+    UINTN pages_in_use = host_pages_in_use;
+
+    const UINT64 LBA = 100;
+    UINTN disk_size = ((LBA * 512) + file_size + 511) & ~511ULL;
+    UINT8 *disk_data = host_alloc(disk_size, 8);
+    memcpy(disk_data + (LBA * 512), file, file_size);
+
+    Host_Disk disk;
+    Disk_Info info;
+    host_disk_init(&disk, &info, disk_data, disk_size, 512);
+    disk_table = (Disk_Table){ .image_disk = &info, .built = true };
+
+    Data_File_Entry data_file = { "kernel.elf", LBA, file_size };
+    EFI_PHYSICAL_ADDRESS buffer = 0, disk_buffer = 0;
+    UINTN size = 0, disk_image_size = 0;
+    bool ok = CHECK(!load_elf(file, &buffer, &size)) &
+              CHECK(!load_elf_from_disk(file, &data_file, NULL, &disk_buffer, &disk_image_size)) &
+              CHECK(disk.block_reads == 0 && host_pages_in_use == pages_in_use);
+    if (!ok) host_printf("  %s\n", what);
+
+    disk_table = (Disk_Table){0};
+    host_free(disk_data);
+}
+
+int main(void) {
+    host_efi_init();
+
+    UINTN size = 0;
+    UINT8 *elf = make_elf_fixture(0, &size);
+    check_elf("ELF fixture at vaddr 0", elf, size);
+
+    elf = make_elf_fixture(0x400000, &size);
+    check_elf("ELF fixture at vaddr 0x400000", elf, size);
+
+    // Segment with more file data than memory: p_memsz - p_filesz would wrap
+    host_console.echo = false;
+    elf = make_elf_fixture(0, &size);
+    ((ELF_Program_Header_64 *)(elf + sizeof(ELF_Header_64)))[2].p_memsz = 0x700;
+    check_bad_elf("p_filesz > p_memsz", elf, size);
+    host_console.echo = true;
+
+    // This program itself, if the host compiler made a PIE for this arch
+    UINT64 exe_size = 0;
+    ELF_Header_64 *exe = host_read_file("/proc/self/exe", &exe_size);
+    if (exe && exe->e_type == ET_DYN)
+        check_elf("/proc/self/exe", (UINT8 *)exe, exe_size);
+
+    UINT8 *pe = make_pe_fixture(&size);
+    EFI_PHYSICAL_ADDRESS ref_buffer = 0, buffer = 0;
+    UINTN ref_size = 0, buffer_size = 0;
+    VOID *ref_entry = reference_load_pe(pe, &ref_buffer, &ref_size);
+    VOID *entry = load_pe(pe, &buffer, &buffer_size);
+    check_same_image("PE fixture", entry, buffer, buffer_size, ref_entry, ref_buffer, ref_size, 0x9000);
+
+    return host_report("test_loaders");
+}
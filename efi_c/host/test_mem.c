@@ -0,0 +1,313 @@
+//
+// test_mem.c: Host tests for the strlen, strlen_c16, memcmp & mem_is_zero variants in efi_lib.h,
+//   memcpy/memset with each Mem_Method, overlapping memmove both ways, and fb_scroll_rows().
+//   Strings and buffers are placed to end right before an unmapped guard page, so
+//   any read past the NULL terminator or past len bytes faults instead of passing.
+//
+#include "host_efi.h"
+
+#define MAX_LEN 300
+
+typedef struct { char *name; UINTN (*func)(char *); } Strlen_Func;
+typedef struct { char *name; UINTN (*func)(CHAR16 *); } Strlen_C16_Func;
+typedef struct { char *name; INTN (*func)(VOID *, VOID *, UINTN); } Memcmp_Func;
+typedef struct { char *name; bool (*func)(VOID *, UINTN); } Mem_Is_Zero_Func;
+typedef struct { char *name; VOID *(*func)(VOID *, VOID *, UINTN); } Memmove_Func;
+
+Strlen_Func strlen_funcs[] = {
+    { "strlen_bytes", strlen_bytes },
+    { "strlen_words", strlen_words },
+#ifdef MEM_VEC_SIZE
+    { "strlen_vec",   strlen_vec   },
+#endif
+    { "strlen",       strlen       },
+};
+
+Strlen_C16_Func strlen_c16_funcs[] = {
+    { "strlen_c16_chars", strlen_c16_chars },
+    { "strlen_c16_words", strlen_c16_words },
+#ifdef MEM_VEC_SIZE
+    { "strlen_c16_vec",   strlen_c16_vec   },
+#endif
+    { "strlen_c16",       strlen_c16       },
+};
+
+Memcmp_Func memcmp_funcs[] = {
+    { "memcmp_bytes", memcmp_bytes },
+    { "memcmp_words", memcmp_words },
+#ifdef MEM_VEC_SIZE
+    { "memcmp_vec",   memcmp_vec   },
+#endif
+    { "memcmp",       memcmp       },
+};
+
+Mem_Is_Zero_Func mem_is_zero_funcs[] = {
+    { "mem_is_zero_words", mem_is_zero_words },
+#ifdef MEM_VEC_SIZE
+    { "mem_is_zero_vec",   mem_is_zero_vec   },
+#endif
+    { "mem_is_zero",       mem_is_zero       },
+};
+
+// Copies that may overlap with dst below src, and with dst above src
+Memmove_Func forward_funcs[] = {
+    { "memcpy_words", memcpy_words },
+#ifdef MEM_VEC_SIZE
+    { "memcpy_vec",   memcpy_vec   },
+#endif
+    { "memcpy_wide",  memcpy_wide  },
+    { "memmove",      memmove      },
+};
+
+Memmove_Func back_funcs[] = {
+    { "memmove_back_words", memmove_back_words },
+#ifdef MEM_VEC_SIZE
+    { "memmove_back_vec",   memmove_back_vec   },
+#endif
+    { "memmove",            memmove            },
+};
+
+const Mem_Method mem_methods[] = { MEM_METHOD_BYTES, MEM_METHOD_WIDE, MEM_METHOD_ERMS, MEM_METHOD_FSRM };
+
+// Lengths for copies: every small length, and around the vector loop sizes & MEM_REP_THRESHOLD
+const UINTN copy_lens[] = { 255, 256, 257, MEM_REP_THRESHOLD - 1, MEM_REP_THRESHOLD,
+                            MEM_REP_THRESHOLD + 1, (3 * MEM_REP_THRESHOLD) + 13, 20000 };
+#define SMALL_COPY_LEN 200
+#define NUM_COPY_LENS  (SMALL_COPY_LEN + ARRAY_SIZE(copy_lens))
+#define COPY_PAGES     8
+
+UINT8 want[COPY_PAGES * PAGE_SIZE];
+
+// =================================================================
+// Get the ith copy length to test
+// =================================================================
+UINTN copy_len(UINTN i) {
+    return i < SMALL_COPY_LEN ? i : copy_lens[i - SMALL_COPY_LEN];
+}
+
+// =================================================================
+// Position dependent byte pattern, that repeats only every 251 bytes
+// =================================================================
+UINT8 pattern(UINTN i) {
+    return (UINT8)((i % 251) + 1);
+}
+
+// =================================================================
+// Copy len bytes within buf from src_off to dst_off with func, and
+//   check that exactly dst is changed, to the original src bytes
+// =================================================================
+void check_move(Memmove_Func *f, UINT8 *buf, UINTN buf_len, UINTN dst_off, UINTN src_off, UINTN len) {
+    for (UINTN i = 0; i < buf_len; i++) buf[i] = want[i] = pattern(i);
+    for (UINTN i = 0; i < len; i++) want[dst_off + i] = pattern(src_off + i);
+
+    VOID *ret = f->func(buf + dst_off, buf + src_off, len);
+    if (!CHECK(ret == buf + dst_off && !memcmp_bytes(buf, want, buf_len)))
+        host_printf("  %s: dst +%llu, src +%llu, len %llu\n", f->name, (unsigned long long)dst_off,
+                    (unsigned long long)src_off, (unsigned long long)len);
+}
+
+// =================================================================
+// Check a strlen result, naming the function & length on failure
+// =================================================================
+void check_len(const char *name, UINTN got, UINTN want) {
+    if (!CHECK(got == want))
+        host_printf("  %s: got %llu, want %llu\n", name,
+                    (unsigned long long)got, (unsigned long long)want);
+}
+
+// =================================================================
+// Check that memcmp result has the same sign as the expected unsigned
+//   byte difference (0 if equal)
+// =================================================================
+void check_cmp(const char *name, INTN got, INTN want, UINTN len, UINTN diff_at) {
+    bool ok = (got == 0 && want == 0) || (got < 0 && want < 0) || (got > 0 && want > 0);
+    if (!CHECK(ok))
+        host_printf("  %s: len %llu, differs at %llu: got %lld, want %lld\n", name,
+                    (unsigned long long)len, (unsigned long long)diff_at,
+                    (long long)got, (long long)want);
+}
+
+int main(void) {
+    host_efi_init();
+
+    UINT8 *guard1 = host_guard_pages(1);    // 1 page, then a guard page
+    UINT8 *guard2 = host_guard_pages(1);
+    UINT8 *page_end1 = guard1 + PAGE_SIZE;
+    UINT8 *page_end2 = guard2 + PAGE_SIZE;
+
+    // ASCII strings of every length with the NULL terminator as the last byte
+    //   before the guard page, so every start alignment is covered too
+    for (UINTN len = 0; len < MAX_LEN; len++) {
+        char *s = (char *)page_end1 - len - 1;
+        for (UINTN i = 0; i < len; i++) s[i] = 'a' + (i % 26);
+        s[len] = '\0';
+
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_funcs); j++)
+            check_len(strlen_funcs[j].name, strlen_funcs[j].func(s), len);
+    }
+
+    // High bit characters must not look like NULLs to the word/vector zero checks
+    {
+        char *s = (char *)page_end1 - 40;
+        for (UINTN i = 0; i < 39; i++) s[i] = (char)(0x80 + i);
+        s[39] = '\0';
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_funcs); j++)
+            check_len(strlen_funcs[j].name, strlen_funcs[j].func(s), 39);
+    }
+
+    // CHAR16 strings ending at the guard page; characters have a 0 low byte, so
+    //   only a full 16 bit zero ends the string
+    for (UINTN len = 0; len < MAX_LEN; len++) {
+        CHAR16 *s = (CHAR16 *)page_end1 - len - 1;
+        for (UINTN i = 0; i < len; i++) s[i] = (CHAR16)(0x100 * (1 + (i % 0xFF)));
+        s[len] = u'\0';
+
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_c16_funcs); j++)
+            check_len(strlen_c16_funcs[j].name, strlen_c16_funcs[j].func(s), len);
+    }
+
+    // Odd address CHAR16 strings ending at the guard page
+    for (UINTN len = 0; len < 40; len++) {
+        CHAR16 *s = (CHAR16 *)(page_end1 - 1) - len - 1;
+        for (UINTN i = 0; i < len; i++) s[i] = (CHAR16)(u'A' + (i % 26));
+        s[len] = u'\0';
+
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_c16_funcs); j++)
+            check_len(strlen_c16_funcs[j].name, strlen_c16_funcs[j].func(s), len);
+    }
+
+    // Mixed zero/nonzero bytes within each CHAR16
+    {
+        CHAR16 *s = (CHAR16 *)page_end1 - 5;
+        s[0] = 0x4100, s[1] = 0x0041, s[2] = 0x0100, s[3] = u'\0', s[4] = u'X';
+        for (UINTN j = 0; j < ARRAY_SIZE(strlen_c16_funcs); j++)
+            check_len(strlen_c16_funcs[j].name, strlen_c16_funcs[j].func(s), 3);
+    }
+
+    // memcmp: both buffers end at their own guard page, each length from 0, with
+    //   no difference or a single smaller/larger byte at every position
+    for (UINTN len = 0; len < MAX_LEN; len++) {
+        UINT8 *a = page_end1 - len;
+        UINT8 *b = page_end2 - len;
+
+        for (UINTN d = 0; d <= len; d++) {
+            for (INTN sign = -1; sign <= 1; sign += 2) {
+                for (UINTN i = 0; i < len; i++) a[i] = b[i] = (UINT8)(i * 7 + 0x80);
+                INTN want = 0;
+                if (d < len) {
+                    b[d] = (UINT8)(a[d] - sign);     // Wraps around at 0x00/0xFF
+                    want = (INTN)a[d] - (INTN)b[d];
+                }
+
+                for (UINTN j = 0; j < ARRAY_SIZE(memcmp_funcs); j++)
+                    check_cmp(memcmp_funcs[j].name, memcmp_funcs[j].func(a, b, len), want, len, d);
+            }
+        }
+    }
+
+    // memcmp: differing bytes past len are not compared, and the first
+    //   difference wins over later ones
+    {
+        UINT8 *a = page_end1 - 64;
+        UINT8 *b = page_end2 - 64;
+        for (UINTN i = 0; i < 64; i++) a[i] = b[i] = (UINT8)i;
+        a[40] = 0xFF;
+        b[50] = 0xFF;
+        for (UINTN j = 0; j < ARRAY_SIZE(memcmp_funcs); j++) {
+            check_cmp(memcmp_funcs[j].name, memcmp_funcs[j].func(a, b, 40), 0, 40, 40);
+            check_cmp(memcmp_funcs[j].name, memcmp_funcs[j].func(a, b, 64), 1, 64, 40);
+        }
+    }
+
+    // mem_is_zero: zero buffers ending at the guard page with nonzero bytes right
+    //   before them, then a single nonzero byte at every position
+    for (UINTN len = 0; len < MAX_LEN; len++) {
+        UINT8 *m = page_end1 - len;
+        memset(page_end1 - MAX_LEN - 1, 0xFF, MAX_LEN + 1);
+        memset(m, 0, len);
+
+        for (UINTN d = 0; d <= len; d++) {
+            if (d < len) m[d] = 0x80;
+            for (UINTN j = 0; j < ARRAY_SIZE(mem_is_zero_funcs); j++) {
+                if (!CHECK(mem_is_zero_funcs[j].func(m, len) == (d == len)))
+                    host_printf("  %s: len %llu, nonzero at %llu\n", mem_is_zero_funcs[j].name,
+                                (unsigned long long)len, (unsigned long long)d);
+            }
+            if (d < len) m[d] = 0;
+        }
+    }
+
+    // Overlapping copies both ways, from every small length to past MEM_REP_THRESHOLD,
+    //   with the higher buffer ending at the guard page; shifts below a word, vector
+    //   or 4 vectors overlap the loads & stores of 1 loop, and larger ones don't overlap
+    UINT8 *copy_end = host_guard_pages(COPY_PAGES) + (COPY_PAGES * PAGE_SIZE);
+    const UINTN shifts[] = { 1, 2, 7, 8, 9, 15, 16, 17, 63, 64, 65, 1000 };
+    for (UINTN i = 0; i < NUM_COPY_LENS; i++) {
+        UINTN len = copy_len(i);
+        for (UINTN k = 0; k < ARRAY_SIZE(shifts); k++) {
+            UINTN buf_len = len + shifts[k];
+            UINT8 *buf = copy_end - buf_len;
+            for (UINTN j = 0; j < ARRAY_SIZE(forward_funcs); j++) 
+                check_move(&forward_funcs[j], buf, buf_len, 0, shifts[k], len);
+            for (UINTN j = 0; j < ARRAY_SIZE(back_funcs); j++) 
+                check_move(&back_funcs[j], buf, buf_len, shifts[k], 0, len);
+        }
+    }
+
+    // memcpy, memset & non overlapping memmove with each method, including REP MOVSB/STOSB 
+    //   below & above MEM_REP_THRESHOLD: dst ends at a guard page, bytes before it are 
+    //   untouched, and src at every alignment ends at the other guard page
+    UINT8 *copy_end2 = host_guard_pages(COPY_PAGES) + (COPY_PAGES * PAGE_SIZE);
+    const Mem_Method saved_method = mem_method;
+    for (UINTN m = 0; m < ARRAY_SIZE(mem_methods); m++) {
+        mem_method = mem_methods[m];
+        Memmove_Func copy_funcs[] = { { "memcpy", memcpy }, { "memmove", memmove } };
+
+        for (UINTN i = 0; i < NUM_COPY_LENS; i++) {
+            UINTN len = copy_len(i);
+            UINT8 *dst = copy_end - len;
+            for (UINTN k = 0; k < 3; k++) {
+                UINT8 *src = copy_end2 - len - k;
+                for (UINTN j = 0; j < len; j++) src[j] = pattern(j + k);
+
+                for (UINTN f = 0; f < ARRAY_SIZE(copy_funcs); f++) {
+                    dst[-1] = 0xEE;
+                    memset_bytes(dst, 0, len);
+                    VOID *ret = copy_funcs[f].func(dst, src, len);
+                    if (!CHECK(ret == dst && !memcmp_bytes(dst, src, len) && dst[-1] == 0xEE))
+                        host_printf("  %s, method %d: len %llu, src +%llu\n", copy_funcs[f].name,
+                                    (int)mem_method, (unsigned long long)len, (unsigned long long)k);
+                }
+            }
+
+            dst[-1] = 0xEE;
+            memset_bytes(dst, 0, len);
+            bool ok = memset(dst, 0xA5, len) == dst && dst[-1] == 0xEE;
+            for (UINTN j = 0; j < len; j++) ok &= dst[j] == 0xA5;
+            if (!CHECK(ok))
+                host_printf("  memset, method %d: len %llu\n", (int)mem_method, (unsigned long long)len);
+        }
+    }
+    mem_method = saved_method;
+
+    // fb_scroll_rows(): rows move up by whole pitches and the bottom rows are filled,
+    //   including scrolling by the whole height or more, which only fills
+    {
+        const UINT32 pitch = 37, height = 50, color = 0x00123456;
+        const UINT32 scrolls[] = { 0, 1, 3, height - 1, height, height + 7 };
+        UINT32 *fb = (UINT32 *)copy_end - ((UINTN)pitch * height);
+        for (UINTN k = 0; k < ARRAY_SIZE(scrolls); k++) {
+            for (UINTN i = 0; i < (UINTN)pitch * height; i++) fb[i] = (UINT32)i;
+            fb_scroll_rows(fb, pitch, height, scrolls[k], color);
+
+            UINTN moved = (UINTN)pitch * (height - min(scrolls[k], height));
+            bool ok = true;
+            for (UINTN i = 0; i < (UINTN)pitch * height; i++) 
+                ok &= fb[i] == (i < moved ? (UINT32)(i + ((UINTN)pitch * scrolls[k])) : color);
+            if (!CHECK(ok))
+                host_printf("  fb_scroll_rows: %u rows of %u\n", scrolls[k], height);
+        }
+    }
+
+    return host_report("test_mem");
+}
@@ -0,0 +1,497 @@
+//
+// test_page_tables.c: Host tests for building the x86_64 page tables in host memory:
+//   identity mapping a random memory map with large pages, and arch_map_range()
+//   for unaligned, higher half & partly mapped ranges, with all tables coming from
+//   the pool sized by arch_page_tables_needed(), a write-combining framebuffer
+//   mapped before the memory map, access from the memory attributes table rather
+//   than the memory map's XP & RO, and effective memory types. The tables are only
+//   walked with page_table_lookup(), never loaded, so this runs as a normal process.
+//
+#include "host_efi.h"
+
+#if defined(__x86_64__)
+
+#define MAX_DESCS     1024
+#define DESC_SIZE     48            // Larger than EFI_MEMORY_DESCRIPTOR, like real firmware
+#define SPARE_PAGES   (64 * 1024)   // Conventional memory for mmap_allocate_pages()
+
+UINT8 descs[MAX_DESCS][DESC_SIZE];
+Memory_Map_Info mmap = { .map = (EFI_MEMORY_DESCRIPTOR *)descs, .desc_size = DESC_SIZE };
+UINT8 *spare = NULL;
+
+// Entry flags for boot services data: writable, user, not executable, write-back
+UINT64 data_flags = PRESENT | READWRITE | USER;
+
+// =================================================================
+// Deterministic pseudo random numbers (xorshift64)
+// =================================================================
+UINT64 rand_state = 0x9E3779B97F4A7C15ULL;
+
+UINT64 rand_next(UINT64 limit) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return limit ? rand_state % limit : 0;
+}
+
+// =================================================================
+// Append a memory descriptor to the test memory map
+// =================================================================
+VOID add_desc(UINT32 type, UINT64 start, UINT64 pages, UINT64 attribute) {
+    EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)descs[mmap.size / DESC_SIZE];
+    *desc = (EFI_MEMORY_DESCRIPTOR){
+        .Type = type, .PhysicalStart = start, .NumberOfPages = pages, .Attribute = attribute,
+    };
+    mmap.size += DESC_SIZE;
+}
+
+// =================================================================
+// Start the test memory map with a reserved page at 0, then the
+//   spare conventional memory in host memory, as mmap_allocate_pages()
+//   starts at descriptor 1
+// =================================================================
+VOID spare_mmap(void) {
+    mmap.size = 0;
+    add_desc(EfiReservedMemoryType, 0, 1, 0);
+    add_desc(EfiConventionalMemory, (UINTN)spare, SPARE_PAGES, EFI_MEMORY_WB);
+}
+
+// =================================================================
+// Build a memory map of n boot services data descriptors from 4KiB
+//   up, of random sizes (some up to max_pages) with random gaps,
+//   after spare_mmap()
+// Returns: end address of the last descriptor
+// =================================================================
+UINT64 random_mmap(UINTN n, UINT64 max_pages) {
+    spare_mmap();
+
+    UINT64 address = PAGE_SIZE;
+    for (UINTN i = 0; i < n; i++) {
+        UINT64 pages = rand_next(5) == 0 ? rand_next(max_pages) : rand_next(700);
+        if (rand_next(4) == 0) address += rand_next(3000) * PAGE_SIZE;
+        add_desc(EfiBootServicesData, address, max(pages, 1), EFI_MEMORY_WB);
+        address += max(pages, 1) * PAGE_SIZE;
+    }
+    return address;
+}
+
+// =================================================================
+// Start new page tables for the test memory map
+// =================================================================
+VOID new_page_tables(void) {
+    arch_set_page_table_pool(NULL, 0);
+    arch_init_page_tables(&mmap);
+}
+
+// =================================================================
+// Check that [start, end) is identity mapped with flags, by pages
+//   that do not extend outside of it
+// =================================================================
+bool check_identity_mapped(UINT64 start, UINT64 end, UINT64 flags) {
+    for (UINT64 address = start; address < end; ) {
+        UINT64 physical_address = 0, page_size = 0, entry_flags = 0;
+        if (!page_table_lookup(pml4, address, &physical_address, &page_size, &entry_flags) ||
+            physical_address != address || entry_flags != flags) {
+            host_printf("  %llx in [%llx, %llx): not mapped as expected\n", (unsigned long long)address,
+                        (unsigned long long)start, (unsigned long long)end);
+            return false;
+        }
+
+        UINT64 page_start = address & ~(page_size-1);
+        if (page_start < start || page_start + page_size > end) {
+            host_printf("  %llx: %llu byte page extends outside [%llx, %llx)\n", (unsigned long long)address,
+                        (unsigned long long)page_size, (unsigned long long)start, (unsigned long long)end);
+            return false;
+        }
+        address = page_start + page_size;
+    }
+    return true;
+}
+
+// =================================================================
+// Check that no page in [start, end) is mapped
+// =================================================================
+bool check_unmapped(UINT64 start, UINT64 end) {
+    for (UINT64 address = start; address < end; address += PAGE_SIZE) {
+        UINT64 physical_address = 0, page_size = 0, flags = 0;
+        if (page_table_lookup(pml4, address, &physical_address, &page_size, &flags)) {
+            host_printf("  %llx: mapped in gap [%llx, %llx)\n", (unsigned long long)address,
+                        (unsigned long long)start, (unsigned long long)end);
+            return false;
+        }
+    }
+    return true;
+}
+
+// =================================================================
+// Check that each 4KiB page of [virtual_address, +length) maps to
+//   physical_address + its offset with flags, in pages of page_size
+// =================================================================
+bool check_mapped(UINT64 virtual_address, UINT64 physical_address, UINT64 length,
+                  UINT64 page_size, UINT64 flags) {
+    for (UINT64 offset = 0; offset < length; offset += PAGE_SIZE) {
+        UINT64 got_address = 0, got_size = 0, got_flags = 0;
+        if (!page_table_lookup(pml4, virtual_address + offset, &got_address, &got_size, &got_flags) ||
+            got_address != physical_address + offset || got_size != page_size || got_flags != flags) {
+            host_printf("  %llx: want %llx, %llu byte page, flags %llx; got %llx, %llu, %llx\n",
+                        (unsigned long long)(virtual_address + offset),
+                        (unsigned long long)(physical_address + offset),
+                        (unsigned long long)page_size, (unsigned long long)flags,
+                        (unsigned long long)got_address, (unsigned long long)got_size,
+                        (unsigned long long)got_flags);
+            return false;
+        }
+    }
+    return true;
+}
+
+// =================================================================
+// Get the page size an address is mapped with, or 0 if unmapped
+// =================================================================
+UINT64 mapped_page_size(UINT64 address) {
+    UINT64 physical_address = 0, page_size = 0, flags = 0;
+    return page_table_lookup(pml4, address, &physical_address, &page_size, &flags) ? page_size : 0;
+}
+
+// =================================================================
+// Identity map random memory maps: every descriptor is mapped, the
+//   gaps between them are not, and large pages are used where aligned
+// =================================================================
+VOID test_identity_map(void) {
+    for (UINTN run = 0; run < 4; run++) {
+        UINT64 top = random_mmap(300, run & 1 ? 600000 : 3000);
+
+        // 2GiB + 8KiB at a 1GiB boundary: 1GiB (or 2MiB) pages, then 4KiB at the end
+        UINT64 big = (top + 2*PAGE_SIZE_1G) & ~(PAGE_SIZE_1G-1);
+        add_desc(EfiBootServicesData, big, (2*PAGE_SIZE_1G + 8192) / PAGE_SIZE, EFI_MEMORY_WB);
+        top = big + 2*PAGE_SIZE_1G + 8192;
+
+        new_page_tables();
+        identity_map_efi_mmap(&mmap);
+
+        // Descriptor ranges in address order, after the reserved page at 0 & spare memory
+        UINTN i = 2, start = 0, end = 0;
+        UINT64 map_flags = 0, prev_end = PAGE_SIZE;
+        bool ok = true;
+        while (ok && next_mmap_range(&mmap, &i, &start, &end, &map_flags)) {
+            ok = CHECK(check_unmapped(prev_end, start)) &
+                 CHECK(check_identity_mapped(start, end, data_flags));
+            prev_end = end;
+        }
+        ok &= CHECK(check_unmapped(prev_end, prev_end + PAGE_SIZE_2M));
+        ok &= CHECK(check_identity_mapped((UINTN)spare, (UINTN)spare + SPARE_PAGES * PAGE_SIZE, data_flags));
+
+        ok &= CHECK(mapped_page_size(big) == arch_max_page_size());
+        ok &= CHECK(mapped_page_size(big + PAGE_SIZE_1G + PAGE_SIZE_2M) >= PAGE_SIZE_2M);
+        ok &= CHECK(mapped_page_size(top - PAGE_SIZE) == PAGE_SIZE);
+        if (!ok) host_printf("  identity map run %llu\n", (unsigned long long)run);
+    }
+
+    // Contiguous descriptors are mapped as 1 range, so large pages can span them
+    spare_mmap();
+    add_desc(EfiBootServicesData, PAGE_SIZE_1G, 100, EFI_MEMORY_WB);
+    add_desc(EfiBootServicesData, PAGE_SIZE_1G + (100 * PAGE_SIZE),
+             (PAGE_SIZE_2M / PAGE_SIZE) - 100, EFI_MEMORY_WB);
+    new_page_tables();
+    identity_map_efi_mmap(&mmap);
+    CHECK(mapped_page_size(PAGE_SIZE_1G) == PAGE_SIZE_2M);
+}
+
+// =================================================================
+// Count the page tables reachable from a table at a level (0 = PML4),
+//   and how many of them are outside of [pool_start, pool_end)
+// =================================================================
+VOID count_tables(Page_Table *table, UINTN level, UINT64 pool_start, UINT64 pool_end,
+                  UINTN *tables, UINTN *outside) {
+    (*tables)++;
+    if ((UINT64)table < pool_start || (UINT64)table >= pool_end) (*outside)++;
+    if (level == 3) return;
+
+    for (UINTN i = 0; i < 512; i++) {
+        UINT64 entry = table->entries[i];
+        if ((entry & PRESENT) && !(level > 0 && (entry & LARGE_PAGE)))
+            count_tables((Page_Table *)(entry & PHYS_PAGE_ADDR_MASK), level+1,
+                         pool_start, pool_end, tables, outside);
+    }
+}
+
+// =================================================================
+// The page table pool reserved by arch_page_tables_needed() is enough
+//   for identity mapping random memory maps, with no tables taken from
+//   the memory map outside of it, and per range estimates are upper
+//   bounds. A pool set up front is zeroed and used instead.
+// =================================================================
+VOID test_page_table_pool(void) {
+    for (UINTN run = 0; run < 20; run++) {
+        random_mmap(50 + rand_next(400), run & 1 ? 600000 : 3000);
+
+        UINT64 needed = arch_page_tables_needed(&mmap);
+        Page_Table *pool = host_alloc(needed * PAGE_SIZE, PAGE_SIZE);
+        memset(pool, 0xAA, needed * PAGE_SIZE);
+        arch_set_page_table_pool(pool, needed);
+        arch_init_page_tables(&mmap);
+
+        bool ok = CHECK(pml4 == pool);
+        UINTN i = 0, start = 0, end = 0;
+        UINT64 map_flags = 0, prev_last = ~0ULL;
+        while (next_mmap_range(&mmap, &i, &start, &end, &map_flags)) {
+            UINT64 estimate = page_tables_for_range(start, end-1, prev_last);
+            UINT64 before = page_table_pool_pages;
+            identity_map_range(start, end - start, map_flags, &mmap);
+            if (!CHECK(before - page_table_pool_pages <= estimate)) {
+                host_printf("  [%llx, %llx): used %llu tables, estimated %llu\n",
+                            (unsigned long long)start, (unsigned long long)end,
+                            (unsigned long long)(before - page_table_pool_pages),
+                            (unsigned long long)estimate);
+                ok = false;
+            }
+            prev_last = end-1;
+        }
+
+        UINTN tables = 0, outside = 0;
+        count_tables(pml4, 0, (UINT64)pool, (UINT64)(pool + needed), &tables, &outside);
+        ok &= CHECK(outside == 0 && tables == needed - page_table_pool_pages);
+        ok &= CHECK(mem_is_zero(page_table_pool, page_table_pool_pages * PAGE_SIZE));
+        if (!ok)
+            host_printf("  pool run %llu: %llu tables needed, %llu used, %llu outside the pool\n",
+                        (unsigned long long)run, (unsigned long long)needed,
+                        (unsigned long long)tables, (unsigned long long)outside);
+
+        arch_set_page_table_pool(NULL, 0);
+        host_free(pool);
+    }
+
+    // Without a pool set up front, arch_init_page_tables() reserves it from the memory map
+    random_mmap(100, 3000);
+    UINT64 needed = arch_page_tables_needed(&mmap);
+    new_page_tables();
+    CHECK(page_table_pool_pages == needed - 1);
+    CHECK((UINT8 *)pml4 >= spare && (UINT8 *)pml4 < spare + (SPARE_PAGES * PAGE_SIZE));
+    CHECK(page_table_pool == pml4 + 1);
+}
+
+// =================================================================
+// Map ranges that are not identity mapped or not aligned, ranges at
+//   the top of the address space, and over already mapped pages
+// =================================================================
+VOID test_map_range(void) {
+    spare_mmap();
+    new_page_tables();
+
+    // Higher half kernel at an address that is not 2MiB aligned: 4KiB pages only,
+    //   length rounded up to a whole page, nothing mapped before or after
+    const UINT64 kernel = 0x7654000, kernel_size = (5 << 20) + 12000;
+    const UINT64 kernel_pages_size = (5 << 20) + 12288;
+    arch_map_range(kernel, KERNEL_START_ADDRESS, kernel_size, MAP_WRITE | MAP_USER, &mmap);
+    CHECK(check_mapped(KERNEL_START_ADDRESS, kernel, kernel_pages_size, PAGE_SIZE,
+                       PRESENT | READWRITE | USER));
+    CHECK(check_unmapped(KERNEL_START_ADDRESS - PAGE_SIZE, KERNEL_START_ADDRESS));
+    CHECK(check_unmapped(KERNEL_START_ADDRESS + kernel_pages_size,
+                         KERNEL_START_ADDRESS + kernel_pages_size + PAGE_SIZE_2M));
+
+    // Already mapped pages are left as is
+    arch_map_range(0x9000000, KERNEL_START_ADDRESS, PAGE_SIZE, MAP_WRITE, &mmap);
+    CHECK(check_mapped(KERNEL_START_ADDRESS, kernel, PAGE_SIZE, PAGE_SIZE, PRESENT | READWRITE | USER));
+
+    // 2MiB aligned physical & virtual addresses: 2MiB pages, then 4KiB for the tail;
+    //   no MAP_USER or MAP_WRITE leaves those bits clear in the leaf entries
+    const UINT64 aligned_virtual = 0xFFFFFFFFC0000000ULL, aligned_physical = 0x200000000ULL;
+    arch_map_range(aligned_physical, aligned_virtual, (8 << 20) + PAGE_SIZE, MAP_WRITE, &mmap);
+    CHECK(check_mapped(aligned_virtual, aligned_physical, 8 << 20, PAGE_SIZE_2M, PRESENT | READWRITE));
+    CHECK(check_mapped(aligned_virtual + (8 << 20), aligned_physical + (8 << 20), PAGE_SIZE,
+                       PAGE_SIZE, PRESENT | READWRITE));
+    CHECK(check_unmapped(aligned_virtual + (8 << 20) + PAGE_SIZE, aligned_virtual + (10 << 20)));
+
+    arch_map_range(0x300000000ULL, 0xFFFFFFFFB0000000ULL, PAGE_SIZE, 0, &mmap);
+    CHECK(check_mapped(0xFFFFFFFFB0000000ULL, 0x300000000ULL, PAGE_SIZE, PAGE_SIZE, PRESENT));
+
+    // Last pages of the address space, without wrapping around to 0
+    arch_map_range(0x5000, 0xFFFFFFFFFFFFE000ULL, 2 * PAGE_SIZE, MAP_WRITE, &mmap);
+    CHECK(check_mapped(0xFFFFFFFFFFFFE000ULL, 0x5000, 2 * PAGE_SIZE, PAGE_SIZE, PRESENT | READWRITE));
+    CHECK(check_unmapped(0, PAGE_SIZE_2M));
+
+    // A 1GiB range over scattered already mapped 4KiB pages: those pages are kept,
+    //   the rest of their 2MiB regions are filled in with 4KiB pages, and the other
+    //   2MiB regions use 2MiB pages as the 1GiB entry already has a table
+    const UINT64 base = 0x40000000000ULL;
+    identity_map_page(base + 0x5000, &mmap);
+    identity_map_page(base + 0x300000, &mmap);
+    identity_map_range(base, PAGE_SIZE_1G, MAP_WRITE | MAP_USER | MAP_NX, &mmap);
+
+    UINT64 nx = arch_has_nx() ? NO_EXECUTE : 0;
+    CHECK(check_mapped(base, base, 0x5000, PAGE_SIZE, PRESENT | READWRITE | USER | nx));
+    CHECK(check_mapped(base + 0x5000, base + 0x5000, PAGE_SIZE, PAGE_SIZE, PRESENT | READWRITE | USER));
+    CHECK(check_mapped(base + 0x6000, base + 0x6000, PAGE_SIZE_2M - 0x6000, PAGE_SIZE,
+                       PRESENT | READWRITE | USER | nx));
+    CHECK(check_mapped(base + 0x200000, base + 0x200000, 0x100000, PAGE_SIZE,
+                       PRESENT | READWRITE | USER | nx));
+    CHECK(check_mapped(base + 0x300000, base + 0x300000, PAGE_SIZE, PAGE_SIZE, PRESENT | READWRITE | USER));
+    CHECK(check_mapped(base + 0x301000, base + 0x301000, 0xFF000, PAGE_SIZE,
+                       PRESENT | READWRITE | USER | nx));
+    CHECK(check_mapped(base + 0x400000, base + 0x400000, PAGE_SIZE_1G - 0x400000, PAGE_SIZE_2M,
+                       PRESENT | READWRITE | USER | nx));
+    CHECK(check_unmapped(base + PAGE_SIZE_1G, base + PAGE_SIZE_1G + PAGE_SIZE_2M));
+}
+
+// =================================================================
+// Write-combining framebuffer: the PAT bit (PCD without a PAT) in
+//   4KiB, 2MiB & 1GiB entries, kept where the memory map overlaps it,
+//   with its tables in the pool ahead of the memory map's
+// =================================================================
+VOID test_framebuffer(void) {
+    const UINT64 wc = arch_has_pat() ? PAT : PCD;
+    const UINT64 fb = 0x80000000ULL - 0x3000, fb_size = PAGE_SIZE_1G + PAGE_SIZE_2M + 0x5000;
+
+    for (UINTN run = 0; run < 10; run++) {
+        // 1st run: the framebuffer is away from the memory map, so it needs its own tables
+        if (run == 0)
+            spare_mmap();
+        else {
+            random_mmap(50 + rand_next(100), 3000);
+            add_desc(EfiBootServicesData, fb - PAGE_SIZE_2M, (PAGE_SIZE_2M + 0x4000) / PAGE_SIZE,
+                     EFI_MEMORY_WB);
+            add_desc(EfiMemoryMappedIO, fb + fb_size - 0x1000, 0x100, EFI_MEMORY_UC);
+        }
+
+        UINT64 needed = arch_page_tables_needed(&mmap) + arch_range_page_tables_needed(fb, fb_size);
+        Page_Table *pool = host_alloc(needed * PAGE_SIZE, PAGE_SIZE);
+        arch_set_page_table_pool(pool, needed);
+        arch_init_page_tables(&mmap);
+
+        identity_map_range(fb, fb_size, MAP_WRITE | MAP_USER | MAP_WC, &mmap);
+        identity_map_efi_mmap(&mmap);
+
+        // 3 4KiB pages up to 2GiB, a 1GiB page (or 2MiB pages), a 2MiB page, then 2 4KiB pages
+        const UINT64 flags = PRESENT | READWRITE | USER | wc;
+        const UINT64 gb2 = 2 * PAGE_SIZE_1G, gb3 = 3 * PAGE_SIZE_1G;
+        bool ok = CHECK(check_mapped(fb, fb, 0x3000, PAGE_SIZE, flags)) &
+                  CHECK(check_mapped(gb2, gb2, PAGE_SIZE_1G, arch_max_page_size(), flags)) &
+                  CHECK(check_mapped(gb3, gb3, PAGE_SIZE_2M, PAGE_SIZE_2M, flags)) &
+                  CHECK(check_mapped(gb3 + PAGE_SIZE_2M, gb3 + PAGE_SIZE_2M, 0x2000, PAGE_SIZE, flags));
+
+        UINTN tables = 0, outside = 0;
+        count_tables(pml4, 0, (UINT64)pool, (UINT64)(pool + needed), &tables, &outside);
+        ok &= CHECK(outside == 0);
+        if (run == 0) ok &= CHECK(tables > arch_page_tables_needed(&mmap));
+        if (!ok)
+            host_printf("  framebuffer run %llu: %llu tables needed, %llu used, %llu outside the pool\n",
+                        (unsigned long long)run, (unsigned long long)needed,
+                        (unsigned long long)tables, (unsigned long long)outside);
+
+        arch_set_page_table_pool(NULL, 0);
+        host_free(pool);
+    }
+}
+
+// =================================================================
+// Access comes from the memory type, not the memory map's XP & RO,
+//   which only say what the memory could be protected with: loader
+//   code with both is still writable & executable. Runtime regions get
+//   their access from the memory attributes table, mapped first, with
+//   the memory type from the memory map; entries outside of runtime
+//   regions are ignored.
+// =================================================================
+VOID test_memory_attributes(void) {
+    const UINT64 protect = EFI_MEMORY_XP | EFI_MEMORY_RO;
+    const UINT64 code = PAGE_SIZE_1G, rt_code = code + (16 * PAGE_SIZE), rt_data = code + (24 * PAGE_SIZE);
+
+    spare_mmap();
+    add_desc(EfiLoaderCode, code, 16, EFI_MEMORY_WB | protect);
+    add_desc(EfiRuntimeServicesCode, rt_code, 8, EFI_MEMORY_WB | protect | EFI_MEMORY_RUNTIME);
+    add_desc(EfiRuntimeServicesData, rt_data, 4, EFI_MEMORY_UC | protect | EFI_MEMORY_RUNTIME);
+
+    // Runtime code image: header & data not executable, code read only; then runtime data,
+    //   and an entry over loader code
+    struct {
+        EFI_MEMORY_ATTRIBUTES_TABLE hdr;
+        UINT8 entries[5][DESC_SIZE];
+    } table = { .hdr = { .Version = 1, .NumberOfEntries = 5, .DescriptorSize = DESC_SIZE } };
+    const struct { UINT32 type; UINT64 start, pages, attribute; } entries[] = {
+        { EfiRuntimeServicesCode, rt_code,                    1, EFI_MEMORY_XP },
+        { EfiRuntimeServicesCode, rt_code + PAGE_SIZE,        5, EFI_MEMORY_RO },
+        { EfiRuntimeServicesData, rt_code + (6 * PAGE_SIZE),  2, EFI_MEMORY_XP },
+        { EfiRuntimeServicesData, rt_data,                    4, EFI_MEMORY_XP },
+        { EfiLoaderCode,          code,                      16, protect },
+    };
+    for (UINTN i = 0; i < ARRAY_SIZE(entries); i++) 
+        *memory_attributes_entry(&table.hdr, i) = (EFI_MEMORY_DESCRIPTOR){
+            .Type = entries[i].type, .PhysicalStart = entries[i].start, 
+            .NumberOfPages = entries[i].pages, 
+            .Attribute = entries[i].attribute | EFI_MEMORY_RUNTIME,
+        };
+
+    const UINT64 rwx = arch_page_flags(MAP_WRITE | MAP_USER);
+    const UINT64 rw  = arch_page_flags(MAP_WRITE | MAP_USER | MAP_NX);
+    const UINT64 rx  = arch_page_flags(MAP_USER);
+
+    new_page_tables();
+    identity_map_memory_attributes(&table.hdr, &mmap);
+    identity_map_efi_mmap(&mmap);
+    bool ok = CHECK(check_identity_mapped(code, rt_code, rwx)) &
+              CHECK(check_identity_mapped(rt_code, rt_code + PAGE_SIZE, rw)) &
+              CHECK(check_identity_mapped(rt_code + PAGE_SIZE, rt_code + (6 * PAGE_SIZE), rx)) &
+              CHECK(check_identity_mapped(rt_code + (6 * PAGE_SIZE), rt_data, rw)) &
+              CHECK(check_identity_mapped(rt_data, rt_data + (4 * PAGE_SIZE), 
+                                          arch_page_flags(MAP_WRITE | MAP_USER | MAP_NX | MAP_UC)));
+
+    // Without the table, runtime code is writable & executable as its type says
+    new_page_tables();
+    identity_map_memory_attributes(NULL, &mmap);
+    identity_map_efi_mmap(&mmap);
+    ok &= CHECK(check_identity_mapped(code, rt_data, rwx));
+    if (!ok) host_printf("  memory attributes\n");
+}
+
+// =================================================================
+// Effective memory types for each PAT & MTRR type, from the Intel
+//   SDM "Effective Page-Level Memory Types" table
+// =================================================================
+VOID test_memory_types(void) {
+    enum { UC = MEM_TYPE_UC, WC = MEM_TYPE_WC, WT = MEM_TYPE_WT,
+           WP = MEM_TYPE_WP, WB = MEM_TYPE_WB, UCM = MEM_TYPE_UC_MINUS };
+    const uint8_t pats[]  = { UC, UCM, WC, WT, WP, WB };
+    const uint8_t mtrrs[] = { UC, WC, WT, WP, WB };
+    const uint8_t want[ARRAY_SIZE(pats)][ARRAY_SIZE(mtrrs)] = {
+        //         UC  WC  WT  WP  WB    MTRR
+        /* UC  */ { UC, UC, UC, UC, UC },
+        /* UC- */ { UC, WC, UC, UC, UC },
+        /* WC  */ { WC, WC, WC, WC, WC },
+        /* WT  */ { UC, UC, WT, WT, WT },
+        /* WP  */ { UC, UC, WP, WP, WP },
+        /* WB  */ { UC, WC, WT, WP, WB },
+    };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(pats); i++) {
+        for (UINTN j = 0; j < ARRAY_SIZE(mtrrs); j++) {
+            if (!CHECK(effective_memory_type(pats[i], mtrrs[j]) == want[i][j]))
+                host_printf("  PAT %u, MTRR %u: got %u, want %u\n", pats[i], mtrrs[j],
+                            effective_memory_type(pats[i], mtrrs[j]), want[i][j]);
+        }
+    }
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+
+    spare = host_alloc(SPARE_PAGES * PAGE_SIZE, PAGE_SIZE);
+    if (arch_has_nx()) data_flags |= NO_EXECUTE;
+
+    test_identity_map();
+    test_map_range();
+    test_page_table_pool();
+    test_framebuffer();
+    test_memory_attributes();
+    test_memory_types();
+
+    return host_report("test_page_tables");
+}
+
+#else
+
+int main(void) {
+    host_printf("SKIP test_page_tables (x86_64 only)\n");
+    return 0;
+}
+
+#endif
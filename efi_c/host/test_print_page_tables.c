@@ -0,0 +1,200 @@
+//
+// test_print_page_tables.c: Host test running the print_page_tables() tool over random
+//   x86_64 memory maps of every type & attribute mix, with the GOP framebuffer in a gap,
+//   over MMIO, or not there, and a memory attributes table for the runtime regions or
+//   none, so it builds the same tables as load_kernel() and checks them against its 
+//   expected mappings. Its output is captured and must report every range mapped as 
+//   expected.
+//
+#include "host_efi.h"
+
+#if defined(__x86_64__)
+
+#define MAX_DESCS 1024
+#define DESC_SIZE 48                // Larger than EFI_MEMORY_DESCRIPTOR, like real firmware
+
+UINT8 descs[MAX_DESCS][DESC_SIZE];
+UINTN num_descs = 0;
+
+struct {
+    EFI_MEMORY_ATTRIBUTES_TABLE hdr;
+    UINT8 entries[3 * MAX_DESCS][DESC_SIZE];
+} attributes_table = { .hdr = { .Version = 1, .DescriptorSize = DESC_SIZE } };
+
+// =================================================================
+// Deterministic pseudo random numbers (xorshift64)
+// =================================================================
+UINT64 rand_state = 0x9E3779B97F4A7C15ULL;
+
+UINT64 rand_next(UINT64 limit) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return limit ? rand_state % limit : 0;
+}
+
+// =================================================================
+// Append a memory descriptor to the memory map GetMemoryMap() returns
+// =================================================================
+EFI_MEMORY_DESCRIPTOR *add_desc(UINT32 type, UINT64 start, UINT64 pages, UINT64 attribute) {
+    EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)descs[num_descs++];
+    *desc = (EFI_MEMORY_DESCRIPTOR){
+        .Type = type, .PhysicalStart = start, .NumberOfPages = pages, .Attribute = attribute,
+    };
+    host_memory_map_size = num_descs * DESC_SIZE;
+    return desc;
+}
+
+// =================================================================
+// Build a random memory map from a reserved page at 0 up, with random
+//   gaps, and descriptors often repeating the previous type & attributes
+//   so contiguous ones merge. No conventional memory, so nothing can be
+//   allocated from the fake addresses.
+// Returns: end address of the last descriptor
+// =================================================================
+UINT64 random_mmap(void) {
+    const UINT32 types[] = {
+        EfiReservedMemoryType, EfiLoaderCode, EfiLoaderData, EfiBootServicesCode,
+        EfiBootServicesData, EfiRuntimeServicesCode, EfiRuntimeServicesData, EfiUnusableMemory,
+        EfiACPIMemoryNVS, EfiACPIReclaimMemory, EfiMemoryMappedIO, EfiPersistentMemory,
+    };
+    const UINT64 attrs[] = {
+        EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB,
+        EFI_MEMORY_UC, EFI_MEMORY_UC | EFI_MEMORY_WC, EFI_MEMORY_UC | EFI_MEMORY_WT, 0,
+        EFI_MEMORY_WB | EFI_MEMORY_XP, EFI_MEMORY_WB | EFI_MEMORY_RO, EFI_MEMORY_WP,
+        EFI_MEMORY_UC | EFI_MEMORY_WB | EFI_MEMORY_RUNTIME,
+        EFI_MEMORY_WB | EFI_MEMORY_XP | EFI_MEMORY_RO,
+    };
+
+    num_descs = 0;
+    add_desc(EfiReservedMemoryType, 0, 1, 0);
+
+    UINT64 address = PAGE_SIZE;
+    UINTN n = 50 + rand_next(400);
+    for (UINTN i = 0; i < n; i++) {
+        EFI_MEMORY_DESCRIPTOR *prev = (EFI_MEMORY_DESCRIPTOR *)descs[num_descs - 1];
+        bool same = i > 0 && rand_next(2);
+        UINT64 pages = rand_next(5) == 0 ? rand_next(300000) : rand_next(700);
+        if (rand_next(4) == 0) address += rand_next(3000) * PAGE_SIZE;
+
+        add_desc(same ? prev->Type : types[rand_next(ARRAY_SIZE(types))], address, max(pages, 1),
+                 same ? prev->Attribute : attrs[rand_next(ARRAY_SIZE(attrs))]);
+        address += max(pages, 1) * PAGE_SIZE;
+    }
+    return address;
+}
+
+// =================================================================
+// Add a memory attributes table entry
+// =================================================================
+VOID add_attributes_entry(UINT32 type, UINT64 start, UINT64 pages, UINT64 attribute) {
+    EFI_MEMORY_DESCRIPTOR *entry = memory_attributes_entry(&attributes_table.hdr, 
+                                                           attributes_table.hdr.NumberOfEntries++);
+    *entry = (EFI_MEMORY_DESCRIPTOR){
+        .Type = type, .PhysicalStart = start, .NumberOfPages = pages, 
+        .Attribute = attribute | EFI_MEMORY_RUNTIME,
+    };
+}
+
+// =================================================================
+// Build a memory attributes table for the memory map's runtime regions:
+//   code as a not executable header, read only code & not executable 
+//   data, and data not executable, plus entries outside of runtime
+//   regions that must be ignored
+// =================================================================
+VOID random_attributes_table(void) {
+    attributes_table.hdr.NumberOfEntries = 0;
+    for (UINTN i = 0; i < num_descs; i++) {
+        EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)descs[i];
+        UINT64 start = desc->PhysicalStart, pages = desc->NumberOfPages;
+
+        if (desc->Type == EfiRuntimeServicesCode && pages >= 3) {
+            UINT64 code_pages = 1 + rand_next(pages - 2);
+            add_attributes_entry(EfiRuntimeServicesCode, start, 1, EFI_MEMORY_XP);
+            add_attributes_entry(EfiRuntimeServicesCode, start + PAGE_SIZE, code_pages, EFI_MEMORY_RO);
+            add_attributes_entry(EfiRuntimeServicesData, start + ((1 + code_pages) * PAGE_SIZE),
+                                 pages - 1 - code_pages, EFI_MEMORY_XP);
+        } else if (desc->Type == EfiRuntimeServicesData || rand_next(20) == 0)
+            add_attributes_entry(desc->Type, start, pages, rand_next(2) ? EFI_MEMORY_XP : EFI_MEMORY_RO);
+    }
+}
+
+// =================================================================
+// Check whether the captured console output contains str
+// =================================================================
+bool output_has(const char *str) {
+    UINTN len = strlen((char *)str);
+    for (UINTN i = 0; i + len <= host_console.len; i++) {
+        UINTN j = 0;
+        while (j < len && host_console.text[i + j] == (CHAR16)str[j]) j++;
+        if (j == len) return true;
+    }
+    return false;
+}
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+    host_console.capture = true;
+    host_memory_map = (EFI_MEMORY_DESCRIPTOR *)descs;
+    host_memory_map_desc_size = DESC_SIZE;
+
+    // Stand-in kernel file, so the kernel mapping is its size: not whole pages, and
+    //   more than a 2MiB page
+    Data_File_Entry kernel_file = { "kernel", 2048, (3 << 20) + 100 };
+    data_file_index = (Data_File_Index){ .entries = &kernel_file, .num_entries = 1, .built = true };
+
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE gop_mode = {0};
+    EFI_GRAPHICS_OUTPUT_PROTOCOL gop = { .Mode = &gop_mode };
+
+    EFI_CONFIGURATION_TABLE config_table = {
+        .VendorGuid = EFI_MEMORY_ATTRIBUTES_TABLE_GUID, .VendorTable = &attributes_table,
+    };
+    host_st.ConfigurationTable = &config_table;
+
+    for (UINTN run = 0; run < 30; run++) {
+        UINT64 end = random_mmap();
+
+        // Framebuffer in a gap after the memory map, over an MMIO descriptor, or no GOP
+        host_gop = &gop;
+        if (run % 3 == 0) {
+            gop_mode.FrameBufferBase = end + PAGE_SIZE_2M - 0x3000;
+            gop_mode.FrameBufferSize = (8 << 20) + 0x5000;
+        } else if (run % 3 == 1) {
+            EFI_MEMORY_DESCRIPTOR *desc = add_desc(EfiMemoryMappedIO, end + PAGE_SIZE_1G,
+                                                   4096 + rand_next(4096), EFI_MEMORY_UC);
+            gop_mode.FrameBufferBase = desc->PhysicalStart + (rand_next(16) * PAGE_SIZE);
+            gop_mode.FrameBufferSize = (desc->NumberOfPages - 32) * PAGE_SIZE;
+        } else
+            host_gop = NULL;
+
+        // Memory attributes table on every other run
+        random_attributes_table();
+        host_st.NumberOfTableEntries = run % 2;
+
+        host_console.len = 0;
+        bs->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, NULL, NULL, &timer_event);
+        print_page_tables();
+        flush_c16(cout);
+
+        bool ok = CHECK(output_has("All ranges are mapped as expected.")) &
+                  CHECK(!output_has("NOT MAPPED") && !output_has("WRONG") && !output_has("MISMATCH")) &
+                  CHECK(output_has("Kernel:") && output_has("Framebuffer:") == (host_gop != NULL)) &
+                  CHECK(output_has("Memory attributes table:") == (run % 2 == 1)) &
+                  CHECK(host_open_events == 0 && host_pages_in_use == 0);
+        if (!ok)
+            host_printf("  run %llu: %llu descriptors\n", (unsigned long long)run,
+                        (unsigned long long)num_descs);
+    }
+
+    return host_report("test_print_page_tables");
+}
+
+#else
+
+int main(void) {
+    host_printf("SKIP test_print_page_tables (x86_64 only)\n");
+    return 0;
+}
+
+#endif
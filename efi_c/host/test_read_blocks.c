@@ -0,0 +1,73 @@
+//
+// test_read_blocks.c: Host tests for disk_read_blocks(): whole blocks go straight to the
+//   caller's buffer with Block IO when it meets IoAlign, in multiples of the optimal
+//   transfer length, and partial head/tail blocks or unaligned buffers use Disk IO.
+//
+#include "host_efi.h"
+
+#define DISK_SIZE  (8 * 1024 * 1024)
+#define BLOCK_SIZE 512
+#define IO_ALIGN   64
+#define GRANULARITY 24      // Optimal transfer length in blocks, not a power of 2
+
+int main(void) {
+    host_efi_init();
+    host_console.echo = false;
+
+    UINT8 *data = host_alloc(DISK_SIZE, PAGE_SIZE);
+    for (UINTN i = 0; i < DISK_SIZE; i++) data[i] = (UINT8)((i * 13) + (i >> 9));
+
+    Host_Disk disk;
+    Disk_Info info;
+    host_disk_init(&disk, &info, data, DISK_SIZE, BLOCK_SIZE);
+    disk.media.IoAlign = info.io_align = IO_ALIGN;
+    disk.media.OptimalTransferLengthGranularity = info.optimal_transfer_blocks = GRANULARITY;
+
+    UINT8 *buf = host_alloc(DISK_SIZE + PAGE_SIZE, PAGE_SIZE);
+    const UINT64 offsets[] = { 0, 512, 100, 1000, (4096 * 3) + 7 };
+    const UINTN  sizes[]   = { 0, 1, 511, 512, 513, 4000, 3 << 20, (3 << 20) + 300 };
+
+    for (UINTN i = 0; i < ARRAY_SIZE(offsets); i++) {
+        for (UINTN j = 0; j < ARRAY_SIZE(sizes); j++) {
+            // Buffer at the same offset within a block as the disk offset, so whole
+            //   blocks land IoAlign aligned, and at an aligned address, so they don't
+            //   unless the disk offset is block aligned
+            for (UINTN k = 0; k < 2; k++) {
+                UINT64 offset = offsets[i];
+                UINTN  size   = sizes[j];
+                UINT8 *dst    = buf + (k ? offset % BLOCK_SIZE : 0);
+                bool aligned_body = (((UINTN)dst - offset) % IO_ALIGN) == 0;
+
+                memset(dst, 0xEE, size + 1);
+                disk.block_reads = disk.disk_reads = disk.max_transfer = disk.misaligned = 0;
+
+                EFI_STATUS status = disk_read_blocks(&info, offset, size, dst);
+                bool ok = CHECK(!EFI_ERROR(status)) &
+                          CHECK(!memcmp(dst, data + offset, size) && dst[size] == 0xEE) &
+                          CHECK(disk.misaligned == 0) &
+                          CHECK(disk.max_transfer <= DISK_READ_CHUNK_SIZE) &
+                          CHECK(disk.block_reads <= 1 ||
+                                disk.max_transfer % (GRANULARITY * BLOCK_SIZE) == 0);
+
+                // 1 whole block or more in an aligned buffer must use Block IO
+                UINT64 first_lba = (offset + BLOCK_SIZE - 1) / BLOCK_SIZE;
+                UINT64 end_lba   = (offset + size) / BLOCK_SIZE;
+                if (end_lba > first_lba && aligned_body) {
+                    ok &= CHECK(disk.block_reads > 0);
+                    ok &= CHECK(disk.disk_reads <= 2);  // Only head & tail
+                }
+                if (!ok)
+                    host_printf("  offset %llu, size %llu, buffer %s\n", (unsigned long long)offset,
+                                (unsigned long long)size, aligned_body ? "aligned" : "unaligned");
+            }
+        }
+    }
+
+    // No Disk IO: whole, aligned blocks still work with Block IO only,
+    //   partial blocks can't be read
+    info.diop = NULL;
+    CHECK(!EFI_ERROR(disk_read_blocks(&info, 1024, 8192, buf)) && !memcmp(buf, data + 1024, 8192));
+    CHECK(disk_read_blocks(&info, 1000, 8192, buf) == EFI_UNSUPPORTED);
+
+    return host_report("test_read_blocks");
+}
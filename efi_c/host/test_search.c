@@ -0,0 +1,132 @@
+//
+// test_search.c: Host tests for memmem() (Boyer-Moore-Horspool), strstr/stpstr and
+//   stpstr_many(), against a byte by byte search. Haystacks end right before an
+//   unmapped guard page, so reading past haystack_len faults instead of passing.
+//
+#include "host_efi.h"
+
+// =================================================================
+// Deterministic pseudo random numbers (xorshift64)
+// =================================================================
+UINT64 rand_state = 0x9E3779B97F4A7C15ULL;
+
+UINT64 rand_next(UINT64 limit) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return limit ? rand_state % limit : 0;
+}
+
+// =================================================================
+// Find the first needle in haystack 1 position at a time
+// Returns: offset of the match, or -1 if not found
+// =================================================================
+INTN naive_search(UINT8 *haystack, UINTN haystack_len, UINT8 *needle, UINTN needle_len) {
+    for (UINTN pos = 0; pos + needle_len <= haystack_len; pos++)
+        if (!memcmp_bytes(haystack + pos, needle, needle_len)) return (INTN)pos;
+    return -1;
+}
+
+// =================================================================
+// Check memmem() against naive_search()
+// =================================================================
+void check_memmem(UINT8 *haystack, UINTN haystack_len, UINT8 *needle, UINTN needle_len) {
+    UINT8 *got = memmem(haystack, haystack_len, needle, needle_len);
+    INTN want = naive_search(haystack, haystack_len, needle, needle_len);
+    if (!CHECK(want < 0 ? got == NULL : got == haystack + want))
+        host_printf("  memmem: haystack %llu, needle %llu: got %lld, want %lld\n",
+                    (unsigned long long)haystack_len, (unsigned long long)needle_len,
+                    got ? (long long)(got - haystack) : -1LL, (long long)want);
+}
+
+int main(void) {
+    host_efi_init();
+
+    UINT8 *page_end = host_guard_pages(2) + (2 * PAGE_SIZE);
+    UINT8 needle[600];
+
+    // Edge cases: empty needle matches at the start, even of an empty haystack, a
+    //   1 byte needle, a match in the very last bytes, and needles longer than the haystack
+    UINT8 *h = page_end - 10;
+    memcpy_bytes(h, "abcabcabcd", 10);
+    CHECK(memmem(h, 10, "", 0) == h);
+    CHECK(memmem(page_end, 0, "", 0) == page_end);
+    CHECK(memmem(page_end, 0, "a", 1) == NULL);
+    CHECK(memmem(h, 10, "c", 1) == h + 2);
+    CHECK(memmem(h, 10, "d", 1) == h + 9);
+    CHECK(memmem(h, 9, "d", 1) == NULL);
+    CHECK(memmem(h, 10, "abcd", 4) == h + 6);
+    CHECK(memmem(h, 10, "abcabcabcd", 10) == h);
+    CHECK(memmem(h, 10, "abcabcabcdx", 11) == NULL);
+    CHECK(memmem(h, 10, "xabcabcabcd", 11) == NULL);
+    CHECK(memmem(h, 10, "cabd", 4) == NULL);
+
+    // Random haystacks & needles from small alphabets so there are many partial
+    //   matches, with needles taken from the haystack (often its end) or made up,
+    //   including needles over 255 bytes where the skip table is capped
+    for (UINTN run = 0; run < 20000; run++) {
+        UINTN haystack_len = rand_next(5) == 0 ? rand_next(2 * PAGE_SIZE) : rand_next(300);
+        UINTN needle_len = rand_next(4) == 0 ? rand_next(ARRAY_SIZE(needle)) : rand_next(12);
+        UINT8 alphabet = (UINT8)(1 + rand_next(4));
+        h = page_end - haystack_len;
+        for (UINTN i = 0; i < haystack_len; i++) h[i] = (UINT8)('a' + rand_next(alphabet));
+
+        UINTN from = rand_next(3);
+        if (from == 0 && needle_len <= haystack_len)                   // At the end
+            memcpy_bytes(needle, h + haystack_len - needle_len, needle_len);
+        else if (from == 1 && needle_len <= haystack_len)              // Anywhere
+            memcpy_bytes(needle, h + rand_next(haystack_len - needle_len + 1), needle_len);
+        else
+            for (UINTN i = 0; i < needle_len; i++) needle[i] = (UINT8)('a' + rand_next(alphabet));
+
+        check_memmem(h, haystack_len, needle, needle_len);
+    }
+
+    // High bytes and NULs are ordinary bytes
+    h = page_end - 8;
+    memcpy_bytes(h, "\xFF\x00\xFE\x00\xFF\x00\xFE\x01", 8);
+    CHECK(memmem(h, 8, "\x00\xFE\x01", 3) == h + 5);
+    CHECK(memmem(h, 8, "\xFF\x00\xFE", 3) == h);
+
+    // strstr & stpstr stop at the NULL terminator
+    char *s = (char *)page_end - 15;
+    memcpy_bytes(s, "XRES=1024 YRES\0", 15);
+    CHECK(strstr(s, "RES") == s + 1);
+    CHECK(strstr(s, "YRES=") == NULL);
+    CHECK(strstr(s, "") == s);
+    CHECK(stpstr(s, "YRES") == s + 14);
+    CHECK(stpstr(s, "ZRES") == NULL);
+
+    // stpstr_many: first occurrence of each needle anywhere, needles sharing a first
+    //   byte, a needle cut off by the end of the haystack, an empty needle, and
+    //   a haystack that is not NULL terminated
+    {
+        char *text = "YRES=768\nXRES=1024\nXRES=800\nMODE=2\nMOD";
+        UINTN len = strlen(text);
+        char *hay = (char *)page_end - len;
+        memcpy_bytes(hay, text, len);
+
+        char *keys[] = { "XRES=", "YRES=", "MODE=", "MODEL=", "", "X", "\nMOD" };
+        char *ends[ARRAY_SIZE(keys)];
+        UINTN found = stpstr_many(hay, len, keys, ARRAY_SIZE(keys), ends);
+        CHECK(found == 6);
+        CHECK(ends[0] == hay + 14 && atoi(ends[0]) == 1024);
+        CHECK(ends[1] == hay + 5 && atoi(ends[1]) == 768);
+        CHECK(ends[2] == hay + 33);
+        CHECK(ends[3] == NULL);
+        CHECK(ends[4] == hay);
+        CHECK(ends[5] == hay + 10);
+        CHECK(ends[6] == hay + 31);
+
+        // Needles only partly in the haystack are not found
+        char *tail_keys[] = { "MODE", "MOD\n" };
+        char *tail_ends[ARRAY_SIZE(tail_keys)];
+        CHECK(stpstr_many(hay + 28, len - 28, tail_keys, ARRAY_SIZE(tail_keys), tail_ends) == 1);
+        CHECK(tail_ends[0] == hay + 32 && tail_ends[1] == NULL);
+
+        CHECK(stpstr_many(hay, 0, keys, 3, ends) == 0);
+        CHECK(ends[0] == NULL && ends[1] == NULL && ends[2] == NULL);
+    }
+
+    return host_report("test_search");
+}
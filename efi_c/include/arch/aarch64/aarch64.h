@@ -1,6 +1,11 @@
 //
 // aarch64.h: Arch specific definitions
 //
+// NOTE: Page tables & calling the kernel are not implemented for aarch64 yet.
+//   arch_page_tables_needed() returns 0, so load_kernel() & print_page_tables()
+//   refuse before building any, and the other paging functions trap if reached
+//   instead of silently mapping nothing.
+//
 #pragma once
 
 #include <stdint.h>
@@ -9,29 +14,96 @@
 
 #define ARCH_COFF_MACHINE 0xaa64    // Machine type bytes for PE Coff Header
 
-// TODO:
-void arch_setup_and_call_kernel(Entry_Point entry, void *kernel_stack, uint32_t stack_size, 
+// Read virtual counter, ticks at the generic timer frequency in CNTFRQ_EL0
+uint64_t arch_timestamp(void) {
+    uint64_t count = 0;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r"(count));
+    return count;
+}
+
+// FEAT_MOPS (CPYP/CPYM/CPYE, SETP/SETM/SETE) is not used yet, so the wide
+//   methods are the fastest ones available
+Mem_Method arch_probe_mem_method(void) {
+    return MEM_METHOD_WIDE;
+}
+
+// No FEAT_MOPS yet; a forced MEM_METHOD_ERMS/FSRM uses the wide methods
+void *arch_memset_rep(void *dst, uint8_t c, uint64_t len) {
+    return memset_wide(dst, c, len);
+}
+
+void *arch_memcpy_rep(void *dst, void *src, uint64_t len) {
+    return memcpy_wide(dst, src, len);
+}
+
+// Wait for an interrupt
+void arch_cpu_halt(void) {
+    __asm__ __volatile__ ("wfi");
+}
+
+// Not reached: load_kernel() refuses to exit boot services without page tables
+void arch_setup_and_call_kernel(Entry_Point entry, void *kernel_stack, uint32_t stack_size,
                                 Kernel_Parms *kparms) {
     (void)entry, (void)kernel_stack, (void)stack_size, (void)kparms;
+    __builtin_trap();
 }
 
-// TODO:
-void arch_cpu_halt(void) {
+// Not implemented: memory type names need MAIR_EL1 & a page table walk
+char *arch_memory_type_name(uint64_t virtual_address) {
+    (void)virtual_address;
+    return "Unknown";
+}
+
+// 0 = page tables are not built for this arch; callers must not map anything
+uint64_t arch_page_tables_needed(Memory_Map_Info *mmap) {
+    (void)mmap;
+    return 0;
+}
+
+uint64_t arch_range_page_tables_needed(uint64_t address, uint64_t length) {
+    (void)address, (void)length;
+    return 0;
+}
+
+// Paging functions below are not reached while arch_page_tables_needed() is 0
+void arch_set_page_table_pool(void *pool, uint64_t pages) {
+    (void)pool, (void)pages;
+    __builtin_trap();
+}
+
+void arch_init_page_tables(Memory_Map_Info *mmap) {
+    (void)mmap;
+    __builtin_trap();
+}
+
+void arch_map_range(uint64_t physical_address, uint64_t virtual_address, uint64_t length,
+                    uint64_t map_flags, Memory_Map_Info *mmap) {
+    (void)physical_address, (void)virtual_address, (void)length, (void)map_flags, (void)mmap;
+    __builtin_trap();
 }
 
-// TODO:
 void arch_map_page(uint64_t physical_address, uint64_t virtual_address, Memory_Map_Info *mmap) {
     (void)physical_address, (void)virtual_address, (void)mmap;
+    __builtin_trap();
 }
 
-// TODO:
 void arch_unmap_page(UINTN virtual_address) {
     (void)virtual_address;
+    __builtin_trap();
 }
 
-// TODO:
-void arch_init_page_tables(Memory_Map_Info *mmap) {
-    void *page_table = mmap_allocate_pages(mmap, 1);
-    memset(page_table, 0, PAGE_SIZE);  
+uint64_t arch_page_flags(uint64_t map_flags) {
+    (void)map_flags;
+    __builtin_trap();
 }
 
+uint64_t arch_map_flags(uint64_t flags) {
+    (void)flags;
+    __builtin_trap();
+}
+
+bool arch_get_mapping(uint64_t virtual_address, uint64_t *physical_address,
+                      uint64_t *page_size, uint64_t *flags) {
+    (void)virtual_address, (void)physical_address, (void)page_size, (void)flags;
+    __builtin_trap();
+}
@@ -102,7 +102,49 @@ enum {
     PRESENT    = (1 << 0),
     READWRITE  = (1 << 1),
     USER       = (1 << 2),
+    PWT        = (1 << 3),  // Page write through; PAT index bit 0
+    PCD        = (1 << 4),  // Page cache disable; PAT index bit 1
+    PAT        = (1 << 7),  // PT entry PAT index bit 2; same bit as LARGE_PAGE in PDPT/PD entries
+    LARGE_PAGE = (1 << 7),  // PS: PDPT entry maps a 1GiB page, PD entry maps a 2MiB page
+    LARGE_PAT  = (1 << 12), // PAT index bit 2 for 1GiB/2MiB page entries
 };
+#define NO_EXECUTE (1ULL << 63) // XD/NX: Page is not executable, if EFER.NXE is set
+
+// Memory types, as used in the PAT and MTRRs
+enum {
+    MEM_TYPE_UC       = 0,  // Uncacheable
+    MEM_TYPE_WC       = 1,  // Write combining
+    MEM_TYPE_WT       = 4,  // Write through
+    MEM_TYPE_WP       = 5,  // Write protected
+    MEM_TYPE_WB       = 6,  // Write back
+    MEM_TYPE_UC_MINUS = 7,  // UC-: Uncacheable, but a WC MTRR can override it (PAT only)
+};
+
+// PAT entries 0-3 are the power on defaults, so PWT/PCD alone keep their usual meaning;
+//   entries 4-7 (PAT bit set) are WC, WP, UC-, UC. Entry i is byte i of the MSR.
+//   Index 0 = WB, PWT = WT, PCD|PWT = UC, PAT = WC, PAT|PWT = WP.
+#define PAT_VALUE 0x0007050100070406ULL
+
+// Model specific registers
+#define MSR_IA32_MTRRCAP        0xFE
+#define MSR_IA32_PAT            0x277
+#define MSR_IA32_MTRR_DEF_TYPE  0x2FF
+#define MSR_IA32_MTRR_PHYSBASE0 0x200   // Variable range MTRR n base is 0x200 + 2n, mask is 0x201 + 2n
+#define MSR_IA32_EFER           0xC0000080
+
+#define EFER_NXE (1 << 11)  // Enable NO_EXECUTE page table bit
+
+// Page sizes mapped by a PT, PD, and PDPT entry; each level is 512x the one below
+#define PAGE_SIZE_2M (2ULL * 1024 * 1024)
+#define PAGE_SIZE_1G (1024ULL * 1024 * 1024)
+
+// CPUID feature bits
+#define CPUID_7_EBX_ERMS (1 << 9)   // Leaf 7 subleaf 0: Enhanced REP MOVSB/STOSB
+#define CPUID_7_EDX_FSRM (1 << 4)   // Leaf 7 subleaf 0: Fast Short REP MOVSB
+#define CPUID_80000001_EDX_PAGE1GB (1 << 26)    // Leaf 0x80000001: 1GiB pages
+#define CPUID_1_EDX_MTRR (1 << 12)  // Leaf 1: MTRRs
+#define CPUID_1_EDX_PAT  (1 << 16)  // Leaf 1: Page Attribute Table
+#define CPUID_80000001_EDX_NX (1 << 20)     // Leaf 0x80000001: Execute disable (NX) bit
 
 #define ARCH_COFF_MACHINE 0x8664    // Machine type bytes for PE Coff Header
 
@@ -113,6 +155,9 @@ enum {
 // ---------------------
 Page_Table *pml4 = NULL;        // Top level 4 page table for x86_64 long mode paging
 
+Page_Table *page_table_pool = NULL;     // Pre-zeroed contiguous page tables, see arch_init_page_tables()
+uint64_t page_table_pool_pages = 0;     // Page tables left in pool
+
 // ---------------------
 // Functions
 // ---------------------
@@ -124,6 +169,75 @@ void arch_cpu_halt(void) {
     __asm__ ("cli; hlt");
 }
 
+// =============================================================
+// Get CPUID register values for a given leaf (EAX) & subleaf (ECX)
+// =============================================================
+void arch_cpuid(uint32_t leaf, uint32_t subleaf, 
+                uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ __volatile__ ("cpuid" 
+                          : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) 
+                          : "a"(leaf), "c"(subleaf));
+}
+
+// =============================================================
+// Read timestamp counter (TSC), ticks at a constant rate on 
+//   modern CPUs
+// =============================================================
+uint64_t arch_timestamp(void) {
+    uint32_t low = 0, high = 0;
+    __asm__ __volatile__ ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// =============================================================
+// Read/write model specific register (MSR) 
+// =============================================================
+uint64_t arch_rdmsr(uint32_t msr) {
+    uint32_t low = 0, high = 0;
+    __asm__ __volatile__ ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+void arch_wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__ ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// =============================================================
+// Choose fastest memcpy/memset method from CPUID features:
+//   FSRM = REP MOVSB is fast for all sizes,
+//   ERMS = REP MOVSB/STOSB is fast for larger sizes,
+//   else SSE2 wide copies
+// =============================================================
+Mem_Method arch_probe_mem_method(void) {
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    arch_cpuid(0, 0, &eax, &ebx, &ecx, &edx);   // EAX = max basic leaf
+    if (eax < 7) return MEM_METHOD_WIDE;
+
+    arch_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+    if (edx & CPUID_7_EDX_FSRM) return MEM_METHOD_FSRM;
+    if (ebx & CPUID_7_EBX_ERMS) return MEM_METHOD_ERMS;
+    return MEM_METHOD_WIDE;
+}
+
+// =============================================================
+// memset with REP STOSB: Store byte AL to [RDI], RCX times
+// =============================================================
+void *arch_memset_rep(void *dst, uint8_t c, uint64_t len) {
+    void *p = dst;
+    __asm__ __volatile__ ("rep stosb" : "+D"(p), "+c"(len) : "a"(c) : "memory");
+    return dst;
+}
+
+// =============================================================
+// memcpy with REP MOVSB: Copy byte [RSI] to [RDI], RCX times
+// =============================================================
+void *arch_memcpy_rep(void *dst, void *src, uint64_t len) {
+    void *p = dst;
+    __asm__ __volatile__ ("rep movsb" : "+D"(p), "+S"(src), "+c"(len) : : "memory");
+    return dst;
+}
+
 // ===================================
 // Return example Task State Segment
 // ===================================
@@ -165,6 +279,59 @@ GDT example_gdt(TSS tss, uint64_t tss_address) {
     };
 }
 
+// =============================================================
+// Check if CPU has the Page Attribute Table (PAT). CPUID is only
+//   run once.
+// =============================================================
+bool arch_has_pat(void) {
+    static int has_pat = -1;
+    if (has_pat >= 0) return has_pat;
+
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    arch_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    has_pat = (edx & CPUID_1_EDX_PAT) != 0;
+    return has_pat;
+}
+
+// =============================================================
+// Program IA32_PAT with PAT_VALUE. Caches are written back and
+//   invalidated first, and the TLB is flushed when CR3 is loaded
+//   with the new page tables right after this.
+// =============================================================
+void arch_set_pat(void) {
+    if (!arch_has_pat()) return;
+
+    __asm__ __volatile__ ("wbinvd" : : : "memory");
+    arch_wrmsr(MSR_IA32_PAT, PAT_VALUE);
+}
+
+// =============================================================
+// Check if CPU has the execute disable (NX) page table bit. 
+//   CPUID is only run once.
+// =============================================================
+bool arch_has_nx(void) {
+    static int has_nx = -1;
+    if (has_nx >= 0) return has_nx;
+
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    arch_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);  // EAX = max extended leaf
+    has_nx = false;
+    if (eax >= 0x80000001) {
+        arch_cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        has_nx = (edx & CPUID_80000001_EDX_NX) != 0;
+    }
+    return has_nx;
+}
+
+// =============================================================
+// Set EFER.NXE so NO_EXECUTE page table bits are used; without 
+//   it they are reserved bits
+// =============================================================
+void arch_enable_nx(void) {
+    if (!arch_has_nx()) return;
+    arch_wrmsr(MSR_IA32_EFER, arch_rdmsr(MSR_IA32_EFER) | EFER_NXE);
+}
+
 // ============================================================================
 // Set page tables & paging, do other arch specific settings, and call kernel
 // ============================================================================
@@ -175,6 +342,10 @@ void arch_setup_and_call_kernel(Entry_Point entry, void *kernel_stack, uint32_t
     GDT gdt = example_gdt(tss, tss_address);
     Descriptor_Register gdtr = {.limit = sizeof gdt - 1, .base = (uint64_t)&gdt}; 
 
+    // Set PAT entries & NX bit used by new page tables, e.g. WC for the framebuffer
+    arch_set_pat();
+    arch_enable_nx();
+
     // Set new page tables (CR3 = PML4) and GDT (lgdt && ltr), and call entry point with parms
     __asm__ __volatile__(
         "cli\n"                     // Clear interrupts before setting new GDT/TSS, etc.
@@ -209,74 +380,390 @@ void arch_setup_and_call_kernel(Entry_Point entry, void *kernel_stack, uint32_t
       : "rax", "memory");
 }
 
-// ==================================================================
-// Map a virtual address to a physical address for a page of memory
-// ==================================================================
-void arch_map_page(uint64_t physical_address, uint64_t virtual_address, Memory_Map_Info *mmap) {
-    int flags = PRESENT | READWRITE | USER;   // 0b111
+// =============================================================
+// Largest page size to map with: 1GiB if CPUID reports 1GiB 
+//   pages, else 2MiB. CPUID is only run once, as it can be slow
+//   (e.g. a VM exit).
+// =============================================================
+uint64_t arch_max_page_size(void) {
+    static uint64_t max_page_size = 0;
+    if (max_page_size) return max_page_size;
 
-    uint64_t pml4_index = ((virtual_address) >> 39) & 0x1FF;   // 0-511
-    uint64_t pdpt_index = ((virtual_address) >> 30) & 0x1FF;   // 0-511
-    uint64_t pdt_index  = ((virtual_address) >> 21) & 0x1FF;   // 0-511
-    uint64_t pt_index   = ((virtual_address) >> 12) & 0x1FF;   // 0-511
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    max_page_size = PAGE_SIZE_2M;
 
-    // Make sure pdpt exists, if not then allocate it
-    if (!(pml4->entries[pml4_index] & PRESENT)) {
-        void *pdpt_address = mmap_allocate_pages(mmap, 1);
+    arch_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);  // EAX = max extended leaf
+    if (eax >= 0x80000001) {
+        arch_cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        if (edx & CPUID_80000001_EDX_PAGE1GB) max_page_size = PAGE_SIZE_1G;
+    }
+    return max_page_size;
+}
 
-        memset(pdpt_address, 0, sizeof(Page_Table));
-        pml4->entries[pml4_index] = (uint64_t)pdpt_address | flags;  
+// =============================================================
+// PT (4KiB page) entry flags for arch_map_range() MAP_* flags
+// =============================================================
+uint64_t arch_page_flags(uint64_t map_flags) {
+    uint64_t flags = PRESENT;
+    if (map_flags & MAP_WRITE) flags |= READWRITE;
+    if (map_flags & MAP_USER)  flags |= USER;
+    if ((map_flags & MAP_NX) && arch_has_nx()) flags |= NO_EXECUTE;
+
+    // PAT index for memory type, see PAT_VALUE. Without a PAT, WC is UC- (PCD), 
+    //   which still lets a WC MTRR for the range apply, and WP is UC
+    switch (map_flags & MAP_TYPE_MASK) {
+        case MAP_WT: flags |= PWT;                                      break;
+        case MAP_UC: flags |= PCD | PWT;                                break;
+        case MAP_WC: flags |= arch_has_pat() ? PAT : PCD;               break;
+        case MAP_WP: flags |= arch_has_pat() ? PAT | PWT : PCD | PWT;   break;
     }
+    return flags;
+}
 
-    // Make sure pdt exists, if not then allocate it
-    Page_Table *pdpt = (Page_Table *)(pml4->entries[pml4_index] & PHYS_PAGE_ADDR_MASK);
-    if (!(pdpt->entries[pdpt_index] & PRESENT)) {
-        void *pdt_address = mmap_allocate_pages(mmap, 1);
+// =============================================================
+// MAP_* flags for PT (4KiB page) entry flags; the inverse of 
+//   arch_page_flags()
+// =============================================================
+uint64_t arch_map_flags(uint64_t flags) {
+    uint64_t map_flags = 0;
+    if (flags & READWRITE)  map_flags |= MAP_WRITE;
+    if (flags & USER)       map_flags |= MAP_USER;
+    if (flags & NO_EXECUTE) map_flags |= MAP_NX;
+
+    switch (flags & (PAT | PCD | PWT)) {
+        case 0:                                                         break;  // WB
+        case PWT:       map_flags |= MAP_WT;                            break;
+        case PCD | PWT: map_flags |= MAP_UC;                            break;
+        case PAT:       map_flags |= MAP_WC;                            break;
+        case PAT | PWT: map_flags |= MAP_WP;                            break;
+        case PCD:       map_flags |= arch_has_pat() ? MAP_UC : MAP_WC;  break;
+        default:        map_flags |= MAP_UC;                            break;
+    }
+    return map_flags;
+}
 
-        memset(pdt_address, 0, sizeof(Page_Table));
-        pdpt->entries[pdpt_index] = (uint64_t)pdt_address | flags;  
+// =============================================================
+// Translate PT entry flags to 1GiB/2MiB page entry flags: the
+//   PAT bit moves to bit 12, as bit 7 is LARGE_PAGE there
+// =============================================================
+uint64_t large_page_flags(uint64_t flags) {
+    if (flags & PAT) flags = (flags & ~(uint64_t)PAT) | LARGE_PAT;
+    return flags | LARGE_PAGE;
+}
+
+// ==================================================================
+// Get a zeroed page table: the next one from the page table pool, 
+//   or if it is used up, a new page from the memory map
+// ==================================================================
+Page_Table *page_table_alloc(Memory_Map_Info *mmap) {
+    if (page_table_pool_pages > 0) {
+        page_table_pool_pages--;
+        return page_table_pool++;
     }
 
-    // Make sure pt exists, if not then allocate it
-    Page_Table *pdt = (Page_Table *)(pdpt->entries[pdpt_index] & PHYS_PAGE_ADDR_MASK);
-    if (!(pdt->entries[pdt_index] & PRESENT)) {
-        void *pt_address = mmap_allocate_pages(mmap, 1);
+    Page_Table *table = mmap_allocate_pages(mmap, 1);
+    memset(table, 0, sizeof *table);
+    return table;
+}
+
+// ==================================================================
+// Map the part of a virtual address range [virtual_address, last]
+//   that falls in 1 page table at a level (0 = PML4, 1 = PDPT, 
+//   2 = PDT, 3 = PT): fill consecutive entries in order, and recurse
+//   into each lower level table once. An entry is a 1GiB/2MiB page
+//   when it is fully covered and both addresses are aligned to it.
+//   Already mapped addresses are left as is.
+// ==================================================================
+void map_range_in_table(Page_Table *table, uint64_t level, uint64_t physical_address, 
+                        uint64_t virtual_address, uint64_t last, uint64_t flags, 
+                        Memory_Map_Info *mmap) {
+    const uint64_t table_flags = PRESENT | READWRITE | USER;    // Leaf entries limit access
+    const uint64_t max_page_size = arch_max_page_size();
+    const uint64_t shift = 39 - (level * 9);
+    const uint64_t entry_size = 1ULL << shift;
+
+    for (uint64_t i = (virtual_address >> shift) & 0x1FF; i < 512; i++) {
+        uint64_t *entry = &table->entries[i];
+        uint64_t entry_last = virtual_address | (entry_size-1);
+        uint64_t range_last = min(entry_last, last);    // Last address mapped in this entry
+
+        bool whole = !(virtual_address & (entry_size-1)) && range_last == entry_last;
+        bool leaf = level == 3 || 
+                    (whole && entry_size <= max_page_size && !(physical_address & (entry_size-1)));
+
+        if (!(*entry & PRESENT) && leaf) {
+            // Map new page physical address
+            *entry = (physical_address & PHYS_PAGE_ADDR_MASK) | (level < 3 ? large_page_flags(flags) : flags);
+
+        } else if (level < 3 && !(*entry & LARGE_PAGE)) {
+            // Make sure lower level table exists, if not then allocate it, and map into it;
+            //   an existing table may already have part of this entry's range mapped
+            if (!(*entry & PRESENT)) 
+                *entry = (uint64_t)page_table_alloc(mmap) | table_flags;
+
+            map_range_in_table((Page_Table *)(*entry & PHYS_PAGE_ADDR_MASK), level+1, 
+                               physical_address, virtual_address, range_last, flags, mmap);
+        }
 
-        memset(pt_address, 0, sizeof(Page_Table));
-        pdt->entries[pdt_index] = (uint64_t)pt_address | flags;  
+        if (range_last == last) break;
+        physical_address += range_last + 1 - virtual_address;
+        virtual_address = range_last + 1;
     }
+}
 
-    // Map new page physical address if not present
-    Page_Table *pt = (Page_Table *)(pdt->entries[pdt_index] & PHYS_PAGE_ADDR_MASK);
-    if (!(pt->entries[pt_index] & PRESENT)) 
-        pt->entries[pt_index] = (physical_address & PHYS_PAGE_ADDR_MASK) | flags;
+// ==================================================================
+// Map length bytes of virtual addresses to physical addresses, both
+//   page aligned, with MAP_* flags. The page tables are walked once
+//   per table rather than once per page, with the largest pages that
+//   fit: 1GiB/2MiB where the range and addresses are aligned to them, 
+//   4KiB only at unaligned edges. Already mapped addresses are left 
+//   as is.
+// ==================================================================
+void arch_map_range(uint64_t physical_address, uint64_t virtual_address, uint64_t length, 
+                    uint64_t map_flags, Memory_Map_Info *mmap) {
+    if (length == 0) return;
+
+    uint64_t pages = (length + (PAGE_SIZE-1)) / PAGE_SIZE;
+    map_range_in_table(pml4, 0, physical_address, virtual_address, 
+                       virtual_address + (pages * PAGE_SIZE) - 1, arch_page_flags(map_flags), mmap);
 }
 
-// ==============================
-// Unmap a page/virtual address 
-// ==============================
+// ==================================================================
+// Map a virtual address to a physical address for a page of memory
+// ==================================================================
+void arch_map_page(uint64_t physical_address, uint64_t virtual_address, Memory_Map_Info *mmap) {
+    arch_map_range(physical_address, virtual_address, PAGE_SIZE, MAP_WRITE | MAP_USER, mmap);
+}
+
+// ==============================================================
+// Unmap a page/virtual address. If it is mapped by a 2MiB/1GiB
+//   page, that whole large page is unmapped.
+// ==============================================================
 void arch_unmap_page(UINTN virtual_address) {
-    uint64_t pml4_index = ((virtual_address) >> 39) & 0x1FF;   // 0-511
-    uint64_t pdpt_index = ((virtual_address) >> 30) & 0x1FF;   // 0-511
-    uint64_t pdt_index  = ((virtual_address) >> 21) & 0x1FF;   // 0-511
-    uint64_t pt_index   = ((virtual_address) >> 12) & 0x1FF;   // 0-511
+    uint64_t indexes[4] = {
+        ((virtual_address) >> 39) & 0x1FF,  // PML4 index 0-511
+        ((virtual_address) >> 30) & 0x1FF,  // PDPT index 0-511
+        ((virtual_address) >> 21) & 0x1FF,  // PDT index 0-511
+        ((virtual_address) >> 12) & 0x1FF,  // PT index 0-511
+    };
 
-    Page_Table *pdpt = (Page_Table *)(pml4->entries[pml4_index] & PHYS_PAGE_ADDR_MASK);
-    Page_Table *pdt = (Page_Table *)(pdpt->entries[pdpt_index] & PHYS_PAGE_ADDR_MASK);
-    Page_Table *pt = (Page_Table *)(pdt->entries[pdt_index] & PHYS_PAGE_ADDR_MASK);
+    // Find the entry that maps this page, stopping early at a large page
+    Page_Table *table = pml4;
+    uint64_t level = 0;
+    for (; level < 3; level++) {
+        uint64_t entry = table->entries[indexes[level]];
+        if (!(entry & PRESENT)) return;     // Not mapped
+        if (entry & LARGE_PAGE) break;
+        table = (Page_Table *)(entry & PHYS_PAGE_ADDR_MASK);
+    }
 
-    pt->entries[pt_index] = 0;  // Clear page in page table to unmap the physical address there
+    table->entries[indexes[level]] = 0;  // Clear page in page table to unmap the physical address there
 
     // Flush the TLB cache for this page
     __asm__ ("invlpg (%0)\n" : : "r"(virtual_address));
 }
 
+// ==================================================================
+// Look up the mapping of a virtual address in the page tables 
+//   starting at PML4 table, stopping early at a large page
+// Returns: true and the physical address, the size of the page it 
+//   is in, and its entry flags as for a PT entry (see 
+//   arch_page_flags()), or false if the address is not mapped
+// ==================================================================
+bool page_table_lookup(Page_Table *table, uint64_t virtual_address, uint64_t *physical_address,
+                       uint64_t *page_size, uint64_t *flags) {
+    const uint64_t flags_mask = PRESENT | READWRITE | USER | PWT | PCD | NO_EXECUTE;
+    uint64_t entry = 0;
+
+    *page_size = PAGE_SIZE;
+    for (uint64_t level = 0, shift = 39; level < 4; level++, shift -= 9) {
+        entry = table->entries[(virtual_address >> shift) & 0x1FF];
+        if (!(entry & PRESENT)) return false;
+        if (level == 3) {
+            *flags = entry & (flags_mask | PAT);
+            break;
+        }
+        if (level > 0 && (entry & LARGE_PAGE)) { 
+            *page_size = 1ULL << shift;
+            *flags = (entry & flags_mask) | (entry & LARGE_PAT ? PAT : 0);
+            break;
+        }
+        table = (Page_Table *)(entry & PHYS_PAGE_ADDR_MASK);
+    }
+
+    *physical_address = (entry & PHYS_PAGE_ADDR_MASK & ~(*page_size-1)) | 
+                        (virtual_address & (*page_size-1));
+    return true;
+}
+
+// ==================================================================
+// Look up the mapping of a virtual address in the new page tables,
+//   see page_table_lookup()
+// ==================================================================
+bool arch_get_mapping(uint64_t virtual_address, uint64_t *physical_address, 
+                      uint64_t *page_size, uint64_t *flags) {
+    return page_table_lookup(pml4, virtual_address, physical_address, page_size, flags);
+}
+
+// =============================================================
+// Get the MTRR memory type of a physical address from the
+//   variable range MTRRs & default type. Fixed range MTRRs 
+//   (below 1MiB) are not checked.
+// =============================================================
+uint8_t arch_mtrr_type(uint64_t physical_address) {
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    arch_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_1_EDX_MTRR)) return MEM_TYPE_UC;
+
+    uint64_t def_type = arch_rdmsr(MSR_IA32_MTRR_DEF_TYPE);
+    if (!(def_type & (1 << 11))) return MEM_TYPE_UC;    // MTRRs disabled
+
+    uint8_t type = 0xFF;    // No variable range matched yet
+    uint64_t count = arch_rdmsr(MSR_IA32_MTRRCAP) & 0xFF;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t base = arch_rdmsr(MSR_IA32_MTRR_PHYSBASE0 + (i*2));
+        uint64_t mask = arch_rdmsr(MSR_IA32_MTRR_PHYSBASE0 + (i*2) + 1);
+        if (!(mask & (1 << 11))) continue;  // Range not valid
+
+        mask &= PHYS_PAGE_ADDR_MASK;
+        if ((physical_address & mask) != (base & mask)) continue;
+
+        // Overlapping ranges: UC wins, and WT wins over WB
+        uint8_t range_type = base & 0xFF;
+        if (type == 0xFF || range_type == MEM_TYPE_UC || 
+            (range_type == MEM_TYPE_WT && type == MEM_TYPE_WB)) 
+            type = range_type;
+    }
+    return type == 0xFF ? def_type & 0xFF : type;
+}
+
 // =============================================================
-// Initialize page tables by setting up new level 4 page table
+// Combine a PAT memory type with an MTRR memory type as in the
+//   Intel SDM "Effective Page-Level Memory Types" table
+// Returns: MEM_TYPE_* value
+// =============================================================
+uint8_t effective_memory_type(uint8_t pat, uint8_t mtrr) {
+    if (pat == MEM_TYPE_UC || pat == MEM_TYPE_WC) return pat;
+    if (pat == MEM_TYPE_UC_MINUS) return mtrr == MEM_TYPE_WC ? MEM_TYPE_WC : MEM_TYPE_UC;
+    switch (mtrr) {
+        case MEM_TYPE_UC: return MEM_TYPE_UC;
+        case MEM_TYPE_WC: return pat == MEM_TYPE_WB ? MEM_TYPE_WC : MEM_TYPE_UC;
+        case MEM_TYPE_WT: return pat == MEM_TYPE_WB ? MEM_TYPE_WT : pat;
+        case MEM_TYPE_WP: return pat == MEM_TYPE_WT ? MEM_TYPE_WT : MEM_TYPE_WP;
+        default:          return pat;   // WB MTRR: PAT type
+    }
+}
+
+// =============================================================
+// Get the effective memory type of an address from the current
+//   page tables (CR3) and IA32_PAT, combined with its MTRR type
+//   with effective_memory_type().
+// Returns: MEM_TYPE_* value, or -1 if address is not mapped
+// =============================================================
+int arch_memory_type(uint64_t virtual_address) {
+    Page_Table *table = NULL;
+    __asm__ __volatile__ ("movq %%CR3, %0" : "=r"(table));
+    table = (Page_Table *)((uint64_t)table & PHYS_PAGE_ADDR_MASK);
+
+    uint64_t physical_address = 0, page_size = 0, flags = 0;
+    if (!page_table_lookup(table, virtual_address, &physical_address, &page_size, &flags)) 
+        return -1;
+
+    // No PAT: PWT/PCD select the same types as PAT entries 0-3
+    uint64_t pat_index = (flags & PAT ? 4 : 0) | (flags & PCD ? 2 : 0) | (flags & PWT ? 1 : 0);
+    uint8_t pat = arch_has_pat() ? (arch_rdmsr(MSR_IA32_PAT) >> (pat_index * 8)) & 7 
+                                 : (PAT_VALUE >> ((pat_index & 3) * 8)) & 7;
+    return effective_memory_type(pat, arch_mtrr_type(physical_address));
+}
+
+// =============================================================
+// Get name of the effective memory type of an address, e.g. to 
+//   check a framebuffer is write-combining
+// =============================================================
+char *arch_memory_type_name(uint64_t virtual_address) {
+    switch (arch_memory_type(virtual_address)) {
+        case MEM_TYPE_UC: return "UC (Uncacheable)";
+        case MEM_TYPE_WC: return "WC (Write combining)";
+        case MEM_TYPE_WT: return "WT (Write through)";
+        case MEM_TYPE_WP: return "WP (Write protected)";
+        case MEM_TYPE_WB: return "WB (Write back)";
+        case -1:          return "Not mapped";
+        default:          return "Unknown";
+    }
+}
+
+// =============================================================
+// Upper bound of page tables (PDPTs, PDTs, PTs) arch_map_range()
+//   needs to identity map [address, last], not counting tables
+//   shared with a previous range ending at prev_last (~0 for no 
+//   previous range). Each level with large pages only needs tables
+//   at the range's edges.
+// =============================================================
+uint64_t page_tables_for_range(uint64_t address, uint64_t last, uint64_t prev_last) {
+    uint64_t tables = 0;
+
+    // 1 table per 512GiB (PDPT), 1GiB (PDT), or 2MiB (PT) region of the range
+    for (uint64_t shift = 39; shift >= 21; shift -= 9) {
+        uint64_t first_region = address >> shift;
+        uint64_t count = (last >> shift) - first_region + 1;
+
+        if ((1ULL << shift) <= arch_max_page_size()) count = min(count, 2);
+        if (prev_last != ~0ULL && (prev_last >> shift) == first_region) count--;   // Counted for previous range
+        tables += count;
+    }
+    return tables;
+}
+
+// =============================================================
+// Upper bound of page tables, including the PML4, needed to 
+//   identity map the memory map with identity_map_efi_mmap()
+// =============================================================
+uint64_t arch_page_tables_needed(Memory_Map_Info *mmap) {
+    uint64_t pages = 1;     // PML4
+    UINTN i = 0, start = 0, end = 0, prev_last = ~0ULL;
+    UINT64 map_flags = 0;
+    while (next_mmap_range(mmap, &i, &start, &end, &map_flags)) {
+        if (end == start) continue;
+        pages += page_tables_for_range(start, end-1, prev_last);
+        prev_last = end-1;
+    }
+    return pages;
+}
+
+// =============================================================
+// Upper bound of page tables arch_map_range() needs to map a
+//   range on its own, not sharing tables with the memory map,
+//   e.g. for the framebuffer mapped before the memory map
+// =============================================================
+uint64_t arch_range_page_tables_needed(uint64_t address, uint64_t length) {
+    if (length == 0) return 0;
+    return page_tables_for_range(address, address + length - 1, ~0ULL);
+}
+
+// =============================================================
+// Set pool of pages to use for new page tables and zero it, or
+//   clear it for a NULL pool. A pool set before calling
+//   arch_init_page_tables() is used instead of allocating one.
+// =============================================================
+void arch_set_page_table_pool(void *pool, uint64_t pages) {
+    page_table_pool = pool;
+    page_table_pool_pages = pool ? pages : 0;
+    if (pool) memset(pool, 0, pages * sizeof *page_table_pool);
+}
+
+// =============================================================
+// Initialize page tables by setting up new level 4 page table.
+//   Page tables for the identity mapped memory map are reserved
+//   as 1 contiguous pool up front and zeroed with 1 bulk memset,
+//   instead of allocating & zeroing each table as it is needed.
 // =============================================================
 void arch_init_page_tables(Memory_Map_Info *mmap) {
-    pml4 = mmap_allocate_pages(mmap, 1);
-    memset(pml4, 0, sizeof *pml4);  
+    if (!page_table_pool_pages) {
+        uint64_t pages = arch_page_tables_needed(mmap);
+        arch_set_page_table_pool(mmap_allocate_pages(mmap, pages), pages);
+    }
+
+    pml4 = page_table_alloc(mmap);
 }
 
 // =============================================================
@@ -27,6 +27,7 @@ const uint32_t colors[COLOR_MAX] = {
 };
 
 uint32_t *fb = NULL;  // Framebuffer
+uint32_t *back_buffer = NULL;   // Write-back copy of fb to draw & scroll in, see line_feed()
 uint32_t xres = 0;    // X/Horizontal resolution of framebuffer
 uint32_t yres = 0;    // Y/Vertical resolution of framebuffer
 uint32_t x = 0;       // X offset into framebuffer
@@ -42,16 +43,22 @@ void print_string(char *string, Bitmap_Font *font);
 // ==============
 __attribute__((section(".kernel"), aligned(0x1000))) 
 noreturn void EFIAPI kmain(Kernel_Parms *kargs) {
+    // Use the same memcpy/memset method as the bootloader found from probing CPU features
+    mem_method = kargs->mem_method;
+
     // Grab Framebuffer/GOP info
     fb = (UINT32 *)kargs->gop_mode.FrameBufferBase;  
     xres = kargs->gop_mode.Info->PixelsPerScanLine;
     yres = kargs->gop_mode.Info->VerticalResolution;
 
+    // Draw to the back buffer & framebuffer both, or only the framebuffer if there is none
+    back_buffer = kargs->fb_back_buffer ? kargs->fb_back_buffer : fb;
+
     // Clear screen to solid color
     UINTN color = colors[DARK_GRAY];
     for (y = 0; y < yres; y++) 
         for (x = 0; x < xres; x++) 
-            fb[y*xres + x] = color;
+            fb[y*xres + x] = back_buffer[y*xres + x] = color;
 
     // Print test string(s)
     x = y = 0;  // Reset to 0,0 position
@@ -62,6 +69,8 @@ noreturn void EFIAPI kmain(Kernel_Parms *kargs) {
     print_string(font1->name, font1);
     print_string("\r\nFont 2 Name: ", font2);
     print_string(font2->name, font2);
+    print_string("\r\nFramebuffer memory type: ", font1);
+    print_string(arch_memory_type_name((UINTN)fb), font1);
 
     // Test runtime services by waiting a few seconds and then shutting down
     EFI_TIME old_time = {0}, new_time = {0};
@@ -95,19 +104,13 @@ void line_feed(Bitmap_Font *font) {
     // Can we draw another line of characters below current line?
     if (y + font->height < yres - font->height) y += font->height; // Yes, go down 1 line 
     else {
-        // No more room, move all lines on screen 1 row up by overwriting 1st line with lines 2+
-        // NOTE: This is probably slow due to reading and writing to framebuffer
-        uint32_t char_line_px    = xres * font->height;
-        uint32_t char_line_bytes = char_line_px * 4;    // Assuming ARGB8888
-        uint32_t char_lines      = yres / font->height;
-
-        memcpy(fb, fb + char_line_px, char_line_bytes * (char_lines-1)); 
-
-        // Blank out last row by making all pixels the background color 
-        // Get X,Y start of last character line 
-        uint32_t px = ((yres / font->height) - 1) * font->height * xres; 
-        for (uint32_t i = 0; i < char_line_px; i++)
-            fb[px++] = text_bg_color;
+        // No more room, move all lines on screen 1 row up by overwriting 1st line with lines 2+,
+        //   and blank out last row by making all pixels the background color. This is done in
+        //   the back buffer and then copied out, as reading from the framebuffer is slow
+        uint32_t char_lines = yres / font->height;
+        uint32_t scroll_height = char_lines * font->height;
+        fb_scroll_rows(back_buffer, xres, scroll_height, font->height, text_bg_color);
+        if (back_buffer != fb) memcpy(fb, back_buffer, (UINTN)scroll_height * xres * sizeof *fb);
     }
 }
 
@@ -151,7 +154,7 @@ void print_string(char *string, Bitmap_Font *font) {
                              ((uint64_t)glyph[7] <<  0) 
                              : *(uint64_t *)glyph;   // Else pixels are stored right to left
             for (uint32_t px = 0; px < font->width; px++) {
-                fb[y*xres + x] = bytes & mask ? text_fg_color : text_bg_color;
+                fb[y*xres + x] = back_buffer[y*xres + x] = bytes & mask ? text_fg_color : text_bg_color;
                 mask >>= 1;
                 x++;            // Next pixel of character
             }